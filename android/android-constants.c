@@ -37,3 +37,13 @@ const NetworkLatency  android_netdelays[] = {
 const size_t android_netdelays_count =
     sizeof(android_netdelays) / sizeof(android_netdelays[0]);
 
+const NetworkProfile  android_netprofiles[] = {
+    { "none", "no packet loss or jitter", 0., 0, 0. },
+    { "good", "0.1% loss, 5 ms jitter", 0.1, 5, 0. },
+    { "lossy", "2% loss, 30 ms jitter, 1% reordering", 2., 30, 1. },
+    { "bad", "10% loss, 150 ms jitter, 5% reordering", 10., 150, 5. },
+    { NULL, NULL, 0., 0, 0. }
+};
+const size_t android_netprofiles_count =
+    sizeof(android_netprofiles) / sizeof(android_netprofiles[0]);
+
@@ -30,6 +30,12 @@ extern double   qemu_net_download_speed;
 extern int      qemu_net_min_latency;
 extern int      qemu_net_max_latency;
 
+/* emulated network packet loss and reordering probabilities, in percents,
+ * and maximum jitter in ms */
+extern double   qemu_net_loss_percent;
+extern int      qemu_net_jitter_ms;
+extern double   qemu_net_reorder_percent;
+
 /* global flag, when true, network is disabled */
 extern int      qemu_net_disable;
 
@@ -55,9 +61,22 @@ typedef struct {
 extern const NetworkLatency  android_netdelays[];
 extern const size_t android_netdelays_count;
 
+/* list of supported network quality profile names and values */
+typedef struct {
+    const char*  name;
+    const char*  display;
+    double       loss_percent;
+    int          jitter_ms;
+    double       reorder_percent;
+} NetworkProfile;
+
+extern const NetworkProfile  android_netprofiles[];
+extern const size_t android_netprofiles_count;
+
 /* default network settings for emulator */
 #define  DEFAULT_NETSPEED  "full"
 #define  DEFAULT_NETDELAY  "none"
+#define  DEFAULT_NETPROFILE  "none"
 
 /* enable/disable interrupt polling mode. the emulator will always use 100%
  * of host CPU time, but will get high-quality time measurments. this is
@@ -92,6 +111,11 @@ extern int   android_parse_network_speed(const char*  speed);
  * accordingly. returns -1 on error, 0 on success */
 extern int   android_parse_network_latency(const char*  delay);
 
+/* parse a network profile parameter and sets qemu_net_loss_percent,
+ * qemu_net_jitter_ms and qemu_net_reorder_percent accordingly. returns -1
+ * on error, 0 on success */
+extern int   android_parse_network_profile(const char*  profile);
+
 /**  in qemu_setup.c */
 
 #define ANDROID_GLSTRING_BUF_SIZE 128
@@ -84,6 +84,7 @@ OPT_FLAG ( no_snapshot,    "perform a full boot and do not do not auto-save, but
 OPT_FLAG ( no_snapshot_save, "do not auto-save to snapshot on exit: abandon changed state" )
 OPT_FLAG ( no_snapshot_load, "do not auto-start from snapshot: perform a full boot" )
 OPT_FLAG ( snapshot_list,  "show a list of available snapshots" )
+OPT_PARAM( snapshot_ram_dir, "<dir>", "store snapshot RAM as files in <dir> that are loaded on demand" )
 OPT_FLAG ( no_snapshot_update_time, "do not do try to correct snapshot time on restore" )
 OPT_FLAG ( wipe_data, "reset the user data image (copy it from initdata)" )
 CFG_PARAM( avd, "<name>", "use a specific android virtual device" )
@@ -103,6 +104,7 @@ OPT_PARAM( netdelay, "<delay>", "network latency emulation" )
 OPT_FLAG ( netfast, "disable network shaping" )
 
 OPT_PARAM( code_profile, "<name>", "enable code profiling" )
+OPT_PARAM( guest_profile, "<file>", "write a sampling profile of the guest to <file> (ARM only)" )
 OPT_FLAG ( show_kernel, "display kernel messages" )
 OPT_FLAG ( shell, "enable root shell on current terminal" )
 OPT_FLAG ( no_jni, "disable JNI checks in the Dalvik runtime" )
@@ -132,6 +134,10 @@ OPT_PARAM( cpu_delay, "<cpudelay>", "throttle CPU emulation" )
 OPT_FLAG ( no_boot_anim, "disable animation for faster boot" )
 
 OPT_FLAG( no_window, "disable graphical window display" )
+OPT_FLAG( tickless, "reduce host CPU usage when the emulated system is idle" )
+OPT_FLAG( memory_balloon, "let the emulated system return unused memory to the host" )
+OPT_FLAG( tcg_traces, "translate hot emulated code as multi-block traces" )
+OPT_FLAG( perf_map, "describe translated code to the Linux perf profiler" )
 OPT_FLAG( version, "display emulator version number" )
 
 OPT_PARAM( report_console, "<socket>", "report console port to remote socket" )
@@ -41,7 +41,9 @@
 #include "android/config/config.h"
 #include "android/tcpdump.h"
 #include "net/net.h"
+#include "sysemu/balloon.h"
 #include "monitor/monitor.h"
+#include "qemu/timer.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -56,6 +58,7 @@
 #include "android/skin/charmap.h"
 #include "android/skin/keycode-buffer.h"
 #include "android/display-core.h"
+#include "android/opengles.h"
 
 #if defined(CONFIG_SLIRP)
 #include "libslirp.h"
@@ -91,6 +94,9 @@ typedef struct {
 
 typedef int Socket;
 
+typedef struct BinaryCommandRec_*       BinaryCommand;
+typedef struct BinarySubscriptionRec_*  BinarySubscription;
+
 typedef struct ControlClientRec_
 {
     struct ControlClientRec_*  next;       /* next client in list           */
@@ -100,6 +106,21 @@ typedef struct ControlClientRec_
     char                       buff[ 4096 ];
     int                        buff_len;
 
+    /* if not NULL, command output is appended here instead of being sent */
+    stralloc_t*                capture;
+
+    /* state of the binary protocol, see do_binary() */
+    char                       binary;
+    uint8_t                    bin_header[ 16 ];
+    int                        bin_header_len;
+    char                       bin_data[ 4096 ];
+    int                        bin_data_len;
+    int64_t                    bin_start_ms;
+    BinaryCommand              bin_commands;       /* pending commands     */
+    BinaryCommand*             bin_commands_tail;
+    QEMUTimer*                 bin_timer;
+    BinarySubscription         bin_subscriptions;
+
 } ControlClientRec;
 
 
@@ -212,6 +233,7 @@ control_client_detach( ControlClient  client )
 }
 
 static void  control_client_read( void*  _client );  /* forward */
+static void  binary_client_reset( ControlClient  client );  /* forward */
 
 static void
 control_client_destroy( ControlClient  client )
@@ -244,6 +266,8 @@ control_client_destroy( ControlClient  client )
     }
 #endif  // CONFIG_STANDALONE_CORE
 
+    binary_client_reset( client );
+
     sock = control_client_detach( client );
     if (sock >= 0)
         socket_close(sock);
@@ -272,6 +296,11 @@ static void  control_control_write( ControlClient  client, const char*  buff, in
     if (len < 0)
         len = strlen(buff);
 
+    if (client->capture) {
+        stralloc_add_bytes( client->capture, buff, len );
+        return;
+    }
+
     while (len > 0) {
         ret = HANDLE_EINTR(socket_send( client->sock, buff, len));
         if (ret < 0) {
@@ -305,6 +334,19 @@ static int  control_write( ControlClient  client, const char*  format, ... )
     return ret;
 }
 
+/* An fprintf_function that writes to the ControlClient passed as its FILE*,
+ * for the core functions that dump their state this way. */
+static int  control_fprintf( FILE*  f, const char*  format, ... )
+{
+    int ret;
+    va_list      args;
+    va_start(args, format);
+    ret = control_vwrite((ControlClient)f, format, args);
+    va_end(args);
+
+    return ret;
+}
+
 
 static ControlClient
 control_client_create( Socket         socket,
@@ -408,7 +450,9 @@ dump_help( ControlClient  client,
 
 static int do_quit(ControlClient client, char* args);  // forward
 
-static void
+/* Run the command line in client->buff. Return 0 on success, or -1 if
+ * the command failed or was not recognized. */
+static int
 control_client_do_command( ControlClient  client )
 {
     char*       line     = client->buff;
@@ -428,7 +472,7 @@ control_client_do_command( ControlClient  client )
         } else {
             control_write( client, "KO: unknown command, try 'help'\r\n" );
         }
-        return;
+        return -1;
     }
 
     for (;;) {
@@ -437,22 +481,23 @@ control_client_do_command( ControlClient  client )
         if (cmd->handler) {
             if ( !cmd->handler( client, args ) ) {
                 control_write( client, "OK\r\n" );
+                return 0;
             }
-            break;
+            return -1;
         }
 
         /* no handler means we should have sub-commands */
         if (cmd->subcommands == NULL) {
             control_write( client, "KO: internal error: buggy command table for '%.*s'\r\n",
                            cmdend - client->buff, client->buff );
-            break;
+            return -1;
         }
 
         /* we need a sub-command here */
         if ( !args ) {
             dump_help( client, cmd, "" );
             control_write( client, "KO: missing sub-command\r\n" );
-            break;
+            return -1;
         }
 
         line     = args;
@@ -461,7 +506,7 @@ control_client_do_command( ControlClient  client )
         if (subcmd == NULL) {
             dump_help( client, cmd, "" );
             control_write( client, "KO:  bad sub-command\r\n" );
-            break;
+            return -1;
         }
         cmd = subcmd;
     }
@@ -510,6 +555,351 @@ do_help( ControlClient  client, char*  args )
     }
 }
 
+/********************************************************************************************/
+/********************************************************************************************/
+/*****                                                                                 ******/
+/*****                        B I N A R Y   P R O T O C O L                            ******/
+/*****                                                                                 ******/
+/********************************************************************************************/
+/********************************************************************************************/
+
+/* The 'binary' command switches a console connection to a length-prefixed
+ * binary protocol, used by test harnesses that drive sensors or replay
+ * input at a high rate. Each frame carries a regular console command,
+ * which is run by the handlers below, so both protocols always support
+ * the same commands. See docs/ANDROID-CONSOLE-BINARY.TXT.
+ */
+
+enum {
+    BINARY_COMMAND      = 1,    /* client: run a command               */
+    BINARY_REPLY        = 2,    /* console: output of a command        */
+    BINARY_SUBSCRIBE    = 3,    /* client: report changes of a command */
+    BINARY_EVENT        = 4,    /* console: new output of a command    */
+    BINARY_UNSUBSCRIBE  = 5,    /* client: cancel a subscription       */
+
+    BINARY_FLAG_NOREPLY = 1 << 0,  /* COMMAND: don't send a REPLY      */
+    BINARY_FLAG_ERROR   = 1 << 0,  /* REPLY: the command failed        */
+};
+
+#define  BINARY_HEADER_SIZE    16
+#define  BINARY_MIN_PERIOD_MS  10
+
+typedef struct BinaryCommandRec_ {
+    BinaryCommand   next;
+    uint32_t        id;
+    int             flags;
+    int64_t         time_ms;    /* when to run it, on QEMU_CLOCK_VIRTUAL */
+    char            line[1];
+} BinaryCommandRec;
+
+typedef struct BinarySubscriptionRec_ {
+    BinarySubscription  next;
+    ControlClient       client;
+    uint32_t            id;
+    int                 period_ms;
+    QEMUTimer*          timer;
+    stralloc_t          last[1];    /* last output sent to the client */
+    char                line[1];
+} BinarySubscriptionRec;
+
+static void
+put_le16( uint8_t*  p, unsigned  val )
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static void
+put_le32( uint8_t*  p, uint32_t  val )
+{
+    put_le16( p, val & 0xffff );
+    put_le16( p + 2, val >> 16 );
+}
+
+static unsigned
+get_le16( const uint8_t*  p )
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+get_le32( const uint8_t*  p )
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static void
+binary_client_send( ControlClient  client, int  type, int  flags, uint32_t  id,
+                    const char*  data, int  len )
+{
+    uint8_t  header[ BINARY_HEADER_SIZE ];
+    int64_t  time = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) - client->bin_start_ms;
+
+    if (len < 0)
+        len = strlen(data);
+
+    put_le32( header, len );
+    put_le16( header + 4, type );
+    put_le16( header + 6, flags );
+    put_le32( header + 8, id );
+    put_le32( header + 12, (uint32_t)time );
+    control_control_write( client, (const char*)header, sizeof(header) );
+    if (len > 0)
+        control_control_write( client, data, len );
+}
+
+/* Run the console command |line| and store its output in |out|.
+ * Return 0 on success, or -1 on failure. */
+static int
+binary_client_run( ControlClient  client, const char*  line, stralloc_t*  out )
+{
+    int  ret;
+
+    snprintf( client->buff, sizeof(client->buff), "%s", line );
+    out->n = 0;
+    client->capture = out;
+    ret = control_client_do_command( client );
+    client->capture = NULL;
+    return ret;
+}
+
+/* Run the pending commands whose time has come, in order. */
+static void
+binary_client_run_commands( ControlClient  client )
+{
+    STRALLOC_DEFINE(out);
+    int64_t  now = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL);
+
+    while (client->bin_commands && client->bin_commands->time_ms <= now) {
+        BinaryCommand  cmd = client->bin_commands;
+        int            ret;
+
+        client->bin_commands = cmd->next;
+        if (client->bin_commands == NULL)
+            client->bin_commands_tail = &client->bin_commands;
+
+        ret = binary_client_run( client, cmd->line, out );
+        if (!(cmd->flags & BINARY_FLAG_NOREPLY))
+            binary_client_send( client, BINARY_REPLY,
+                                ret ? BINARY_FLAG_ERROR : 0, cmd->id,
+                                out->s, out->n );
+        free( cmd );
+        if (client->finished)
+            break;
+    }
+    stralloc_reset( out );
+
+    if (client->bin_commands && !client->finished)
+        timer_mod( client->bin_timer, client->bin_commands->time_ms );
+}
+
+static void
+binary_client_timer( void*  opaque )
+{
+    ControlClient  client = opaque;
+
+    binary_client_run_commands( client );
+    if (client->finished)
+        control_client_destroy( client );
+}
+
+/* Run the command of a subscription, and send its output to the client
+ * if it changed since the last time. */
+static void
+binary_subscription_timer( void*  opaque )
+{
+    BinarySubscription  sub    = opaque;
+    ControlClient       client = sub->client;
+    STRALLOC_DEFINE(out);
+
+    binary_client_run( client, sub->line, out );
+    if (out->n != sub->last->n || memcmp( out->s, sub->last->s, out->n )) {
+        binary_client_send( client, BINARY_EVENT, 0, sub->id, out->s, out->n );
+        stralloc_copy( sub->last, out );
+    }
+    stralloc_reset( out );
+
+    if (client->finished) {
+        control_client_destroy( client );
+        return;
+    }
+    timer_mod( sub->timer,
+               qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + sub->period_ms );
+}
+
+static void
+binary_subscription_free( BinarySubscription  sub )
+{
+    timer_del( sub->timer );
+    timer_free( sub->timer );
+    stralloc_reset( sub->last );
+    free( sub );
+}
+
+static void
+binary_client_subscribe( ControlClient  client, uint32_t  id, int  period_ms,
+                         const char*  line, int  len )
+{
+    BinarySubscription  sub = calloc( 1, sizeof(*sub) + len );
+
+    sub->client    = client;
+    sub->id        = id;
+    sub->period_ms = period_ms < BINARY_MIN_PERIOD_MS ? BINARY_MIN_PERIOD_MS
+                                                      : period_ms;
+    memcpy( sub->line, line, len + 1 );
+
+    /* Use the realtime clock, so that changes are reported even when the
+     * virtual device is stopped. The first check is done right away, to
+     * send the current state. */
+    sub->timer = timer_new_ms( QEMU_CLOCK_REALTIME,
+                               binary_subscription_timer, sub );
+    timer_mod( sub->timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) );
+
+    sub->next = client->bin_subscriptions;
+    client->bin_subscriptions = sub;
+    binary_client_send( client, BINARY_REPLY, 0, id, NULL, 0 );
+}
+
+static void
+binary_client_unsubscribe( ControlClient  client, uint32_t  id )
+{
+    BinarySubscription*  pnode = &client->bin_subscriptions;
+
+    for ( ; *pnode != NULL; pnode = &(*pnode)->next ) {
+        BinarySubscription  sub = *pnode;
+        if (sub->id == id) {
+            *pnode = sub->next;
+            binary_subscription_free( sub );
+            binary_client_send( client, BINARY_REPLY, 0, id, NULL, 0 );
+            return;
+        }
+    }
+    binary_client_send( client, BINARY_REPLY, BINARY_FLAG_ERROR, id,
+                        "KO: unknown subscription\r\n", -1 );
+}
+
+static void
+binary_client_handle_frame( ControlClient  client )
+{
+    const uint8_t*  header = client->bin_header;
+    int             type   = get_le16( header + 4 );
+    int             flags  = get_le16( header + 6 );
+    uint32_t        id     = get_le32( header + 8 );
+    uint32_t        time   = get_le32( header + 12 );
+    int             len    = client->bin_data_len;
+
+    client->bin_data[len] = 0;
+
+    switch (type) {
+    case BINARY_COMMAND: {
+        /* Commands are queued, even if they can run right away, so that
+         * they always run in the order in which they were received. */
+        BinaryCommand  cmd = malloc( sizeof(*cmd) + len );
+
+        cmd->next    = NULL;
+        cmd->id      = id;
+        cmd->flags   = flags;
+        cmd->time_ms = client->bin_start_ms + time;
+        memcpy( cmd->line, client->bin_data, len + 1 );
+        *client->bin_commands_tail = cmd;
+        client->bin_commands_tail  = &cmd->next;
+        binary_client_run_commands( client );
+        break;
+    }
+    case BINARY_SUBSCRIBE:
+        binary_client_subscribe( client, id, time, client->bin_data, len );
+        break;
+    case BINARY_UNSUBSCRIBE:
+        binary_client_unsubscribe( client, id );
+        break;
+    default:
+        binary_client_send( client, BINARY_REPLY, BINARY_FLAG_ERROR, id,
+                            "KO: unknown frame type\r\n", -1 );
+    }
+}
+
+/* Process up to one frame from |len| bytes at |data|, and return the
+ * number of bytes used. */
+static int
+binary_client_read( ControlClient  client, const uint8_t*  data, int  len )
+{
+    int       used = 0;
+    uint32_t  size;
+    int       n;
+
+    if (client->bin_header_len < BINARY_HEADER_SIZE) {
+        n = BINARY_HEADER_SIZE - client->bin_header_len;
+        if (n > len)
+            n = len;
+        memcpy( client->bin_header + client->bin_header_len, data, n );
+        client->bin_header_len += n;
+        used = n;
+        if (client->bin_header_len < BINARY_HEADER_SIZE)
+            return used;
+
+        if (get_le32( client->bin_header ) >= sizeof(client->bin_data)) {
+            D(( "binary console frame too large, closing connection\n" ));
+            client->finished = 1;
+            return used;
+        }
+    }
+
+    size = get_le32( client->bin_header );
+    n    = size - client->bin_data_len;
+    if (n > len - used)
+        n = len - used;
+    memcpy( client->bin_data + client->bin_data_len, data + used, n );
+    client->bin_data_len += n;
+    used += n;
+
+    if (client->bin_data_len == size) {
+        binary_client_handle_frame( client );
+        client->bin_header_len = 0;
+        client->bin_data_len   = 0;
+    }
+    return used;
+}
+
+/* Release the binary protocol state of a client */
+static void
+binary_client_reset( ControlClient  client )
+{
+    while (client->bin_commands) {
+        BinaryCommand  cmd = client->bin_commands;
+        client->bin_commands = cmd->next;
+        free( cmd );
+    }
+    while (client->bin_subscriptions) {
+        BinarySubscription  sub = client->bin_subscriptions;
+        client->bin_subscriptions = sub->next;
+        binary_subscription_free( sub );
+    }
+    if (client->bin_timer) {
+        timer_del( client->bin_timer );
+        timer_free( client->bin_timer );
+        client->bin_timer = NULL;
+    }
+    client->binary = 0;
+}
+
+static int
+do_binary( ControlClient  client, char*  args )
+{
+    if (client->binary) {
+        control_write( client, "KO: already using the binary protocol\r\n" );
+        return -1;
+    }
+    client->binary            = 1;
+    client->bin_header_len    = 0;
+    client->bin_data_len      = 0;
+    client->bin_start_ms      = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL);
+    client->bin_commands      = NULL;
+    client->bin_commands_tail = &client->bin_commands;
+    client->bin_timer = timer_new_ms( QEMU_CLOCK_VIRTUAL,
+                                      binary_client_timer, client );
+    return 0;
+}
+
 
 static void
 control_client_read_byte( ControlClient  client, unsigned char  ch )
@@ -578,8 +968,12 @@ control_client_read( void*  _client )
 #else
         D(( "received %.*s\n", size, buf ));
 #endif
-        for (nn = 0; nn < size; nn++) {
-            control_client_read_byte( client, buf[nn] );
+        for (nn = 0; nn < size; ) {
+            /* the 'binary' command changes the protocol of the next bytes */
+            if (client->binary)
+                nn += binary_client_read( client, buf + nn, size - nn );
+            else
+                control_client_read_byte( client, buf[nn++] );
             if (client->finished) {
                 control_client_destroy(client);
                 return;
@@ -690,6 +1084,9 @@ do_network_status( ControlClient  client, char*  args )
 
     control_write( client, "  minimum latency:  %ld ms\r\n", qemu_net_min_latency );
     control_write( client, "  maximum latency:  %ld ms\r\n", qemu_net_max_latency );
+    control_write( client, "  packet loss:      %.2f %%\r\n", qemu_net_loss_percent );
+    control_write( client, "  maximum jitter:   %d ms\r\n", qemu_net_jitter_ms );
+    control_write( client, "  reordering:       %.2f %%\r\n", qemu_net_reorder_percent );
     return 0;
 }
 
@@ -761,6 +1158,41 @@ describe_network_delay( ControlClient  client )
     /* XXX: TODO */
 }
 
+static int
+do_network_profile( ControlClient  client, char*  args )
+{
+    if ( !args ) {
+        control_write( client, "KO: missing <profile> argument, see 'help network profile'\r\n" );
+        return -1;
+    }
+    if ( android_parse_network_profile( args ) < 0 ) {
+        control_write( client, "KO: invalid <profile> argument, see 'help network profile' for valid values\r\n" );
+        return -1;
+    }
+    netshaper_set_profile( slirp_shaper_in, qemu_net_loss_percent,
+                           qemu_net_jitter_ms, qemu_net_reorder_percent );
+    netshaper_set_profile( slirp_shaper_out, qemu_net_loss_percent,
+                           qemu_net_jitter_ms, qemu_net_reorder_percent );
+    return 0;
+}
+
+static void
+describe_network_profile( ControlClient  client )
+{
+    const NetworkProfile*  profile = android_netprofiles;
+    const char* const  format = "  %-8s %s\r\n";
+
+    control_write( client,
+                   "'network profile <profile>' allows you to dynamically change the packet loss,\r\n"
+                   "jitter and reordering of the emulated network on the device, where <profile>\r\n"
+                   "is one of the following:\r\n\r\n" );
+    for ( ; profile->name; profile++ ) {
+        control_write( client, format, profile->name, profile->display );
+    }
+    control_write( client, format, "<loss>[:<jitter>[:<reorder>]]",
+                   "select loss and reorder percentages, and jitter in ms" );
+}
+
 static int
 do_network_capture_start( ControlClient  client, char*  args )
 {
@@ -812,6 +1244,9 @@ static const CommandDefRec  network_commands[] =
     { "delay", "change network latency", NULL, describe_network_delay,
        do_network_delay, NULL },
 
+    { "profile", "change network packet loss, jitter and reordering", NULL,
+      describe_network_profile, do_network_profile, NULL },
+
     { "capture", "dump network packets to file",
       "allows to start/stop capture of network packets to a file for later analysis\r\n", NULL,
       NULL, network_capture_commands },
@@ -2206,6 +2641,148 @@ do_avd_name( ControlClient  client, char*  args )
     return 0;
 }
 
+static void
+avd_stats_write_rate( ControlClient  client, const char*  name,
+                      uint64_t  count, uint64_t  prev_count,
+                      int64_t  elapsed_ms )
+{
+    double  rate = 0.;
+
+    if (elapsed_ms > 0)
+        rate = (count - prev_count) * 1000. / elapsed_ms;
+
+    control_write( client, "%s: %.1f/sec (%" PRIu64 " total)\r\n",
+                   name, rate, count );
+}
+
+static int
+do_avd_stats( ControlClient  client, char*  args )
+{
+    /* rates are measured since the previous 'avd stats' command */
+    static int64_t   prev_ms;
+    static uint64_t  prev_main_loop, prev_alarm;
+    int64_t   now_ms;
+    uint64_t  main_loop, alarm;
+
+    qemu_get_wakeup_stats(&now_ms, &main_loop, &alarm);
+
+    control_write( client, "tickless mode: %s\r\n",
+                   tickless_idle ? "on" : "off" );
+    avd_stats_write_rate( client, "main loop wakeups",
+                          main_loop, prev_main_loop, now_ms - prev_ms );
+    avd_stats_write_rate( client, "alarm timer wakeups",
+                          alarm, prev_alarm, now_ms - prev_ms );
+
+    prev_ms        = now_ms;
+    prev_main_loop = main_loop;
+    prev_alarm     = alarm;
+    return 0;
+}
+
+#ifdef __linux__
+/* Sum the shared and private resident memory of the emulator process, in
+ * kB. Shared memory includes guest pages merged with other processes and
+ * clean page cache pages of images that other emulators also map. */
+static int
+avd_memory_get_rss( uint64_t*  shared_kb, uint64_t*  private_kb )
+{
+    FILE*  f = fopen("/proc/self/smaps", "r");
+    char   line[256];
+
+    if (f == NULL)
+        return -1;
+
+    *shared_kb  = 0;
+    *private_kb = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        unsigned long long  kb;
+
+        if (sscanf(line, "Shared_Clean: %llu kB", &kb) == 1 ||
+            sscanf(line, "Shared_Dirty: %llu kB", &kb) == 1) {
+            *shared_kb += kb;
+        } else if (sscanf(line, "Private_Clean: %llu kB", &kb) == 1 ||
+                   sscanf(line, "Private_Dirty: %llu kB", &kb) == 1) {
+            *private_kb += kb;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+#endif
+
+static int
+do_avd_memory( ControlClient  client, char*  args )
+{
+#ifdef __linux__
+    uint64_t  shared_kb, private_kb;
+    FILE*     f;
+
+    if (avd_memory_get_rss(&shared_kb, &private_kb) < 0) {
+        control_write( client, "KO: could not read /proc/self/smaps: %s\r\n",
+                       strerror(errno) );
+        return -1;
+    }
+    control_write( client, "guest RAM: %" PRIu64 " kB\r\n",
+                   (uint64_t)ram_size / 1024 );
+    control_write( client, "shared RSS: %" PRIu64 " kB\r\n", shared_kb );
+    control_write( client, "private RSS: %" PRIu64 " kB\r\n", private_kb );
+
+    /* only provided by recent kernels */
+    f = fopen("/proc/self/ksm_merging_pages", "r");
+    if (f != NULL) {
+        unsigned long long  pages;
+
+        if (fscanf(f, "%llu", &pages) == 1) {
+            control_write( client, "KSM merged: %llu kB\r\n",
+                           pages * (getpagesize() / 1024) );
+        }
+        fclose(f);
+    }
+    return 0;
+#else
+    control_write( client, "KO: not supported on this host\r\n" );
+    return -1;
+#endif
+}
+
+static int
+do_avd_balloon( ControlClient  client, char*  args )
+{
+    ram_addr_t  actual = qemu_balloon_status();
+
+    if (actual == 0) {
+        control_write( client, "KO: no balloon device, see the -memory-balloon option\r\n" );
+        return -1;
+    }
+
+    if (args) {
+        char*          end;
+        unsigned long  target_mb = strtoul(args, &end, 10);
+
+        if (end == args || *end || target_mb == 0) {
+            control_write( client, "KO: invalid size '%s', try 'help avd balloon'\r\n", args );
+            return -1;
+        }
+        qemu_balloon((ram_addr_t)target_mb << 20);
+        return 0;
+    }
+
+    control_write( client, "guest RAM: %" PRIu64 " MB\r\n",
+                   (uint64_t)ram_size >> 20 );
+    control_write( client, "available to guest: %" PRIu64 " MB\r\n",
+                   (uint64_t)actual >> 20 );
+    control_write( client, "pages released to host: %" PRIu64 "\r\n",
+                   goldfish_balloon_get_released_pages() );
+    return 0;
+}
+
+static int
+do_avd_jit( ControlClient  client, char*  args )
+{
+    dump_exec_info((FILE*)client, control_fprintf);
+    return 0;
+}
+
 static const CommandDefRec  vm_commands[] =
 {
     { "stop", "stop the virtual device",
@@ -2224,6 +2801,28 @@ static const CommandDefRec  vm_commands[] =
     "'avd name' will return the name of this virtual device\r\n",
     NULL, do_avd_name, NULL },
 
+    { "stats", "query host wakeup statistics",
+    "'avd stats' will return the number of host wakeups per second of this virtual device,\r\n"
+    "measured since the previous 'avd stats' command, see the -tickless option\r\n",
+    NULL, do_avd_stats, NULL },
+
+    { "memory", "query host memory usage",
+    "'avd memory' will return the host memory used by this virtual device, split between\r\n"
+    "memory shared with other processes, e.g. other virtual devices running the same\r\n"
+    "system image, and memory private to this virtual device\r\n",
+    NULL, do_avd_memory, NULL },
+
+    { "balloon", "query or set the guest memory balloon",
+    "'avd balloon' will return the amount of RAM available to the virtual device, and\r\n"
+    "'avd balloon <size>' will ask it to give back RAM to the host until only <size> MB\r\n"
+    "remain available, see the -memory-balloon option\r\n",
+    NULL, do_avd_balloon, NULL },
+
+    { "jit", "query translated code statistics",
+    "'avd jit' will return statistics about the code translated for the virtual device,\r\n"
+    "including how many indirect branches found their target without leaving translated code\r\n",
+    NULL, do_avd_jit, NULL },
+
     { "snapshot", "state snapshot commands",
     "allows you to save and restore the virtual device state in snapshots\r\n",
     NULL, NULL, snapshot_commands },
@@ -2645,6 +3244,86 @@ static const CommandDefRec fingerprint_commands[] =
     { NULL, NULL, NULL, NULL, NULL, NULL }
 };
 
+/********************************************************************************************/
+/********************************************************************************************/
+/*****                                                                                 ******/
+/*****                        G P U   C O M M A N D S                                  ******/
+/*****                                                                                 ******/
+/********************************************************************************************/
+/********************************************************************************************/
+
+static int
+do_gpu_memory( ControlClient  client, char*  args )
+{
+    enum { MAX_GPU_CLIENTS = 64 };
+    uint64_t  resident, evicted, max_client;
+    uint32_t  client_ids[MAX_GPU_CLIENTS];
+    uint64_t  client_bytes[MAX_GPU_CLIENTS];
+    int       count, nn;
+
+    if (!android_hw->hw_gpu_enabled) {
+        control_write( client, "KO: GPU emulation is not enabled\r\n" );
+        return -1;
+    }
+    android_getOpenglesMemoryUsage(&resident, &evicted, &max_client);
+    control_write( client, "resident:   %" PRIu64 " KB\r\n", resident / 1024 );
+    control_write( client, "evicted:    %" PRIu64 " KB\r\n", evicted / 1024 );
+    control_write( client, "max client: %" PRIu64 " KB\r\n", max_client / 1024 );
+
+    count = android_getOpenglesClientMemoryUsage(client_ids, client_bytes,
+                                                 MAX_GPU_CLIENTS);
+    for (nn = 0; nn < count && nn < MAX_GPU_CLIENTS; nn++) {
+        control_write( client, "client %u: %" PRIu64 " KB\r\n",
+                       client_ids[nn], client_bytes[nn] / 1024 );
+    }
+    if (count > MAX_GPU_CLIENTS) {
+        control_write( client, "... and %d more clients\r\n",
+                       count - MAX_GPU_CLIENTS );
+    }
+    return 0;
+}
+
+static int
+do_gpu_limit( ControlClient  client, char*  args )
+{
+    unsigned long long  limit;
+    char*               end;
+
+    if (!android_hw->hw_gpu_enabled) {
+        control_write( client, "KO: GPU emulation is not enabled\r\n" );
+        return -1;
+    }
+    if (!args) {
+        control_write( client, "KO: argument missing, try 'gpu limit <megabytes>'\r\n" );
+        return -1;
+    }
+    limit = strtoull( args, &end, 10 );
+    if (end == args || end[0] || args[0] == '-' || limit > UINT64_MAX / (1024*1024)) {
+        control_write( client, "KO: argument <megabytes> must be a non-negative integer\r\n" );
+        return -1;
+    }
+    android_setOpenglesMemoryLimit((uint64_t)limit * 1024 * 1024);
+    return 0;
+}
+
+static const CommandDefRec  gpu_commands[] =
+{
+    { "memory", "show the GPU memory used by color buffers",
+    "'gpu memory' shows the host GPU memory used by the color buffers of the guest, the\r\n"
+    "amount of color buffer content evicted to host memory, the total size of the\r\n"
+    "color buffers of the most demanding guest client, then the total size of the\r\n"
+    "color buffers of each guest client, in kilobytes. Client 0 stands for color\r\n"
+    "buffers not created on behalf of a guest client\r\n",
+    NULL, do_gpu_memory, NULL },
+
+    { "limit", "limit the GPU memory used by color buffers",
+    "'gpu limit <megabytes>' sets the amount of host GPU memory that color buffers can\r\n"
+    "use before the least recently used ones are evicted to host memory, 0 means no limit\r\n",
+    NULL, do_gpu_limit, NULL },
+
+    { NULL, NULL, NULL, NULL, NULL, NULL }
+};
+
 /********************************************************************************************/
 /********************************************************************************************/
 /*****                                                                                 ******/
@@ -2982,6 +3661,13 @@ static const CommandDefRec   main_commands[] =
     { "quit|exit", "quit control session", NULL, NULL,
       do_quit, NULL },
 
+    { "binary", "switch to the binary protocol",
+      "'binary' switches this connection to a binary protocol, which runs pipelined and\r\n"
+      "timestamped console commands, and reports changes to the output of commands such\r\n"
+      "as 'power display', 'sensor get <name>' or 'gsm list'.\r\n"
+      "see docs/ANDROID-CONSOLE-BINARY.TXT for details\r\n", NULL,
+      do_binary, NULL },
+
     { "redir",    "manage port redirections",
       "allows you to add, list and remove UDP and/or PORT redirection from the host to the device\r\n"
       "as an example, 'redir  tcp:5000:6000' will route any packet sent to the host's TCP port 5000\r\n"
@@ -3012,6 +3698,10 @@ static const CommandDefRec   main_commands[] =
       "allows you to touch the emulator finger print sensor\r\n", NULL,
       NULL, fingerprint_commands},
 
+    { "gpu", "manage GPU emulation",
+      "allows you to inspect and limit the host GPU memory used by GPU emulation\r\n", NULL,
+      NULL, gpu_commands },
+
     { NULL, NULL, NULL, NULL, NULL, NULL }
 };
 
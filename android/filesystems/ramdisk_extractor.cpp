@@ -14,11 +14,16 @@
 #include "android/base/Compiler.h"
 #include "android/base/Log.h"
 #include "android/base/String.h"
+#include "android/base/StringFormat.h"
+#include "android/utils/path.h"
 
+#include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 
 #define DEBUG 0
@@ -62,6 +67,9 @@ public:
             mFile = NULL;
             mError = errno;
         } else {
+            // The default 8 KiB buffer makes skipping over large entries
+            // slow, since each refill is a separate read() call.
+            gzbuffer(mFile, kBufferSize);
             mError = 0;
         }
     }
@@ -158,6 +166,8 @@ public:
 private:
     DISALLOW_COPY_AND_ASSIGN(GZipInputStream);
 
+    static const unsigned kBufferSize = 128 * 1024;
+
     gzFile mFile;
     int mError;
 };
@@ -284,6 +294,7 @@ bool android_extractRamdiskFile(const char* ramdiskPath,
                 !strcmp(entryName.c_str(), kTrailer)) {
                 D("End of archive reached. Could not find %s in ramdisk image at %s",
                   fileName, ramdiskPath);
+                errno = ENOENT;
                 return false;
             }
 
@@ -312,3 +323,158 @@ bool android_extractRamdiskFile(const char* ramdiskPath,
     errno = input.error();
     return false;
 }
+
+namespace {
+
+using android::base::String;
+using android::base::StringFormat;
+
+// Cache files start with the key of their entry, followed by either
+// kCacheFound and the content of the file, or kCacheMissing if the file
+// is not in the ramdisk, which is also worth caching since finding this
+// out requires inflating the whole ramdisk.
+const char kCacheFound = '+';
+const char kCacheMissing = '-';
+
+// Return the sub-second part of the modification time in |st|, in
+// nanoseconds, or 0 if the host doesn't provide it.
+uint64_t statMtimeNsec(const struct stat& st) {
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+#elif defined(_WIN32)
+    return 0;
+#else
+    return static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#endif
+}
+
+// Return the key of the cache entry of |fileName| in |ramdiskPath|, or an
+// empty string if the ramdisk can't be found. The modification time has
+// sub-second precision where available, so that a ramdisk rewritten with
+// the same size within the same second gets a different key.
+String ramdiskCacheKey(const char* ramdiskPath, const char* fileName) {
+    struct stat st;
+    if (stat(ramdiskPath, &st) < 0) {
+        return String();
+    }
+    return StringFormat("%s\n%" PRIu64 " %" PRIu64 ".%09" PRIu64 "\n%s\n",
+                        ramdiskPath,
+                        static_cast<uint64_t>(st.st_size),
+                        static_cast<uint64_t>(st.st_mtime),
+                        statMtimeNsec(st),
+                        fileName);
+}
+
+// Return the path of the cache file for |key| in |cacheDir|, named after
+// the key's 64-bit FNV-1a hash.
+String ramdiskCachePath(const char* cacheDir, const String& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t n = 0; n < key.size(); ++n) {
+        hash = (hash ^ static_cast<uint8_t>(key[n])) * 1099511628211ULL;
+    }
+    return StringFormat("%s/ramdisk-%016" PRIx64 ".cache", cacheDir, hash);
+}
+
+// Read the cache file at |path|. Return kCacheFound and set |*out| and
+// |*outSize| if it holds the content of the file, kCacheMissing if it
+// records that the file is not in the ramdisk, or 0 if it doesn't exist
+// or doesn't start with |key|.
+char readRamdiskCache(const String& path, const String& key,
+                      char** out, size_t* outSize) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    char result = 0;
+    long fileSize = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        fileSize = ftell(file);
+    }
+    if (fileSize > static_cast<long>(key.size()) &&
+        fseek(file, 0, SEEK_SET) == 0) {
+        String fileKey;
+        fileKey.resize(key.size());
+        char status = 0;
+        if (fread(&fileKey[0], key.size(), 1, file) == 1 && fileKey == key &&
+            fread(&status, 1, 1, file) == 1) {
+            size_t dataSize =
+                    static_cast<size_t>(fileSize) - key.size() - 1U;
+            if (status == kCacheMissing) {
+                result = kCacheMissing;
+            } else if (status == kCacheFound) {
+                char* data = reinterpret_cast<char*>(malloc(dataSize + 1));
+                if (dataSize == 0 || fread(data, dataSize, 1, file) == 1) {
+                    *out = data;
+                    *outSize = dataSize;
+                    result = kCacheFound;
+                } else {
+                    free(data);
+                }
+            }
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// Store |status| and |data| in the cache file at |path|, after |key|.
+// Errors are ignored, since the entry will simply be extracted again next
+// time.
+void writeRamdiskCache(const String& path, const String& key, char status,
+                       const char* data, size_t dataSize) {
+    // Write to a temporary file first, so that concurrent emulators never
+    // read a partial entry.
+    String tempPath = StringFormat("%s.%d", path.c_str(),
+                                   static_cast<int>(getpid()));
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    bool ok = fwrite(key.c_str(), key.size(), 1, file) == 1 &&
+              fwrite(&status, 1, 1, file) == 1 &&
+              (dataSize == 0 || fwrite(data, dataSize, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tempPath.c_str(), path.c_str()) < 0) {
+        unlink(tempPath.c_str());
+    }
+}
+
+}  // namespace
+
+bool android_extractRamdiskFileCached(const char* ramdiskPath,
+                                      const char* fileName,
+                                      const char* cacheDir,
+                                      char** out,
+                                      size_t* outSize) {
+    String key;
+    String cachePath;
+
+    if (cacheDir && path_mkdir_if_needed(cacheDir, 0755) == 0) {
+        key = ramdiskCacheKey(ramdiskPath, fileName);
+    }
+    if (!key.empty()) {
+        cachePath = ramdiskCachePath(cacheDir, key);
+        switch (readRamdiskCache(cachePath, key, out, outSize)) {
+        case kCacheFound:
+            D("Found %s in ramdisk cache %s\n", fileName, cachePath.c_str());
+            return true;
+        case kCacheMissing:
+            errno = ENOENT;
+            return false;
+        }
+    }
+
+    if (!android_extractRamdiskFile(ramdiskPath, fileName, out, outSize)) {
+        // Only cache the absence of the file, not I/O errors.
+        int error = errno;
+        if (!key.empty() && error == ENOENT) {
+            writeRamdiskCache(cachePath, key, kCacheMissing, NULL, 0);
+        }
+        errno = error;
+        return false;
+    }
+    if (!key.empty()) {
+        writeRamdiskCache(cachePath, key, kCacheFound, *out, *outSize);
+    }
+    return true;
+}
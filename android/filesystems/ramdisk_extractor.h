@@ -30,6 +30,18 @@ bool android_extractRamdiskFile(const char* ramdisk_path,
                                 char** out,
                                 size_t* out_size);
 
+// Same as android_extractRamdiskFile(), but first look for the file in
+// |cache_dir|, and store it there after extracting it, to avoid inflating
+// the ramdisk on the next call. Cache entries are keyed by the ramdisk's
+// path, size and modification time, so they are ignored once the ramdisk
+// image changes. If |cache_dir| is NULL, or can't be used, this is the
+// same as android_extractRamdiskFile().
+bool android_extractRamdiskFileCached(const char* ramdisk_path,
+                                      const char* file_path,
+                                      const char* cache_dir,
+                                      char** out,
+                                      size_t* out_size);
+
 ANDROID_END_HEADER
 
 #endif  // ANDROID_FILESYSTEMS_RAMDISK_EXTRACTOR_H
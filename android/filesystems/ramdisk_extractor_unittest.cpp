@@ -12,11 +12,16 @@
 #include "android/filesystems/ramdisk_extractor.h"
 
 #include "android/base/EintrWrapper.h"
+#include "android/base/testing/TestTempDir.h"
 #include "android/filesystems/testing/TestSupport.h"
 
 #include <gtest/gtest.h>
 
 #include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 
 namespace {
 
@@ -100,3 +105,74 @@ TEST_F(RamdiskExtractorTest, MissingFile) {
     EXPECT_TRUE(fillData(kTestRamdiskImage, kTestRamdiskImageSize));
     EXPECT_FALSE(android_extractRamdiskFile(path(), "zoolander", &out, &outSize));
 }
+
+TEST_F(RamdiskExtractorTest, CachedExtraction) {
+    static const char kExpected[] = "Meow!!\n";
+    static const size_t kExpectedSize = sizeof(kExpected) - 1U;
+    android::base::TestTempDir cacheDir("ramdisk-cache");
+    char* out = NULL;
+    size_t outSize = 0;
+
+    ASSERT_TRUE(cacheDir.path());
+    EXPECT_TRUE(fillData(kTestRamdiskImage, kTestRamdiskImageSize));
+
+    // First call extracts the file and fills the cache.
+    EXPECT_TRUE(android_extractRamdiskFileCached(
+            path(), "zoo", cacheDir.path(), &out, &outSize));
+    EXPECT_EQ(kExpectedSize, outSize);
+    EXPECT_TRUE(!memcmp(out, kExpected, outSize));
+    free(out);
+    out = NULL;
+
+    // Second call must get the same content from the cache.
+    EXPECT_TRUE(android_extractRamdiskFileCached(
+            path(), "zoo", cacheDir.path(), &out, &outSize));
+    EXPECT_EQ(kExpectedSize, outSize);
+    EXPECT_TRUE(!memcmp(out, kExpected, outSize));
+    free(out);
+    out = NULL;
+
+    // Missing files are cached too.
+    EXPECT_FALSE(android_extractRamdiskFileCached(
+            path(), "zoolander", cacheDir.path(), &out, &outSize));
+    EXPECT_FALSE(android_extractRamdiskFileCached(
+            path(), "zoolander", cacheDir.path(), &out, &outSize));
+
+    // A different ramdisk image must not use the cached entries.
+    static const char kGarbage[] = "not a ramdisk";
+    EXPECT_TRUE(fillData(kGarbage, sizeof(kGarbage)));
+    EXPECT_FALSE(android_extractRamdiskFileCached(
+            path(), "zoo", cacheDir.path(), &out, &outSize));
+}
+
+#ifndef _WIN32
+TEST_F(RamdiskExtractorTest, CachedExtractionSameSizeRewrite) {
+    android::base::TestTempDir cacheDir("ramdisk-cache");
+    char* out = NULL;
+    size_t outSize = 0;
+
+    // Both versions of the image have the same size and modification
+    // second, only the sub-second part of their modification time differs.
+    struct timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = 1400000000;
+    times[0].tv_usec = times[1].tv_usec = 100;
+
+    ASSERT_TRUE(cacheDir.path());
+    EXPECT_TRUE(fillData(kTestRamdiskImage, kTestRamdiskImageSize));
+    ASSERT_EQ(0, utimes(path(), times));
+
+    EXPECT_TRUE(android_extractRamdiskFileCached(
+            path(), "zoo", cacheDir.path(), &out, &outSize));
+    free(out);
+    out = NULL;
+
+    unsigned char garbage[kTestRamdiskImageSize];
+    memset(garbage, 'x', sizeof(garbage));
+    EXPECT_TRUE(fillData(garbage, sizeof(garbage)));
+    times[0].tv_usec = times[1].tv_usec = 200;
+    ASSERT_EQ(0, utimes(path(), times));
+
+    EXPECT_FALSE(android_extractRamdiskFileCached(
+            path(), "zoo", cacheDir.path(), &out, &outSize));
+}
+#endif  // !_WIN32
@@ -999,6 +999,21 @@ help_code_profile(stralloc_t*  out)
     );
 }
 
+static void
+help_guest_profile(stralloc_t*  out)
+{
+    PRINTF(
+    "  use '-guest-profile <file>' to sample the emulated CPU every 10 ms and\n"
+    "  write a CPU profile of the guest to <file>, in the format used by pprof.\n"
+    "  Samples in user space are attributed to guest binaries, using the mappings\n"
+    "  reported by the kernel, so that pprof can symbolize them with unstripped\n"
+    "  copies of these binaries. The file is updated every minute, and on exit.\n\n"
+    "  IMPORTANT: This is ARM only, and is ignored on x86 and MIPS. It requires\n"
+    "  a kernel with support for the qemu_trace device, and does not work with\n"
+    "  hardware acceleration (KVM or HAXM).\n\n"
+    );
+}
+
 static void
 help_show_kernel(stralloc_t*  out)
 {
@@ -1452,7 +1467,9 @@ help_gpu(stralloc_t* out)
     "     off      -> disable GPU emulation\n"
     "     auto     -> use the setting from the AVD\n"
     "     enabled  -> same as 'on'\n"
-    "     disabled -> same as 'off'\n\n"
+    "     disabled -> same as 'off'\n"
+    "     headless -> render with the host GPU without a window system\n"
+    "                 (Linux only, uses EGL device or surfaceless platforms)\n\n"
 
     "  Note that enabling GPU emulation if the system image does not support it\n"
     "  will prevent the proper display of the emulated framebuffer.\n\n"
@@ -1541,6 +1558,87 @@ help_force_32bit(stralloc_t* out)
     );
 }
 
+static void
+help_tickless(stralloc_t* out)
+{
+    PRINTF(
+    "  Use -tickless to reduce the number of times the emulator wakes up the\n"
+    "  host CPU while the emulated system is idle. In this mode:\n\n"
+
+    "    - the display is refreshed less often when its content doesn't change,\n"
+    "      and immediately when the emulated system posts a new frame.\n\n"
+
+    "    - sensor reports are sent less often when sensor values don't change.\n\n"
+
+    "    - the main loop only wakes up for pending timers.\n\n"
+
+    "  This can increase the latency of the first user input event after a\n"
+    "  period of inactivity. Use the 'avd stats' console command to see the\n"
+    "  current number of wakeups per second.\n\n"
+    );
+}
+
+static void
+help_memory_balloon(stralloc_t* out)
+{
+    PRINTF(
+    "  Use -memory-balloon to add a memory balloon device to the emulated system.\n"
+    "  With a guest kernel that supports it, the system returns free memory pages\n"
+    "  to the host, and can be asked to give up more of its RAM with the\n"
+    "  'avd balloon <size>' console command. This lets more emulators run on a\n"
+    "  host than their RAM sizes would otherwise allow.\n\n"
+    );
+}
+
+static void
+help_tcg_traces(stralloc_t* out)
+{
+    PRINTF(
+    "  Use -tcg-traces to let the ARM translator optimize frequently executed\n"
+    "  code. Once a translated block has run a given number of times, it is\n"
+    "  translated again as a trace that follows the most likely outcome of its\n"
+    "  branches, instead of ending at the first one.\n\n"
+
+    "  This is ignored on x86 and MIPS, when using hardware acceleration, and\n"
+    "  with -icount. Use the 'avd jit' console command to see the number of\n"
+    "  traces.\n\n"
+    );
+}
+
+static void
+help_perf_map(stralloc_t* out)
+{
+    PRINTF(
+    "  Use -perf-map to write /tmp/perf-<pid>.map while the emulator runs,\n"
+    "  so that 'perf report' attributes the time spent in translated code to\n"
+    "  the guest code it comes from, instead of an anonymous memory region.\n"
+    "  Each block is named after its guest address and, on ARM only, after\n"
+    "  the guest binary and file offset when the kernel supports the\n"
+    "  qemu_trace device.\n\n"
+
+    "  The map only describes the code currently in the translation cache,\n"
+    "  and is emptied each time the cache is flushed. This is ignored when\n"
+    "  using hardware acceleration.\n\n"
+    );
+}
+
+static void
+help_snapshot_ram_dir(stralloc_t* out)
+{
+    PRINTF(
+    "  Use '-snapshot-ram-dir <dir>' to store the RAM of named snapshots as\n"
+    "  separate files in <dir>, instead of inside the snapshot storage file.\n\n"
+
+    "  Loading such a snapshot maps its RAM file into the emulated system, so\n"
+    "  pages are only read when the system accesses them, and unmodified pages\n"
+    "  are shared by all emulators that load the same snapshot.\n\n"
+
+    "  The snapshot storage file only records the path of the RAM file, which\n"
+    "  must be kept. Saving a snapshot with the same name in the same <dir>\n"
+    "  makes older snapshots that use this file fail to load.\n\n"
+    );
+}
+
 #define  help_no_skin   NULL
 #define  help_netspeed  help_shaper
 #define  help_netdelay  help_shaper
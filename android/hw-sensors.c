@@ -19,6 +19,7 @@
 #include "android/globals.h"
 #include "hw/hw.h"
 #include "sysemu/char.h"
+#include "sysemu/sysemu.h"
 #include "qemu/timer.h"
 #include "android/sensors-port.h"
 
@@ -166,6 +167,10 @@ typedef struct {
 #define  HEADER_SIZE  4
 #define  BUFFER_SIZE  512
 
+/* In tickless mode, the maximum delay in milliseconds between two reports
+ * to a client when sensor values don't change. */
+#define  SENSORS_IDLE_DELAY_MS  1000
+
 typedef struct HwSensorClient   HwSensorClient;
 
 typedef struct {
@@ -173,6 +178,7 @@ typedef struct {
     Sensor              sensors[MAX_SENSORS];
     HwSensorClient*     clients;
     AndroidSensorsPort* sensors_port;
+    uint32_t            generation;  /* incremented on value changes */
 } HwSensors;
 
 struct HwSensorClient {
@@ -182,6 +188,9 @@ struct HwSensorClient {
     QEMUTimer*       timer;
     uint32_t         enabledMask;
     int32_t          delay_ms;
+    int32_t          idle_delay_ms;  /* current delay in tickless mode */
+    uint32_t         generation;     /* sensors->generation at last report */
+    int64_t          last_report_ns;
 };
 
 static void
@@ -341,6 +350,7 @@ _hwSensorClient_tick( void*  opaque )
 
     snprintf(buffer, sizeof buffer, "sync:%" PRId64, now_ns/1000);
     _hwSensorClient_send(cl, (uint8_t*)buffer, strlen(buffer));
+    cl->last_report_ns = now_ns;
 
     /* rearm timer, use a minimum delay of 20 ms, just to
      * be safe.
@@ -351,6 +361,21 @@ _hwSensorClient_tick( void*  opaque )
     if (delay < 20)
         delay = 20;
 
+    /* In tickless mode, double the delay each time the values didn't
+     * change since the last report, up to SENSORS_IDLE_DELAY_MS. Value
+     * changes bring it back through _hwSensors_valuesChanged(). */
+    if (tickless_idle) {
+        if (cl->generation != hw->generation || cl->idle_delay_ms < delay) {
+            cl->idle_delay_ms = delay;
+        } else if (cl->idle_delay_ms < SENSORS_IDLE_DELAY_MS) {
+            cl->idle_delay_ms *= 2;
+            if (cl->idle_delay_ms > SENSORS_IDLE_DELAY_MS)
+                cl->idle_delay_ms = SENSORS_IDLE_DELAY_MS;
+        }
+        cl->generation = hw->generation;
+        delay = cl->idle_delay_ms;
+    }
+
     delay *= 1000000LL;  /* convert to nanoseconds */
     timer_mod(cl->timer, now_ns + delay);
 }
@@ -496,6 +521,29 @@ _hwSensors_connect( void*  opaque,
     return client;
 }
 
+/* called after any sensor value change. In tickless mode, this ensures
+ * that idle clients get a report at their requested rate again. */
+static void
+_hwSensors_valuesChanged( HwSensors*  h )
+{
+    HwSensorClient*  cl;
+
+    h->generation++;
+    if (!tickless_idle)
+        return;
+
+    for (cl = h->clients; cl != NULL; cl = cl->next) {
+        int64_t  delay = cl->delay_ms;
+
+        if (cl->enabledMask == 0 || !timer_pending(cl->timer))
+            continue;
+        if (delay < 20)
+            delay = 20;
+        timer_mod_anticipate(cl->timer,
+                             cl->last_report_ns + delay * 1000000LL);
+    }
+}
+
 /* change the value of the emulated sensor vector */
 static void
 _hwSensors_setSensorValue( HwSensors*  h, int sensor_id, float a, float b, float c )
@@ -505,6 +553,7 @@ _hwSensors_setSensorValue( HwSensors*  h, int sensor_id, float a, float b, float
     s->u.value.a = a;
     s->u.value.b = b;
     s->u.value.c = c;
+    _hwSensors_valuesChanged(h);
 }
 
 /* Saves available sensors to allow checking availability when loaded.
@@ -620,6 +669,7 @@ _hwSensors_setProximity( HwSensors*  h, float value )
 {
     Sensor*  s = &h->sensors[ANDROID_SENSOR_PROXIMITY];
     s->u.proximity.value = value;
+    _hwSensors_valuesChanged(h);
 }
 
 /* change the coarse orientation (landscape/portrait) of the emulated device */
@@ -491,6 +491,27 @@ int main(int argc, char **argv) {
         args[n++] = "-netfast";
     }
 
+    if (opts->tickless) {
+        args[n++] = "-tickless";
+    }
+
+    if (opts->memory_balloon) {
+        args[n++] = "-goldfish-balloon";
+    }
+
+    if (opts->tcg_traces) {
+        args[n++] = "-tcg-traces";
+    }
+
+    if (opts->perf_map) {
+        args[n++] = "-perf-map";
+    }
+
+    if (opts->snapshot_ram_dir) {
+        args[n++] = "-snapshot-ram-dir";
+        args[n++] = opts->snapshot_ram_dir;
+    }
+
     if (opts->audio) {
         args[n++] = "-audio";
         args[n++] = opts->audio;
@@ -657,6 +678,11 @@ int main(int argc, char **argv) {
         args[n++] = opts->code_profile;
     }
 
+    if (opts->guest_profile) {
+        args[n++] = "-guest-profile";
+        args[n++] = opts->guest_profile;
+    }
+
     /* Pass boot properties to the core. First, those from boot.prop,
      * then those from the command-line */
     const FileData* bootProperties = avdInfo_getBootProperties(avd);
@@ -134,12 +134,15 @@ bool emuglConfig_init(EmuglConfig* config,
     }
 
     // 'host' is a special value corresponding to the default translation
-    // to desktop GL, anything else must be checked against existing backends.
-    if (strcmp(gpu_mode, "host") != 0) {
+    // to desktop GL, and 'headless' is the same translation without a
+    // window system. Anything else must be checked against existing
+    // backends.
+    if (strcmp(gpu_mode, "host") != 0 && strcmp(gpu_mode, "headless") != 0) {
         const StringVector& backends = sBackendList->names();
         if (!stringVectorContains(backends, gpu_mode)) {
             String error = StringFormat(
-                "Invalid GPU mode '%s', use one of: on off host", gpu_mode);
+                "Invalid GPU mode '%s', use one of: on off host headless",
+                gpu_mode);
             for (size_t n = 0; n < backends.size(); ++n) {
                 error += " ";
                 error += backends[n];
@@ -179,7 +182,9 @@ void emuglConfig_setupEnv(const EmuglConfig* config) {
     String newDirs = StringFormat("%s/%s",
                                   System::get()->getProgramDirectory().c_str(),
                                   libSubDir);
-    if (strcmp(config->backend, "host") != 0) {
+    bool isHostBackend = !strcmp(config->backend, "host") ||
+                         !strcmp(config->backend, "headless");
+    if (!isHostBackend) {
         // If the backend is not 'host', we also need to add the
         // backend directory.
         String dir = sBackendList->getLibDirPath(config->backend);
@@ -192,7 +197,14 @@ void emuglConfig_setupEnv(const EmuglConfig* config) {
     D("Adding to the library search path: %s\n", newDirs.c_str());
     system->addLibrarySearchDir(newDirs.c_str());
 
-    if (!strcmp(config->backend, "host")) {
+    if (!strcmp(config->backend, "headless")) {
+        // Tell EmuGL to use a headless EGL engine, and to deliver frames
+        // through its post callback instead of a sub-window.
+        system->envSet("ANDROID_EMUGL_HEADLESS", "1");
+        return;
+    }
+
+    if (isHostBackend) {
         // Nothing more to do for the 'host' backend.
         return;
     }
@@ -240,6 +240,31 @@ TEST(EmuglConfig, initNoWindowWithoutMesa) {
                  config.status);
 }
 
+TEST(EmuglConfig, initHeadless) {
+    TestSystem testSys("foo", System::kProgramBitness);
+    TestTempDir* myDir = testSys.getTempRoot();
+    myDir->makeSubDir(System::get()->getProgramDirectory().c_str());
+    makeLibSubDir(myDir, "");
+
+    {
+        EmuglConfig config;
+        EXPECT_TRUE(emuglConfig_init(
+                &config, false, "host", "headless", 0, true));
+        EXPECT_TRUE(config.enabled);
+        EXPECT_STREQ("headless", config.backend);
+        EXPECT_STREQ("GPU emulation enabled using 'headless' mode",
+                     config.status);
+    }
+
+    {
+        EmuglConfig config;
+        EXPECT_TRUE(emuglConfig_init(
+                &config, true, "headless", NULL, 0, false));
+        EXPECT_TRUE(config.enabled);
+        EXPECT_STREQ("headless", config.backend);
+    }
+}
+
 TEST(EmuglConfig, setupEnv) {
 }
 
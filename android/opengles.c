@@ -59,6 +59,9 @@ typedef void* FBNativeWindowType;
   FUNCTION_VOID_(setOpenGLDisplayRotation, (float zRot), (zRot)) \
   FUNCTION_VOID_(repaintOpenGLDisplay, (void), ()) \
   FUNCTION_(int, stopOpenGLRenderer, (void), ()) \
+  FUNCTION_VOID_(getColorBufferMemoryUsage, (uint64_t* residentBytes, uint64_t* evictedBytes, uint64_t* maxThreadBytes), (residentBytes, evictedBytes, maxThreadBytes)) \
+  FUNCTION_(int, getColorBufferThreadMemoryUsage, (uint32_t* threadIds, uint64_t* threadBytes, int maxThreads), (threadIds, threadBytes, maxThreads)) \
+  FUNCTION_VOID_(setColorBufferMemoryLimit, (uint64_t maxBytes), (maxBytes)) \
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -153,6 +156,10 @@ android_initOpenglesEmulation(void)
     if (env && env[0] != '\0' && env[0] != '0') {
         rendererUsesSubWindow = false;
     }
+    env = getenv("ANDROID_EMUGL_HEADLESS");
+    if (env && env[0] != '\0' && env[0] != '0') {
+        rendererUsesSubWindow = false;
+    }
 
     if (android_gles_fast_pipes) {
 #ifdef _WIN32
@@ -313,6 +320,37 @@ android_redrawOpenglesWindow(void)
     }
 }
 
+void
+android_getOpenglesMemoryUsage(uint64_t* residentBytes,
+                               uint64_t* evictedBytes,
+                               uint64_t* maxClientBytes)
+{
+    if (!rendererStarted) {
+        *residentBytes = *evictedBytes = *maxClientBytes = 0;
+        return;
+    }
+    getColorBufferMemoryUsage(residentBytes, evictedBytes, maxClientBytes);
+}
+
+int
+android_getOpenglesClientMemoryUsage(uint32_t* clientIds,
+                                     uint64_t* clientBytes,
+                                     int maxClients)
+{
+    if (!rendererStarted) {
+        return 0;
+    }
+    return getColorBufferThreadMemoryUsage(clientIds, clientBytes, maxClients);
+}
+
+void
+android_setOpenglesMemoryLimit(uint64_t maxBytes)
+{
+    if (rendererStarted) {
+        setColorBufferMemoryLimit(maxBytes);
+    }
+}
+
 void
 android_gles_server_path(char* buff, size_t buffsize)
 {
@@ -13,6 +13,7 @@
 #define ANDROID_OPENGLES_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "android/utils/compiler.h"
 
@@ -53,6 +54,31 @@ int android_hideOpenglesWindow(void);
 
 void android_redrawOpenglesWindow(void);
 
+/* Retrieve the host GPU memory used by the color buffers of the renderer.
+ * |*residentBytes| is the amount of GPU memory in use, |*evictedBytes| the
+ * amount of color buffer content evicted to host memory, and |*maxClientBytes|
+ * the total size of the color buffers created by the most demanding guest
+ * client. All values are 0 if the renderer is not started.
+ */
+void android_getOpenglesMemoryUsage(uint64_t* residentBytes,
+                                    uint64_t* evictedBytes,
+                                    uint64_t* maxClientBytes);
+
+/* Retrieve the total size of the color buffers created by each guest client.
+ * Fills |clientIds| and |clientBytes| for at most |maxClients| clients and
+ * returns the number of clients owning color buffers, which can be larger
+ * than |maxClients|. Client id 0 stands for color buffers not created on
+ * behalf of a guest client. Returns 0 if the renderer is not started.
+ */
+int android_getOpenglesClientMemoryUsage(uint32_t* clientIds,
+                                         uint64_t* clientBytes,
+                                         int maxClients);
+
+/* Set the maximum amount of host GPU memory that color buffers can use before
+ * unused ones get evicted to host memory. 0 means no limit.
+ */
+void android_setOpenglesMemoryLimit(uint64_t maxBytes);
+
 /* Stop the renderer process */
 void android_stopOpenglesRenderer(void);
 
@@ -15,7 +15,6 @@
 #include <stdlib.h>
 
 #define  SHAPER_CLOCK        QEMU_CLOCK_REALTIME
-#define  SHAPER_CLOCK_UNIT   1000.
 
 static int
 _packet_is_internal( const uint8_t*  data, size_t  size )
@@ -43,22 +42,36 @@ _packet_is_internal( const uint8_t*  data, size_t  size )
  * that it takes 1/MAX_RATE seconds to send a single bit, and count*8/MAX_RATE
  * seconds to send 'count' bytes.
  *
- * we're going to implement a scheme where, when we send a packet of
- * 'count' bytes, no other packet will go through in the same direction for
- * at least 'count*8/MAX_RATE' seconds. any successive packet that is "sent"
- * in this interval is placed in a queue, associated to a timer
+ * we use a token bucket per direction: a packet of 'count' bytes can go
+ * through immediately if the bucket has enough credit, otherwise it is
+ * placed in a queue until enough credit has accumulated. the bucket is only
+ * SHAPER_BUCKET_BYTES deep, so that short bursts go through unchanged, while
+ * the long-term rate is still MAX_RATE.
+ *
+ * delayed packets are kept in a PacketWheel (see below), which is also used
+ * to model packet loss, jitter and reordering, and to delay new connections
+ * in NetDelay objects.
  *
  * there are different (queue/timer/rate) values for the input and output
  * direction of the user vlan.
  */
 typedef struct QueuedPacketRec_ {
-    int64_t                    expiration;
+    int64_t                    expiration;  /* in ns */
     struct QueuedPacketRec_*   next;
     size_t                     size;
     void*                      opaque;
     void*                      data;
+    void*                      owner;       /* see netdelay_send_packet() */
+    int                        pooled;
 } QueuedPacketRec, *QueuedPacket;
 
+/* packets that fit in SHAPER_POOL_DATA_SIZE bytes are allocated from a
+ * free list, to avoid a malloc/free pair per delayed packet. */
+#define  SHAPER_POOL_DATA_SIZE  2048
+#define  SHAPER_POOL_MAX_FREE   512
+
+static QueuedPacket  _packet_pool;
+static int           _packet_pool_count;
 
 static QueuedPacket
 queued_packet_create( const void*   data,
@@ -67,16 +80,25 @@ queued_packet_create( const void*   data,
                       int           do_copy )
 {
     QueuedPacket   packet;
-    size_t         packet_size = sizeof(*packet);
-
-    if (do_copy)
-        packet_size += size;
 
-    packet = g_malloc(packet_size);
+    if (do_copy && size <= SHAPER_POOL_DATA_SIZE) {
+        packet = _packet_pool;
+        if (packet) {
+            _packet_pool = packet->next;
+            _packet_pool_count--;
+        } else {
+            packet = g_malloc(sizeof(*packet) + SHAPER_POOL_DATA_SIZE);
+        }
+        packet->pooled = 1;
+    } else {
+        packet = g_malloc(sizeof(*packet) + (do_copy ? size : 0));
+        packet->pooled = 0;
+    }
     packet->next       = NULL;
     packet->expiration = 0;
     packet->size       = (size_t)size;
     packet->opaque     = opaque;
+    packet->owner      = NULL;
 
     if (do_copy) {
         packet->data = (void*)(packet+1);
@@ -91,18 +113,313 @@ static void
 queued_packet_free( QueuedPacket  packet )
 {
     if (packet) {
-        g_free( packet );
+        if (packet->pooled && _packet_pool_count < SHAPER_POOL_MAX_FREE) {
+            packet->next = _packet_pool;
+            _packet_pool = packet;
+            _packet_pool_count++;
+        } else {
+            g_free( packet );
+        }
     }
 }
 
+/* a PacketWheel is a hierarchical timing wheel of queued packets, with
+ * PACKET_WHEEL_LEVELS levels of PACKET_WHEEL_SIZE slots. each slot of level
+ * 'l' covers 2^(PACKET_WHEEL_BITS*l) ticks of PACKET_WHEEL_TICK_NS ns.
+ *
+ * insertion is O(1), and each packet is moved at most once per level
+ * before it expires, instead of the O(n) sorted insertion we used before.
+ * packets that expire during the same tick are sent in insertion order.
+ */
+#define  PACKET_WHEEL_TICK_SHIFT  10    /* ~1 microsecond */
+#define  PACKET_WHEEL_BITS        8
+#define  PACKET_WHEEL_SIZE        (1 << PACKET_WHEEL_BITS)
+#define  PACKET_WHEEL_MASK        (PACKET_WHEEL_SIZE - 1)
+#define  PACKET_WHEEL_LEVELS      4
+#define  PACKET_WHEEL_WORDS       (PACKET_WHEEL_SIZE / 64)
+
+typedef void (*PacketWheelFunc)( void*  opaque, QueuedPacket  packet );
+
+typedef struct {
+    QueuedPacket  first;
+    QueuedPacket  last;
+} PacketList;
+
+typedef struct {
+    PacketList       slots[PACKET_WHEEL_LEVELS][PACKET_WHEEL_SIZE];
+    uint64_t         used[PACKET_WHEEL_LEVELS][PACKET_WHEEL_WORDS];
+    int64_t          tick;       /* first tick that was not processed yet */
+    int              count;
+    QEMUTimer*       timer;
+    int64_t          timer_tick; /* -1 if timer not armed */
+    PacketWheelFunc  func;       /* called for each expired packet */
+    void*            opaque;
+} PacketWheel;
+
+static void  packet_wheel_expires( PacketWheel*  wheel );
+
+static void
+packet_wheel_init( PacketWheel*  wheel, PacketWheelFunc  func, void*  opaque )
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tick       = qemu_clock_get_ns(SHAPER_CLOCK) >> PACKET_WHEEL_TICK_SHIFT;
+    wheel->timer      = timer_new( SHAPER_CLOCK, SCALE_NS,
+                                   (QEMUTimerCB*) packet_wheel_expires,
+                                   wheel );
+    wheel->timer_tick = -1;
+    wheel->func       = func;
+    wheel->opaque     = opaque;
+}
+
+static void
+packet_wheel_insert( PacketWheel*  wheel, QueuedPacket  packet )
+{
+    int64_t     tick  = packet->expiration >> PACKET_WHEEL_TICK_SHIFT;
+    int64_t     delta;
+    int         level, slot;
+    PacketList* list;
+
+    if (tick < wheel->tick)
+        tick = wheel->tick;
+
+    delta = tick - wheel->tick;
+    for (level = 0; level < PACKET_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1LL << (PACKET_WHEEL_BITS*(level+1))))
+            break;
+    }
+    if (delta >= (1LL << (PACKET_WHEEL_BITS*PACKET_WHEEL_LEVELS))) {
+        /* too far in the future, will be re-inserted when the last
+         * level's slot is cascaded */
+        tick = wheel->tick + (1LL << (PACKET_WHEEL_BITS*PACKET_WHEEL_LEVELS)) - 1;
+    }
+    slot = (int)(tick >> (PACKET_WHEEL_BITS*level)) & PACKET_WHEEL_MASK;
+
+    list = &wheel->slots[level][slot];
+    packet->next = NULL;
+    if (list->last)
+        list->last->next = packet;
+    else
+        list->first = packet;
+    list->last = packet;
+
+    wheel->used[level][slot >> 6] |= 1ULL << (slot & 63);
+    wheel->count++;
+}
+
+static QueuedPacket
+packet_wheel_take_slot( PacketWheel*  wheel, int  level, int  slot )
+{
+    PacketList*   list   = &wheel->slots[level][slot];
+    QueuedPacket  packet = list->first;
+
+    list->first = list->last = NULL;
+    wheel->used[level][slot >> 6] &= ~(1ULL << (slot & 63));
+    return packet;
+}
+
+/* return the first used slot of |level| at or after |start|, wrapping
+ * around, or -1 if there are none. */
+static int
+packet_wheel_find_slot( PacketWheel*  wheel, int  level, int  start )
+{
+    int  n;
+    for (n = 0; n < PACKET_WHEEL_SIZE; n++) {
+        int  slot = (start + n) & PACKET_WHEEL_MASK;
+        uint64_t  word = wheel->used[level][slot >> 6] >> (slot & 63);
+        if (word == 0) {
+            /* skip to the next word */
+            n += 63 - (slot & 63);
+            continue;
+        }
+        return (slot + __builtin_ctzll(word)) & PACKET_WHEEL_MASK;
+    }
+    return -1;
+}
+
+/* return the next tick at which the wheel needs to do something, i.e. send
+ * packets from a level 0 slot, or cascade a higher-level slot */
+static int64_t
+packet_wheel_next_tick( PacketWheel*  wheel )
+{
+    int64_t  result = -1;
+    int      level;
+
+    for (level = 0; level < PACKET_WHEEL_LEVELS; level++) {
+        int      shift   = PACKET_WHEEL_BITS*level;
+        int64_t  pos     = wheel->tick >> shift;
+        int      current = (int)(pos & PACKET_WHEEL_MASK);
+        int      start   = (level == 0) ? current : current + 1;
+        int      slot    = packet_wheel_find_slot(wheel, level, start);
+        int64_t  tick;
+
+        if (slot < 0)
+            continue;
+
+        pos -= current;
+        if (slot < start)
+            pos += PACKET_WHEEL_SIZE;
+        tick = (pos + slot) << shift;
+
+        if (result < 0 || tick < result)
+            result = tick;
+    }
+    return result;
+}
+
+/* re-insert the packets of the higher-level slots that start at the
+ * current tick. */
+static void
+packet_wheel_cascade( PacketWheel*  wheel )
+{
+    int  level;
+
+    for (level = 1; level < PACKET_WHEEL_LEVELS; level++) {
+        int           shift = PACKET_WHEEL_BITS*level;
+        int           slot;
+        QueuedPacket  packet;
+
+        if ((wheel->tick & ((1LL << shift) - 1)) != 0)
+            break;
+
+        slot   = (int)(wheel->tick >> shift) & PACKET_WHEEL_MASK;
+        packet = packet_wheel_take_slot(wheel, level, slot);
+        while (packet) {
+            QueuedPacket  next = packet->next;
+            wheel->count--;
+            packet_wheel_insert(wheel, packet);
+            packet = next;
+        }
+    }
+}
+
+static void
+packet_wheel_rearm( PacketWheel*  wheel )
+{
+    int64_t  next = packet_wheel_next_tick(wheel);
+
+    if (next < 0) {
+        if (wheel->timer_tick >= 0) {
+            timer_del(wheel->timer);
+            wheel->timer_tick = -1;
+        }
+    } else if (next != wheel->timer_tick) {
+        timer_mod(wheel->timer, next << PACKET_WHEEL_TICK_SHIFT);
+        wheel->timer_tick = next;
+    }
+}
+
+/* send all packets that expired at or before |now| (in ns) */
+static void
+packet_wheel_run( PacketWheel*  wheel, int64_t  now )
+{
+    int64_t  now_tick = now >> PACKET_WHEEL_TICK_SHIFT;
+
+    while (wheel->count > 0) {
+        int64_t       next = packet_wheel_next_tick(wheel);
+        QueuedPacket  packet;
+
+        if (next > now_tick)
+            break;
+
+        wheel->tick = next;
+        if ((next & PACKET_WHEEL_MASK) == 0)
+            packet_wheel_cascade(wheel);
+
+        packet = packet_wheel_take_slot(wheel, 0, (int)(next & PACKET_WHEEL_MASK));
+        while (packet) {
+            QueuedPacket  nextp = packet->next;
+            wheel->count--;
+            packet->next = NULL;
+            wheel->func(wheel->opaque, packet);
+            packet = nextp;
+        }
+    }
+
+    /* there is nothing to do until the next tick, which may be far away.
+     * all higher-level slots starting at or before |now_tick| were handled
+     * above, but the ones starting at the new tick must be cascaded now,
+     * since packet_wheel_next_tick() only looks at the following ones. */
+    if (wheel->tick <= now_tick) {
+        wheel->tick = now_tick + 1;
+        if ((wheel->tick & PACKET_WHEEL_MASK) == 0)
+            packet_wheel_cascade(wheel);
+    }
+
+    packet_wheel_rearm(wheel);
+}
+
+static void
+packet_wheel_add( PacketWheel*  wheel, QueuedPacket  packet )
+{
+    packet_wheel_insert(wheel, packet);
+    packet_wheel_rearm(wheel);
+}
+
+static void
+packet_wheel_expires( PacketWheel*  wheel )
+{
+    wheel->timer_tick = -1;
+    packet_wheel_run(wheel, qemu_clock_get_ns(SHAPER_CLOCK));
+}
+
+/* call |wheel->func| on all packets, in expiration order, regardless of
+ * the current time. */
+static void
+packet_wheel_flush( PacketWheel*  wheel )
+{
+    packet_wheel_run(wheel, INT64_MAX >> 1);
+    wheel->tick = qemu_clock_get_ns(SHAPER_CLOCK) >> PACKET_WHEEL_TICK_SHIFT;
+    packet_wheel_rearm(wheel);
+}
+
+static void
+packet_wheel_done( PacketWheel*  wheel )
+{
+    int  level, slot;
+
+    for (level = 0; level < PACKET_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < PACKET_WHEEL_SIZE; slot++) {
+            QueuedPacket  packet = packet_wheel_take_slot(wheel, level, slot);
+            while (packet) {
+                QueuedPacket  next = packet->next;
+                queued_packet_free(packet);
+                packet = next;
+            }
+        }
+    }
+    wheel->count = 0;
+    timer_del(wheel->timer);
+    timer_free(wheel->timer);
+    wheel->timer = NULL;
+}
+
+/* return a random number in [0..1) */
+static double
+_shaper_random( void )
+{
+    return rand() / ((double)RAND_MAX + 1.);
+}
+
+/* maximum credit of the token bucket, in bytes */
+#define  SHAPER_BUCKET_BYTES   (2*1514)
+
+/* minimum extra delay of a reordered packet, in ns, so that it can be
+ * overtaken even without jitter */
+#define  SHAPER_REORDER_NS     (10*1000000LL)
+
 typedef struct NetShaperRec_ {
-    QueuedPacket   packets;   /* list of queued packets, ordered by expiration date */
-    int            num_packets;
+    PacketWheel    wheel;     /* queued packets, by expiration date */
     int            active;    /* is this shaper active ? */
-    int64_t        block_until;
-    double         max_rate;  /* max rate expressed in bytes/second */
-    double         inv_rate;  /* inverse of max rate                */
-    QEMUTimer*     timer;     /* QEMU timer */
+    int            limited;   /* is the rate limited ? */
+    int64_t        block_until;  /* time the bucket is empty until, in ns */
+    int64_t        last_expiration;  /* of the last queued packet, in ns */
+    double         max_rate;  /* max rate expressed in bits/second */
+    double         ns_per_byte;
+    int64_t        bucket_ns; /* bucket depth, in ns */
+
+    double         loss;      /* probability to drop a packet */
+    int64_t        jitter_ns; /* maximum random extra delay */
+    double         reorder;   /* probability to let a packet be overtaken */
 
     int                do_copy;
     NetShaperSendFunc  send_func;
@@ -110,71 +427,47 @@ typedef struct NetShaperRec_ {
 } NetShaperRec;
 
 
+static void
+netshaper_send_packet( void*  opaque, QueuedPacket  packet )
+{
+    NetShaper  shaper = opaque;
+
+    shaper->send_func( packet->data, packet->size, packet->opaque );
+    queued_packet_free(packet);
+}
+
 void
 netshaper_destroy( NetShaper  shaper )
 {
     if (shaper) {
         shaper->active = 0;
-
-        while (shaper->packets) {
-            QueuedPacket  packet = shaper->packets;
-            shaper->packets = packet->next;
-            packet->next    = NULL;
-            queued_packet_free(packet);
-        }
-
-        timer_del(shaper->timer);
-        timer_free(shaper->timer);
-        shaper->timer = NULL;
+        packet_wheel_done(&shaper->wheel);
         g_free(shaper);
     }
 }
 
-/* this function is called when the shaper's timer expires */
 static void
-netshaper_expires( NetShaper  shaper )
+netshaper_update_active( NetShaper  shaper )
 {
-    QueuedPacket  packet;
-
-    while ((packet = shaper->packets) != NULL) {
-        int64_t   now = qemu_clock_get_ms( SHAPER_CLOCK );
-
-       if (packet->expiration > now)
-           break;
-
-       shaper->packets = packet->next;
-       shaper->send_func( packet->data, packet->size, packet->opaque );
-       queued_packet_free(packet);
-       shaper->num_packets--;
-   }
-
-   /* reprogram timer if needed */
-   if (shaper->packets) {
-       shaper->block_until = shaper->packets->expiration;
-       timer_mod( shaper->timer, shaper->block_until );
-   } else {
-       shaper->block_until = -1;
-   }
+    shaper->active = shaper->limited ||
+                     shaper->loss > 0. ||
+                     shaper->jitter_ns > 0 ||
+                     shaper->reorder > 0.;
 }
 
-
 NetShaper
 netshaper_create( int                do_copy,
                   NetShaperSendFunc  send_func )
 {
-    NetShaper  shaper = g_malloc(sizeof(*shaper));
+    NetShaper  shaper = g_malloc0(sizeof(*shaper));
 
-    shaper->active = 0;
-    shaper->packets = NULL;
-    shaper->num_packets = 0;
-    shaper->timer   = timer_new( SHAPER_CLOCK, SCALE_MS,
-                                 (QEMUTimerCB*) netshaper_expires,
-                                 shaper );
+    packet_wheel_init(&shaper->wheel, netshaper_send_packet, shaper);
+    shaper->do_copy   = do_copy;
     shaper->send_func = send_func;
     shaper->max_rate  = 1e6;
-    shaper->inv_rate  = 0.;
 
     shaper->block_until = -1; /* magic value, means to not block */
+    shaper->last_expiration = -1;
 
     return shaper;
 }
@@ -184,23 +477,36 @@ netshaper_set_rate( NetShaper  shaper,
                     double     rate )
 {
     /* send all current packets when changing the rate */
-    while (shaper->packets) {
-        QueuedPacket  packet = shaper->packets;
-        shaper->packets = packet->next;
-        shaper->send_func(packet->data, packet->size, packet->opaque);
-        g_free(packet);
-        shaper->num_packets = 0;
-    }
+    packet_wheel_flush(&shaper->wheel);
 
     shaper->max_rate = rate;
     if (rate > 1.) {
-        shaper->inv_rate = (8.*SHAPER_CLOCK_UNIT)/rate;  /* qemu_get_clock returns time in ms */
-        shaper->active   = 1;                            /* for the real-time clock           */
+        shaper->ns_per_byte = 8e9/rate;
+        shaper->bucket_ns   = (int64_t)(SHAPER_BUCKET_BYTES*shaper->ns_per_byte);
+        shaper->limited     = 1;
     } else {
-        shaper->active = 0;
+        shaper->limited = 0;
     }
+    netshaper_update_active(shaper);
 
     shaper->block_until = -1;
+    shaper->last_expiration = -1;
+}
+
+void
+netshaper_set_profile( NetShaper  shaper,
+                       double     loss_percent,
+                       int        jitter_ms,
+                       double     reorder_percent )
+{
+    packet_wheel_flush(&shaper->wheel);
+
+    shaper->loss      = (loss_percent > 0.) ? loss_percent/100. : 0.;
+    shaper->jitter_ns = (jitter_ms > 0) ? (int64_t)jitter_ms*1000000 : 0;
+    shaper->reorder   = (reorder_percent > 0.) ? reorder_percent/100. : 0.;
+    netshaper_update_active(shaper);
+
+    shaper->last_expiration = -1;
 }
 
 void
@@ -209,18 +515,56 @@ netshaper_send_aux( NetShaper  shaper,
                     size_t     size,
                     void*      opaque )
 {
-    int64_t   now;
+    int64_t   now, expiration;
 
     if (!shaper->active || _packet_is_internal(data, size)) {
         shaper->send_func( data, size, opaque );
         return;
     }
 
-    now = qemu_clock_get_ms( SHAPER_CLOCK );
-    if (now >= shaper->block_until) {
+    if (shaper->loss > 0. && _shaper_random() < shaper->loss)
+        return;
+
+    now        = qemu_clock_get_ns( SHAPER_CLOCK );
+    expiration = now;
+
+    if (shaper->limited) {
+        /* the packet can go as soon as the token bucket is not empty, then
+         * its size is taken out of the bucket. */
+        int64_t  start = shaper->block_until;
+
+        if (start < now - shaper->bucket_ns)
+            start = now - shaper->bucket_ns;
+        if (start > expiration)
+            expiration = start;
+        shaper->block_until = start + (int64_t)(size*shaper->ns_per_byte);
+    }
+
+    if (shaper->jitter_ns > 0 || shaper->reorder > 0.) {
+        int64_t  jitter = 0;
+
+        if (shaper->jitter_ns > 0)
+            jitter = (int64_t)(_shaper_random()*shaper->jitter_ns);
+
+        if (shaper->reorder > 0. && _shaper_random() < shaper->reorder) {
+            /* let following packets overtake this one, holding it back
+             * for at least SHAPER_REORDER_NS when there is no jitter */
+            int64_t  hold = shaper->jitter_ns;
+
+            if (hold < SHAPER_REORDER_NS)
+                hold = SHAPER_REORDER_NS;
+            expiration += hold + jitter;
+        } else {
+            expiration += jitter;
+            /* don't reorder packets */
+            if (expiration < shaper->last_expiration)
+                expiration = shaper->last_expiration;
+            shaper->last_expiration = expiration;
+        }
+    }
+
+    if (expiration <= now && shaper->wheel.count == 0) {
         shaper->send_func( data, size, opaque );
-        shaper->block_until = now + size*shaper->inv_rate;
-        //fprintf(stderr, "NETSHAPER: block for %.2fms\n", (shaper->block_until - now)*1.0 );
         return;
     }
 
@@ -229,29 +573,9 @@ netshaper_send_aux( NetShaper  shaper,
         QueuedPacket   packet;
 
         packet = queued_packet_create( data, size, opaque, shaper->do_copy );
-
-        packet->expiration = shaper->block_until;
-
-        {
-            QueuedPacket  *pnode, node;
-
-            pnode = &shaper->packets;
-            for (;;) {
-                node = *pnode;
-                if (node == NULL || node->expiration > packet->expiration )
-                    break;
-                pnode = &node->next;
-            }
-            packet->next = *pnode;
-            *pnode       = packet;
-
-            if (packet == shaper->packets)
-                timer_mod( shaper->timer, packet->expiration );
-        }
-        shaper->num_packets += 1;
+        packet->expiration = expiration;
+        packet_wheel_add(&shaper->wheel, packet);
     }
-    shaper->block_until += size*shaper->inv_rate;
-    //fprintf(stderr, "NETSHAPER: block2 for %.2fms\n", (shaper->block_until - now)*1.0 );
 }
 
 void
@@ -271,10 +595,10 @@ netshaper_can_send( NetShaper  shaper )
     if (!shaper->active || shaper->block_until < 0)
         return 1;
 
-    if (shaper->packets)
+    if (shaper->wheel.count > 0)
         return 0;
 
-    now = qemu_clock_get_ms( SHAPER_CLOCK );
+    now = qemu_clock_get_ns( SHAPER_CLOCK );
     return (now >= shaper->block_until);
 }
 
@@ -287,7 +611,6 @@ netshaper_can_send( NetShaper  shaper )
  * if session->packet is != NULL, then the connection is delayed
  */
 typedef struct SessionRec_ {
-    int64_t               expiration;
     struct SessionRec_*   next;
     unsigned              src_ip;
     unsigned              dst_ip;
@@ -308,7 +631,9 @@ session_free( Session  session )
 {
     if (session) {
         if (session->packet) {
-            queued_packet_free(session->packet);
+            /* the packet is still in the delay's wheel, it will be
+             * dropped when it expires */
+            session->packet->owner = NULL;
             session->packet = NULL;
         }
         g_free( session );
@@ -384,7 +709,7 @@ typedef struct NetDelayRec_
 {
     Session     sessions;
     int         num_sessions;
-    QEMUTimer*  timer;
+    PacketWheel wheel;       /* delayed SYN packets */
     int         active;
     int         min_ms;
     int         max_ms;
@@ -419,40 +744,19 @@ netdelay_lookup_session( NetDelay  delay, Session  info )
 
 
 
-/* called by the delay's timer on expiration */
+/* called by the delay's wheel when a delayed SYN packet expires */
 static void
-netdelay_expires( NetDelay  delay )
+netdelay_send_packet( void*  opaque, QueuedPacket  packet )
 {
-    Session  session;
-    int64_t  now = qemu_clock_get_ms(SHAPER_CLOCK);
-    int      rearm = 0;
-    int64_t  rearm_time = 0;
-
-    for (session = delay->sessions; session != NULL; session = session->next)
-    {
-        QueuedPacket  packet = session->packet;
-
-        if (packet == NULL)
-            continue;
+    NetDelay  delay   = opaque;
+    Session   session = packet->owner;
 
-        if (session->expiration <= now) {
-            /* send the SYN packet now */
-                    //fprintf(stderr, "NetDelay:RST: sending creation for %s\n", session_to_string(session) );
-            delay->send_func( packet->data, packet->size, packet->opaque );
-            session->packet = NULL;
-            queued_packet_free( packet );
-        } else {
-            if (!rearm) {
-                rearm      = 1;
-                rearm_time = session->expiration;
-            }
-            else if ( session->expiration < rearm_time )
-                rearm_time = session->expiration;
-        }
+    if (session != NULL) {
+        /* send the SYN packet now */
+        session->packet = NULL;
+        delay->send_func( packet->data, packet->size, packet->opaque );
     }
-
-    if (rearm)
-        timer_mod( delay->timer, rearm_time );
+    queued_packet_free( packet );
 }
 
 
@@ -463,9 +767,7 @@ netdelay_create( NetShaperSendFunc  send_func )
 
     delay->sessions     = NULL;
     delay->num_sessions = 0;
-    delay->timer        = timer_new( SHAPER_CLOCK, SCALE_MS,
-                                     (QEMUTimerCB*) netdelay_expires,
-                                     delay );
+    packet_wheel_init(&delay->wheel, netdelay_send_packet, delay);
     delay->active = 0;
     delay->min_ms = 0;
     delay->max_ms = 0;
@@ -480,14 +782,11 @@ void
 netdelay_set_latency( NetDelay  delay, int  min_ms, int  max_ms )
 {
     /* when changing the latency, accept all sessions */
+    packet_wheel_flush(&delay->wheel);
     while (delay->sessions) {
         Session  session = delay->sessions;
         delay->sessions = session->next;
         session->next = NULL;
-        if (session->packet) {
-            QueuedPacket  packet = session->packet;
-            delay->send_func( packet->data, packet->size, packet->opaque );
-        }
         session_free(session);
         delay->num_sessions--;
     }
@@ -553,8 +852,6 @@ netdelay_send_aux( NetDelay  delay, const void*  data, size_t  size, void* opaqu
                 delay->sessions      = session;
                 delay->num_sessions += 1;
 
-                session->expiration = qemu_clock_get_ms(SHAPER_CLOCK) + latency;
-
                 session->src_ip   = info->src_ip;
                 session->dst_ip   = info->dst_ip;
                 session->src_port = info->src_port;
@@ -562,8 +859,10 @@ netdelay_send_aux( NetDelay  delay, const void*  data, size_t  size, void* opaqu
                 session->protocol = info->protocol;
 
                 session->packet = queued_packet_create( data, size, opaque, 1 );
-
-                netdelay_expires(delay);
+                session->packet->owner = session;
+                session->packet->expiration =
+                        qemu_clock_get_ns(SHAPER_CLOCK) + latency*1000000LL;
+                packet_wheel_add(&delay->wheel, session->packet);
                 return;
             }
         }
@@ -583,6 +882,7 @@ netdelay_destroy( NetDelay  delay )
             session_free(session);
             delay->num_sessions -= 1;
         }
+        packet_wheel_done(&delay->wheel);
         delay->active = 0;
         g_free( delay );
     }
@@ -540,6 +540,105 @@ scale_up_bilinear( ScaleOp*  op )
 #endif
 #undef ARGB_SCALE_UP_BILINEAR
 
+#ifdef ARGB_SCALE_UP_BILINEAR_SSE2
+#include <emmintrin.h>
+
+/* same as scale_up_bilinear(), but interpolates all channels of the four
+ * neighbours at once with SSE2. The results are identical to the generic
+ * C version.
+ */
+static void
+ARGB_SCALE_UP_BILINEAR_SSE2( ScaleOp*  op )
+{
+    int        dst_pitch = op->dst_pitch;
+    int        src_pitch = op->src_pitch;
+    uint8_t*   dst_line  = op->dst_line;
+    uint8_t*   src_line  = op->src_line;
+    int        sx = op->sx;
+    int        sy = op->sy;
+    int        ix = op->ix;
+    int        iy = op->iy;
+    int        xlimit, ylimit;
+    int        h, sx0;
+    __m128i    zero = _mm_setzero_si128();
+
+    sx = sx + ix/2 - 32768;
+    sy = sy + iy/2 - 32768;
+
+    xlimit = (op->src_w-1);
+    ylimit = (op->src_h-1);
+
+    sx0 = sx;
+
+    for ( h = op->rd.size.h; h > 0; h-- ) {
+        uint32_t*  dst = (uint32_t*)dst_line;
+        uint32_t*  dst_end = dst + op->rd.size.w;
+        int        ey1, ey2;
+        uint8_t*   s1;
+        uint8_t*   s2;
+        __m128i    ywa, ywb;
+
+        /* the vertical neighbours and weights are the same for the
+         * whole line */
+        ey1 = (sy >> 16);
+        ey2 = (sy+65535) >> 16;
+        if (ey1 < 0) ey1 = 0; else if (ey1 > ylimit) ey1 = ylimit;
+        if (ey2 < 0) ey2 = 0; else if (ey2 > ylimit) ey2 = ylimit;
+
+        s1 = src_line + ey1*src_pitch;
+        s2 = src_line + ey2*src_pitch;
+
+        ywb = _mm_set1_epi16((short)((sy >> 8) & 0xff));
+        ywa = _mm_sub_epi16(_mm_set1_epi16(256), ywb);
+
+        sx = sx0;
+        for ( ; dst < dst_end; dst++ ) {
+            int      ex1, ex2, alpha;
+            __m128i  left, right, xwa, xwb, pix;
+
+            ex1 = (sx >> 16);
+            ex2 = (sx+65535) >> 16;
+            if (ex1 < 0) ex1 = 0; else if (ex1 > xlimit) ex1 = xlimit;
+            if (ex2 < 0) ex2 = 0; else if (ex2 > xlimit) ex2 = xlimit;
+
+            /* left = top-left | bottom-left, right = top-right | bottom-right,
+             * with 16 bits per channel */
+            left  = _mm_unpacklo_epi32(
+                        _mm_cvtsi32_si128(((uint32_t*)s1)[ex1]),
+                        _mm_cvtsi32_si128(((uint32_t*)s2)[ex1]));
+            right = _mm_unpacklo_epi32(
+                        _mm_cvtsi32_si128(((uint32_t*)s1)[ex2]),
+                        _mm_cvtsi32_si128(((uint32_t*)s2)[ex2]));
+            left  = _mm_unpacklo_epi8(left, zero);
+            right = _mm_unpacklo_epi8(right, zero);
+
+            /* horizontal interpolation of both lines. Each sum is at most
+             * 255*256, so 16-bit arithmetic can't overflow */
+            alpha = (sx >> 8) & 0xff;
+            xwb = _mm_set1_epi16((short)alpha);
+            xwa = _mm_set1_epi16((short)(256 - alpha));
+            pix = _mm_srli_epi16(
+                    _mm_add_epi16(_mm_mullo_epi16(left, xwa),
+                                  _mm_mullo_epi16(right, xwb)), 8);
+
+            /* vertical interpolation */
+            pix = _mm_srli_epi16(
+                    _mm_add_epi16(_mm_mullo_epi16(pix, ywa),
+                                  _mm_mullo_epi16(
+                                      _mm_unpackhi_epi64(pix, pix), ywb)), 8);
+
+            dst[0] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(pix, pix));
+
+            sx += ix;
+        }
+
+        sy       += iy;
+        dst_line += dst_pitch;
+    }
+}
+#endif
+#undef ARGB_SCALE_UP_BILINEAR_SSE2
+
 #ifdef ARGB_SCALE_UP_QUICK_4x4
 static void
 ARGB_SCALE_UP_QUICK_4x4( ScaleOp*  op )
@@ -11,6 +11,8 @@
 */
 #include "android/skin/scaler.h"
 
+#include "android/utils/parallel.h"
+
 #include <stdint.h>
 #include <math.h>
 
@@ -75,11 +77,51 @@ typedef struct {
 
 #define  ARGB_SCALE_GENERIC       scale_generic
 #define  ARGB_SCALE_05_TO_10      scale_05_to_10
+#if defined(__SSE2__) && !USE_MMX
+#define  ARGB_SCALE_UP_BILINEAR_SSE2  scale_up_bilinear
+#else
 #define  ARGB_SCALE_UP_BILINEAR   scale_up_bilinear
+#endif
 /* #define  ARGB_SCALE_UP_QUICK_4x4  scale_up_quick_4x4 UNUSED */
 
 #include "android/skin/argb.h"
 
+/* minimum number of destination pixels before a scale operation is split
+ * into horizontal bands that are processed in parallel */
+#define  SCALE_PARALLEL_MIN_PIXELS  (256 * 256)
+
+typedef struct {
+    const ScaleOp*  op;
+    int             bands;
+} ScaleJob;
+
+/* scale band |index| of the ScaleJob passed as |opaque|. Called from
+ * android_parallel_run() */
+static void
+scale_band( void*  opaque, int  index )
+{
+    const ScaleJob*  job = opaque;
+    ScaleOp          band = job->op[0];
+    int              y0 = band.rd.size.h * index / job->bands;
+    int              y1 = band.rd.size.h * (index + 1) / job->bands;
+
+    if (y1 <= y0)
+        return;
+
+    /* all scale functions advance by exactly |iy| per destination line */
+    band.rd.pos.y  += y0;
+    band.rd.size.h  = y1 - y0;
+    band.sy        += y0 * band.iy;
+    band.dst_line  += y0 * band.dst_pitch;
+
+    if (band.scale >= 0.5 && band.scale <= 1.0)
+        scale_05_to_10( &band );
+    else if (band.scale > 1.0)
+        scale_up_bilinear( &band );
+    else
+        scale_generic( &band );
+}
+
 
 void
 skin_scaler_reverse_map(SkinScaler* scaler,
@@ -147,12 +189,10 @@ skin_scaler_scale( SkinScaler*   scaler,
 
         op.dst_line += op.rd.pos.x * 4 + op.rd.pos.y * op.dst_pitch;
 
-        if (op.scale >= 0.5 && op.scale <= 1.0)
-            scale_05_to_10( &op );
-        else if (op.scale > 1.0)
-            scale_up_bilinear( &op );
-        else
-            scale_generic( &op );
+        ScaleJob  job = { &op, 1 };
+        if (op.rd.size.w * op.rd.size.h >= SCALE_PARALLEL_MIN_PIXELS)
+            job.bands = android_parallel_get_thread_count();
+        android_parallel_run( job.bands, scale_band, &job );
     }
 
     // The optimized scale functions in argb.h assume the destination is ARGB.
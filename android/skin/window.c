@@ -17,6 +17,7 @@
 #include "android/skin/scaler.h"
 #include "android/skin/winsys.h"
 #include "android/utils/debug.h"
+#include "android/utils/parallel.h"
 #include "android/utils/setenv.h"
 #include "android/utils/system.h"
 #include "android/utils/duff.h"
@@ -24,6 +25,14 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define  SKIN_USE_SSE2  1
+#else
+#define  SKIN_USE_SSE2  0
+#endif
 
 /* when shrinking, we reduce the pixel ratio by this fixed amount */
 #define  SHRINK_SCALE  0.6
@@ -95,6 +104,8 @@ typedef struct ADisplay {
     int            brightness;
     void*          gpu_frame;   /* GL_RGBA, datasize.w * datasize.h * 4 bytes */
     SkinSurface*   surface;     /* displayed surface after rotation + onion */
+    uint8_t*       update_pixels;       /* scratch buffer for updates */
+    size_t         update_pixels_size;  /* its size in bytes */
 } ADisplay;
 
 static void adisplay_done(ADisplay* disp) {
@@ -102,6 +113,9 @@ static void adisplay_done(ADisplay* disp) {
         free(disp->gpu_frame);
         disp->gpu_frame = NULL;
     }
+    free(disp->update_pixels);
+    disp->update_pixels = NULL;
+    disp->update_pixels_size = 0;
 
     skin_surface_unrefp(&disp->surface);
     disp->data = NULL;
@@ -158,6 +172,8 @@ static int adisplay_init(ADisplay* disp,
     disp->brightness = LCD_BRIGHTNESS_DEFAULT;
 
     disp->gpu_frame = NULL;
+    disp->update_pixels = NULL;
+    disp->update_pixels_size = 0;
 
     disp->surface = skin_surface_create_slow(disp->rect.size.w,
                                              disp->rect.size.h);
@@ -179,6 +195,39 @@ static __inline__ uint32_t rgb565_to_argb32(uint32_t pix) {
 #endif
 }
 
+// Convert |count| RGB565 pixels from |src| into ARGB32 ones into |dst|.
+static void rgb565_to_argb32_line(uint32_t* dst,
+                                  const uint16_t* src,
+                                  int count) {
+    int nn = 0;
+#if SKIN_USE_SSE2
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i alpha = _mm_set1_epi16((short)0xff00);
+
+    for (; nn + 8 <= count; nn += 8) {
+        __m128i pix = _mm_loadu_si128((const __m128i*)(src + nn));
+        __m128i r = _mm_srli_epi16(pix, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(pix, 5), mask6);
+        __m128i b = _mm_and_si128(pix, mask5);
+
+        // Replicate the high bits into the low ones, as rgb565_to_argb32().
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        __m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+        __m128i ar = _mm_or_si128(alpha, r);
+        _mm_storeu_si128((__m128i*)(dst + nn), _mm_unpacklo_epi16(gb, ar));
+        _mm_storeu_si128((__m128i*)(dst + nn + 4),
+                         _mm_unpackhi_epi16(gb, ar));
+    }
+#endif
+    for (; nn < count; nn++) {
+        dst[nn] = rgb565_to_argb32(src[nn]);
+    }
+}
+
 static void adisplay_set_onion(ADisplay* disp,
                                SkinImage* onion,
                                SkinRotation rotation,
@@ -304,6 +353,71 @@ static void dotmatrix_dither_argb32(unsigned char* pixels,
 /* treat as special value to turn screen off */
 #define  LCD_BRIGHTNESS_OFF   LCD_BRIGHTNESS_MIN
 
+// Multiply all channels of |count| ARGB32 pixels at |line| by |alpha|/256.
+static void lcd_darken_argb32_line(uint32_t* line,
+                                   int count,
+                                   unsigned alpha) {
+    int nn = 0;
+#if SKIN_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mult = _mm_set1_epi16((short)alpha);
+
+    for (; nn + 4 <= count; nn += 4) {
+        __m128i pix = _mm_loadu_si128((const __m128i*)(line + nn));
+        __m128i lo = _mm_unpacklo_epi8(pix, zero);
+        __m128i hi = _mm_unpackhi_epi8(pix, zero);
+        lo = _mm_srli_epi16(_mm_mullo_epi16(lo, mult), 8);
+        hi = _mm_srli_epi16(_mm_mullo_epi16(hi, mult), 8);
+        _mm_storeu_si128((__m128i*)(line + nn), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; nn < count; nn++) {
+        unsigned c = line[nn];
+        unsigned ag = (c >> 8) & 0x00ff00ff;
+        unsigned rb = (c)      & 0x00ff00ff;
+
+        ag = (ag * alpha)        & 0xff00ff00;
+        rb = ((rb * alpha) >> 8) & 0x00ff00ff;
+
+        line[nn] = (unsigned)(ag | rb);
+    }
+}
+
+// Interpolate |count| ARGB32 pixels at |line| towards bright white, i.e.
+// compute (c * ialpha + 255 * alpha) / 256 for each channel |c|.
+static void lcd_lighten_argb32_line(uint32_t* line,
+                                    int count,
+                                    unsigned alpha,
+                                    unsigned ialpha) {
+    int nn = 0;
+#if SKIN_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mult = _mm_set1_epi16((short)ialpha);
+    const __m128i white = _mm_set1_epi16((short)(255 * alpha));
+
+    for (; nn + 4 <= count; nn += 4) {
+        __m128i pix = _mm_loadu_si128((const __m128i*)(line + nn));
+        __m128i lo = _mm_unpacklo_epi8(pix, zero);
+        __m128i hi = _mm_unpackhi_epi8(pix, zero);
+        lo = _mm_add_epi16(_mm_mullo_epi16(lo, mult), white);
+        hi = _mm_add_epi16(_mm_mullo_epi16(hi, mult), white);
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128((__m128i*)(line + nn), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; nn < count; nn++) {
+        unsigned c = line[nn];
+        unsigned ag = (c >> 8) & 0x00ff00ff;
+        unsigned rb = (c)      & 0x00ff00ff;
+
+        ag = ((ag*ialpha + 0x00ff00ff*alpha)) & 0xff00ff00;
+        rb = ((rb*ialpha + 0x00ff00ff*alpha) >> 8) & 0x00ff00ff;
+
+        line[nn] = (unsigned)(ag | rb);
+    }
+}
+
 static void lcd_brightness_argb32(uint32_t* pixels,
                                   int w,
                                   int h,
@@ -330,20 +444,7 @@ static void lcd_brightness_argb32(uint32_t* pixels,
         alpha = alpha_min + ((alpha - b_min) * alpha_range) / (b_low - b_min);
 
         for (; h > 0; h--) {
-            unsigned* line = (unsigned*) pixels;
-            int nn = 0;
-
-            DUFF4(w, {
-                unsigned c = line[nn];
-                unsigned ag = (c >> 8) & 0x00ff00ff;
-                unsigned rb = (c)      & 0x00ff00ff;
-
-                ag = (ag * alpha)        & 0xff00ff00;
-                rb = ((rb * alpha) >> 8) & 0x00ff00ff;
-
-                line[nn] = (unsigned)(ag | rb);
-                nn++;
-            });
+            lcd_darken_argb32_line(pixels, w, alpha);
             pixels += (pitch / sizeof(uint32_t));
         }
     }
@@ -357,21 +458,7 @@ static void lcd_brightness_argb32(uint32_t* pixels,
         ialpha = 255 - alpha;
 
         for ( ; h > 0; h-- ) {
-            unsigned* line = (unsigned*) pixels;
-            int nn = 0;
-
-            DUFF4(w, {
-                unsigned c = line[nn];
-                unsigned ag = (c >> 8) & 0x00ff00ff;
-                unsigned rb = (c)      & 0x00ff00ff;
-
-                /* interpolate towards bright white, i.e. 0x00ffffff */
-                ag = ((ag*ialpha + 0x00ff00ff*alpha)) & 0xff00ff00;
-                rb = ((rb*ialpha + 0x00ff00ff*alpha) >> 8) & 0x00ff00ff;
-
-                line[nn] = (unsigned)(ag | rb);
-                nn++;
-            });
+            lcd_lighten_argb32_line(pixels, w, alpha, ialpha);
             pixels += (pitch / sizeof(uint32_t));
         }
     }
@@ -390,7 +477,7 @@ static void adisplay_update_surface_pixels_16(ADisplay* disp,
     int           src_pitch = src_w * 2;
     uint8_t*      src_line  = (uint8_t*)disp->data;
     uint8_t*      dst_line  = dst_pixels;
-    int           yy, xx;
+    int           yy;
 
     switch ( disp->rotation & 3 )
     {
@@ -398,14 +485,9 @@ static void adisplay_update_surface_pixels_16(ADisplay* disp,
         src_line += (x * 2) + (y * src_pitch);
 
         for (yy = h; yy > 0; yy--) {
-            uint32_t* dst = (uint32_t*)dst_line;
-            uint16_t* src = (uint16_t*)src_line;
-
-            xx = 0;
-            DUFF4(w, {
-                dst[xx] = rgb565_to_argb32(src[xx]);
-                xx++;
-            });
+            rgb565_to_argb32_line((uint32_t*)dst_line,
+                                  (const uint16_t*)src_line,
+                                  w);
             src_line += src_pitch;
             dst_line += dst_pitch;
         }
@@ -485,14 +567,7 @@ static void adisplay_update_surface_pixels_32(ADisplay* disp,
         src_line += (x * 4) + (y * src_pitch);
 
         for (yy = h; yy > 0; yy--) {
-            uint32_t*  src = (uint32_t*)src_line;
-            uint32_t*  dst = (uint32_t*)dst_line;
-
-            DUFF4(w, {
-                dst[0] = src[0];
-                dst++;
-                src++;
-            });
+            memcpy(dst_line, src_line, 4 * w);
             src_line += src_pitch;
             dst_line += dst_pitch;
         }
@@ -551,6 +626,58 @@ static void adisplay_update_surface_pixels_32(ADisplay* disp,
     }
 }
 
+// Minimum number of pixels in an update rectangle before it is split into
+// horizontal bands that are converted in parallel.
+#define  ADISPLAY_PARALLEL_MIN_PIXELS  (256 * 256)
+
+// State of an update of the display surface, shared by all bands.
+typedef struct {
+    ADisplay*   disp;
+    SkinRect    rect;     /* update rectangle */
+    uint8_t*    pixels;   /* converted pixels for |rect| */
+    int         pitch;    /* pitch of |pixels| in bytes */
+    int         bands;    /* number of bands |rect| is split into */
+} ADisplayUpdate;
+
+// Convert and apply brightness to band |index| of an ADisplayUpdate
+// passed as |opaque|. Called from android_parallel_run().
+static void adisplay_update_band(void* opaque, int index) {
+    ADisplayUpdate* update = opaque;
+    ADisplay* disp = update->disp;
+    int y0 = update->rect.size.h * index / update->bands;
+    int y1 = update->rect.size.h * (index + 1) / update->bands;
+    if (y1 <= y0) {
+        return;
+    }
+
+    SkinRect band = update->rect;
+    band.pos.y += y0;
+    band.size.h = y1 - y0;
+    uint8_t* pixels = update->pixels + y0 * update->pitch;
+
+    if (disp->gpu_frame) {
+        // Content comes from the emulated GPU.
+        adisplay_update_surface_pixels_32(
+                disp, &band, pixels, update->pitch, disp->gpu_frame);
+    } else {
+        // Content comes from the emulated framebuffer.
+        if (disp->bits_per_pixel == 32) {
+            adisplay_update_surface_pixels_32(
+                    disp, &band, pixels, update->pitch, disp->data);
+        } else {
+            adisplay_update_surface_pixels_16(
+                    disp, &band, pixels, update->pitch);
+        }
+    }
+
+    // Apply brightness modulation.
+    lcd_brightness_argb32((uint32_t*)pixels,
+                          band.size.w,
+                          band.size.h,
+                          update->pitch,
+                          disp->brightness);
+}
+
 // Update the content of the display surface from the framebuffer content.
 // |disp| is the target ADisplay instance.
 // |rect| is the rectangle to update, in coordinates relative to the
@@ -576,52 +703,47 @@ static void adisplay_update_surface(ADisplay* disp,
         h -= delta;
     }
     if (y < 0) {
-        h += delta;
+        h += y;
         y = 0;
     }
     if (w <= 0 || h <= 0) {
         return;  // nothing to do.
     }
 
-    // Allocate a temporary buffer to get the potentially rotated / converted
-    // content.
-    int sz = disp->datasize.h > disp->datasize.w ? disp->datasize.h : disp->datasize.w;
-    int dst_pitch = 4 * sz;
-    uint8_t* dst_pixels = calloc(sz, dst_pitch);
-
-    SkinRect dst_r = {
-        .pos.x = x,
-        .pos.y = y,
-        .size.w = w,
-        .size.h = h };
-
-    if (disp->gpu_frame) {
-        // Content comes from the emulated GPU.
-        adisplay_update_surface_pixels_32(
-                disp, &dst_r, dst_pixels, dst_pitch, disp->gpu_frame);
-    } else {
-        // Content comes from the emulated framebuffer.
-        if (disp->bits_per_pixel == 32) {
-            adisplay_update_surface_pixels_32(
-                    disp, &dst_r, dst_pixels, dst_pitch, disp->data);
-        } else {
-            adisplay_update_surface_pixels_16(
-                    disp, &dst_r, dst_pixels, dst_pitch);
+    // Get a scratch buffer for the potentially rotated / converted content
+    // of the update rectangle. It is kept between updates.
+    int dst_pitch = 4 * w;
+    size_t dst_size = (size_t)dst_pitch * h;
+    if (dst_size > disp->update_pixels_size) {
+        free(disp->update_pixels);
+        disp->update_pixels = malloc(dst_size);
+        if (!disp->update_pixels) {
+            disp->update_pixels_size = 0;
+            return;
         }
+        disp->update_pixels_size = dst_size;
     }
 
-    // Apply brightness modulation.
-    lcd_brightness_argb32((uint32_t*)dst_pixels,
-                          disp->datasize.w,
-                          disp->datasize.h,
-                          dst_pitch,
-                          disp->brightness);
+    ADisplayUpdate update = {
+        .disp = disp,
+        .rect = {
+            .pos.x = x,
+            .pos.y = y,
+            .size.w = w,
+            .size.h = h },
+        .pixels = disp->update_pixels,
+        .pitch = dst_pitch,
+        .bands = 1,
+    };
 
-    // Update the display surface content
-    skin_surface_upload(disp->surface, &dst_r, dst_pixels, dst_pitch);
-    free(dst_pixels);
+    // Split large updates between several threads.
+    if (w * h >= ADISPLAY_PARALLEL_MIN_PIXELS) {
+        update.bands = android_parallel_get_thread_count();
+    }
+    android_parallel_run(update.bands, adisplay_update_band, &update);
 
-    // Done
+    // Update the display surface content
+    skin_surface_upload(disp->surface, &update.rect, update.pixels, dst_pitch);
 }
 
 static void adisplay_redraw(ADisplay* disp,
@@ -0,0 +1,170 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/utils/parallel.h"
+
+#include "android/base/memory/LazyInstance.h"
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
+#include "android/base/threads/Thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using android::base::AutoLock;
+using android::base::ConditionVariable;
+using android::base::LazyInstance;
+using android::base::Lock;
+using android::base::Thread;
+
+namespace {
+
+// Maximum number of threads used by android_parallel_run(), including
+// the caller's. There is little point in going higher for the memory-bound
+// pixel operations this is used for.
+const int kMaxThreads = 4;
+
+int getHostCpuCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return static_cast<int>(info.dwNumberOfProcessors);
+#else
+    long count = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? static_cast<int>(count) : 1;
+#endif
+}
+
+class WorkerPool {
+public:
+    WorkerPool() :
+            mRunLock(),
+            mLock(),
+            mWorkCv(),
+            mDoneCv(),
+            mFunc(NULL),
+            mOpaque(NULL),
+            mCount(0),
+            mNext(0),
+            mPending(0),
+            mNumWorkers(0) {
+        int numThreads = getHostCpuCount();
+        if (numThreads > kMaxThreads) {
+            numThreads = kMaxThreads;
+        }
+        for (int n = 0; n < numThreads - 1; ++n) {
+            Worker* worker = new Worker(this);
+            if (!worker->start()) {
+                delete worker;
+                break;
+            }
+            // NOTE: Workers are never stopped, the pool lives until the
+            // end of the process.
+            mNumWorkers++;
+        }
+    }
+
+    int threadCount() const { return mNumWorkers + 1; }
+
+    void run(int count, AParallelTaskFunc func, void* opaque) {
+        if (count <= 0) {
+            return;
+        }
+        if (count == 1 || mNumWorkers == 0) {
+            for (int n = 0; n < count; ++n) {
+                func(opaque, n);
+            }
+            return;
+        }
+        AutoLock runLock(mRunLock);
+        mLock.lock();
+        mFunc = func;
+        mOpaque = opaque;
+        mCount = count;
+        mNext = 0;
+        mPending = count;
+        for (int n = 0; n < mNumWorkers; ++n) {
+            mWorkCv.signal();
+        }
+        // The current thread processes tasks too.
+        while (mNext < mCount) {
+            int index = mNext++;
+            mLock.unlock();
+            func(opaque, index);
+            mLock.lock();
+            mPending--;
+        }
+        while (mPending > 0) {
+            mDoneCv.wait(&mLock);
+        }
+        mCount = 0;
+        mNext = 0;
+        mLock.unlock();
+    }
+
+private:
+    class Worker : public Thread {
+    public:
+        explicit Worker(WorkerPool* pool) : Thread(), mPool(pool) {}
+
+        virtual intptr_t main() {
+            mPool->workerLoop();
+            return 0;
+        }
+
+    private:
+        WorkerPool* mPool;
+    };
+
+    void workerLoop() {
+        mLock.lock();
+        for (;;) {
+            while (mNext >= mCount) {
+                mWorkCv.wait(&mLock);
+            }
+            int index = mNext++;
+            AParallelTaskFunc func = mFunc;
+            void* opaque = mOpaque;
+            mLock.unlock();
+            func(opaque, index);
+            mLock.lock();
+            if (--mPending == 0) {
+                mDoneCv.signal();
+            }
+        }
+    }
+
+    Lock mRunLock;  // serializes run() calls.
+    Lock mLock;     // protects all fields below.
+    ConditionVariable mWorkCv;
+    ConditionVariable mDoneCv;
+    AParallelTaskFunc mFunc;
+    void* mOpaque;
+    int mCount;
+    int mNext;
+    int mPending;
+    int mNumWorkers;
+};
+
+LazyInstance<WorkerPool> sWorkerPool = LAZY_INSTANCE_INIT;
+
+}  // namespace
+
+void android_parallel_run(int count, AParallelTaskFunc func, void* opaque) {
+    sWorkerPool->run(count, func, opaque);
+}
+
+int android_parallel_get_thread_count(void) {
+    return sWorkerPool->threadCount();
+}
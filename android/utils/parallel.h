@@ -0,0 +1,37 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef ANDROID_UTILS_PARALLEL_H
+#define ANDROID_UTILS_PARALLEL_H
+
+#include "android/utils/compiler.h"
+
+ANDROID_BEGIN_HEADER
+
+// Type of a function called by android_parallel_run(). |opaque| is the
+// user-provided value, and |index| is the index of the current task.
+typedef void (*AParallelTaskFunc)(void* opaque, int index);
+
+// Call |func(opaque, n)| for each |n| in [0..|count|), distributing the
+// calls between the current thread and a small pool of worker threads
+// that is created on first use, then return once all calls are done.
+// Calls can happen in any order. Concurrent calls to this function are
+// serialized.
+void android_parallel_run(int count, AParallelTaskFunc func, void* opaque);
+
+// Return the maximum number of threads that android_parallel_run() will
+// use concurrently, including the calling thread. This is always >= 1,
+// and is a good default for the number of tasks to split a job into.
+int android_parallel_get_thread_count(void);
+
+ANDROID_END_HEADER
+
+#endif  // ANDROID_UTILS_PARALLEL_H
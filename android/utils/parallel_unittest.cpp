@@ -0,0 +1,68 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/utils/parallel.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+namespace {
+
+const int kMaxTasks = 64;
+
+struct TaskState {
+    int calls[kMaxTasks];
+};
+
+void recordTask(void* opaque, int index) {
+    TaskState* state = static_cast<TaskState*>(opaque);
+    state->calls[index]++;
+}
+
+}  // namespace
+
+TEST(Parallel, ThreadCount) {
+    EXPECT_GE(android_parallel_get_thread_count(), 1);
+}
+
+TEST(Parallel, ZeroTasks) {
+    TaskState state;
+    memset(&state, 0, sizeof(state));
+    android_parallel_run(0, recordTask, &state);
+    for (int n = 0; n < kMaxTasks; ++n) {
+        EXPECT_EQ(0, state.calls[n]);
+    }
+}
+
+TEST(Parallel, EachTaskRunsOnce) {
+    for (int count = 1; count <= kMaxTasks; ++count) {
+        TaskState state;
+        memset(&state, 0, sizeof(state));
+        android_parallel_run(count, recordTask, &state);
+        for (int n = 0; n < kMaxTasks; ++n) {
+            EXPECT_EQ(n < count ? 1 : 0, state.calls[n])
+                    << "count=" << count << " n=" << n;
+        }
+    }
+}
+
+TEST(Parallel, ManyRuns) {
+    TaskState state;
+    memset(&state, 0, sizeof(state));
+    const int kRuns = 1000;
+    for (int n = 0; n < kRuns; ++n) {
+        android_parallel_run(kMaxTasks, recordTask, &state);
+    }
+    for (int n = 0; n < kMaxTasks; ++n) {
+        EXPECT_EQ(kRuns, state.calls[n]);
+    }
+}
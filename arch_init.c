@@ -94,50 +94,55 @@ const uint32_t arch_type = QEMU_ARCH;
 #define RAM_SAVE_FLAG_PAGE     0x08
 #define RAM_SAVE_FLAG_EOS      0x10
 #define RAM_SAVE_FLAG_CONTINUE 0x20
+#define RAM_SAVE_FLAG_FILE     0x40
 
-static int is_dup_page(uint8_t *page, uint8_t ch)
-{
-    uint32_t val = ch << 24 | ch << 16 | ch << 8 | ch;
-    uint32_t *array = (uint32_t *)page;
-    int i;
+static RAMBlock *last_block;
+static ram_addr_t last_offset;
 
-    for (i = 0; i < (TARGET_PAGE_SIZE / 4); i++) {
-        if (array[i] != val) {
-            return 0;
-        }
+/* Return the offset of the first page of |block| at or after |offset|
+ * that is dirty for migration, or block->length if there is none. The
+ * dirty bitmap is scanned a word at a time. */
+static ram_addr_t ram_find_dirty(RAMBlock *block, ram_addr_t offset)
+{
+    unsigned long first = block->offset >> TARGET_PAGE_BITS;
+    unsigned long end = (block->offset + block->length) >> TARGET_PAGE_BITS;
+    unsigned long page;
+
+    page = find_next_bit(ram_list.dirty_memory[DIRTY_MEMORY_MIGRATION],
+                         end, first + (offset >> TARGET_PAGE_BITS));
+    if (page >= end) {
+        return block->length;
     }
-
-    return 1;
+    return (ram_addr_t)(page - first) << TARGET_PAGE_BITS;
 }
 
-static RAMBlock *last_block;
-static ram_addr_t last_offset;
-
 static int ram_save_block(QEMUFile *f)
 {
     RAMBlock *block = last_block;
+    RAMBlock *start;
     ram_addr_t offset = last_offset;
     ram_addr_t current_addr;
     int bytes_sent = 0;
+    int wrapped = 0;
 
     if (!block)
         block = QTAILQ_FIRST(&ram_list.blocks);
+    start = block;
 
-    current_addr = block->offset + offset;
-
-    do {
-        if (cpu_physical_memory_get_dirty(current_addr, TARGET_PAGE_SIZE,
-                                          DIRTY_MEMORY_MIGRATION)) {
+    for (;;) {
+        offset = ram_find_dirty(block, offset);
+        if (offset < block->length) {
             uint8_t *p;
             int cont = (block == last_block) ? RAM_SAVE_FLAG_CONTINUE : 0;
 
+            current_addr = block->offset + offset;
             cpu_physical_memory_reset_dirty(current_addr,
                                             TARGET_PAGE_SIZE,
                                             DIRTY_MEMORY_MIGRATION);
 
             p = block->host + offset;
 
-            if (is_dup_page(p, *p)) {
+            if (buffer_is_uniform(p, TARGET_PAGE_SIZE)) {
                 qemu_put_be64(f, offset | cont | RAM_SAVE_FLAG_COMPRESS);
                 if (!cont) {
                     qemu_put_byte(f, strlen(block->idstr));
@@ -160,17 +165,19 @@ static int ram_save_block(QEMUFile *f)
             break;
         }
 
-        offset += TARGET_PAGE_SIZE;
-        if (offset >= block->length) {
-            offset = 0;
-            block = QTAILQ_NEXT(block, next);
-            if (!block)
-                block = QTAILQ_FIRST(&ram_list.blocks);
+        /* Stop once all blocks were scanned, the part of the first one
+         * before last_offset included. */
+        if (wrapped) {
+            offset = last_offset;
+            break;
         }
-
-        current_addr = block->offset + offset;
-
-    } while (current_addr != last_block->offset + last_offset);
+        offset = 0;
+        block = QTAILQ_NEXT(block, next);
+        if (!block)
+            block = QTAILQ_FIRST(&ram_list.blocks);
+        if (block == start)
+            wrapped = 1;
+    }
 
     last_block = block;
     last_offset = offset;
@@ -178,6 +185,224 @@ static int ram_save_block(QEMUFile *f)
     return bytes_sent;
 }
 
+/* Snapshot RAM files.
+ *
+ * When snapshot_ram_dir is set, 'savevm' writes guest RAM to a raw file
+ * in this directory, and the VM state only records its path and a random
+ * cookie. 'loadvm' then maps the file privately over guest RAM, so pages
+ * are only read when the guest touches them, and pages the guest doesn't
+ * modify stay shared with the page cache, e.g. between emulators loading
+ * the same snapshot. Zero pages are not written, they are read back from
+ * the file's holes.
+ *
+ * The file starts with a RamFileHeader, padded to RAM_FILE_HEADER_SIZE,
+ * followed by the content of each RAM block at its ram_addr_t offset.
+ */
+#define RAM_FILE_MAGIC        "QEMURAM1"
+#define RAM_FILE_HEADER_SIZE  65536  /* must be a multiple of host pages */
+
+typedef struct {
+    char magic[8];
+    uint64_t cookie;
+    uint64_t ram_size;
+} RamFileHeader;
+
+static char *ram_file_snapshot_name;
+
+void ram_set_snapshot_name(const char *name)
+{
+    g_free(ram_file_snapshot_name);
+    ram_file_snapshot_name = name ? g_strdup(name) : NULL;
+}
+
+#ifndef _WIN32
+static int ram_file_pwrite(int fd, const uint8_t *buf, size_t len, off_t pos)
+{
+    while (len > 0) {
+        ssize_t ret = pwrite(fd, buf, len, pos);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += ret;
+        len -= ret;
+        pos += ret;
+    }
+    return 0;
+}
+
+static int ram_file_pread(int fd, uint8_t *buf, size_t len, off_t pos)
+{
+    while (len > 0) {
+        ssize_t ret = pread(fd, buf, len, pos);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (ret == 0) {
+            return -EINVAL;
+        }
+        buf += ret;
+        len -= ret;
+        pos += ret;
+    }
+    return 0;
+}
+
+/* Write all RAM blocks to the RAM file of the current snapshot, then
+ * record it in |f|. Return 0 on success, or a negative errno value, in
+ * which case nothing is written to |f|. */
+static int ram_file_save(QEMUFile *f)
+{
+    RamFileHeader header;
+    RAMBlock *block;
+    char *name, *path, *tmp_path, *c;
+    uint64_t ram_size = 0;
+    int fd, ret = 0;
+
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        ram_size = MAX(ram_size, block->offset + block->length);
+    }
+
+    /* Make the snapshot name safe to use as a file name. */
+    name = g_strdup(ram_file_snapshot_name);
+    for (c = name; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            *c = '_';
+        }
+    }
+    path = g_strdup_printf("%s/%s.ram", snapshot_ram_dir, name);
+    tmp_path = g_strdup_printf("%s.tmp", path);
+    g_free(name);
+
+    /* Write to a temporary file first, other emulators may still be
+     * using a mapping of the previous one. */
+    fd = qemu_open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAM_FILE_MAGIC, sizeof(header.magic));
+    header.cookie = (uint64_t)qemu_clock_get_ns(QEMU_CLOCK_HOST) ^
+                    ((uint64_t)getpid() << 32);
+    header.ram_size = ram_size;
+
+    if (ftruncate(fd, RAM_FILE_HEADER_SIZE + ram_size) < 0) {
+        ret = -errno;
+    } else {
+        ret = ram_file_pwrite(fd, (uint8_t *)&header, sizeof(header), 0);
+    }
+
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        ram_addr_t offset = 0, end;
+
+        while (ret == 0 && offset < block->length) {
+            if (buffer_is_zero(block->host + offset, TARGET_PAGE_SIZE)) {
+                offset += TARGET_PAGE_SIZE;
+                continue;
+            }
+            end = offset + TARGET_PAGE_SIZE;
+            while (end < block->length &&
+                   !buffer_is_zero(block->host + end, TARGET_PAGE_SIZE)) {
+                end += TARGET_PAGE_SIZE;
+            }
+            ret = ram_file_pwrite(fd, block->host + offset, end - offset,
+                                  RAM_FILE_HEADER_SIZE + block->offset + offset);
+            offset = end;
+        }
+    }
+    close(fd);
+
+    if (ret == 0 && rename(tmp_path, path) < 0) {
+        ret = -errno;
+    }
+    if (ret < 0) {
+        unlink(tmp_path);
+        goto out;
+    }
+
+    qemu_put_be64(f, RAM_SAVE_FLAG_FILE);
+    qemu_put_be32(f, strlen(path));
+    qemu_put_buffer(f, (uint8_t *)path, strlen(path));
+    qemu_put_be64(f, header.cookie);
+
+out:
+    if (ret < 0) {
+        fprintf(stderr, "Could not write snapshot RAM file %s: %s\n",
+                path, strerror(-ret));
+    }
+    g_free(tmp_path);
+    g_free(path);
+    return ret;
+}
+
+/* Load all RAM blocks from the RAM file recorded in |f|. */
+static int ram_file_load(QEMUFile *f)
+{
+    RamFileHeader header;
+    RAMBlock *block;
+    uint32_t len;
+    uint64_t cookie;
+    char *path;
+    int fd, ret;
+
+    len = qemu_get_be32(f);
+    if (len >= PATH_MAX) {
+        fprintf(stderr, "Invalid snapshot RAM file path length %u\n", len);
+        return -EINVAL;
+    }
+    path = g_malloc(len + 1);
+    qemu_get_buffer(f, (uint8_t *)path, len);
+    path[len] = 0;
+    cookie = qemu_get_be64(f);
+
+    fd = qemu_open(path, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    ret = ram_file_pread(fd, (uint8_t *)&header, sizeof(header), 0);
+    if (ret == 0 &&
+        (memcmp(header.magic, RAM_FILE_MAGIC, sizeof(header.magic)) ||
+         header.cookie != cookie)) {
+        /* The file was overwritten by another snapshot. */
+        ret = -ESTALE;
+    }
+
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        off_t pos = RAM_FILE_HEADER_SIZE + block->offset;
+
+        if (ret < 0) {
+            break;
+        }
+        if (block->offset + block->length > header.ram_size) {
+            ret = -EINVAL;
+            break;
+        }
+        if (qemu_ram_map_file(block->offset, fd, pos) < 0) {
+            ret = ram_file_pread(fd, block->host, block->length, pos);
+        }
+    }
+    /* Mappings stay valid after the file is closed. */
+    close(fd);
+
+out:
+    if (ret < 0) {
+        fprintf(stderr, "Could not load snapshot RAM file %s: %s\n",
+                path, strerror(-ret));
+    }
+    g_free(path);
+    return ret;
+}
+#endif  // !_WIN32
+
 static uint64_t bytes_transferred;
 
 static ram_addr_t ram_save_remaining(void)
@@ -186,14 +411,10 @@ static ram_addr_t ram_save_remaining(void)
     ram_addr_t count = 0;
 
     QTAILQ_FOREACH(block, &ram_list.blocks, next) {
-        ram_addr_t addr;
-        for (addr = block->offset; addr < block->offset + block->length;
-             addr += TARGET_PAGE_SIZE) {
-            if (cpu_physical_memory_get_dirty(addr, TARGET_PAGE_SIZE,
-                                              DIRTY_MEMORY_MIGRATION)) {
-                count++;
-            }
-        }
+        count += bitmap_count_one_range(
+                ram_list.dirty_memory[DIRTY_MEMORY_MIGRATION],
+                block->offset >> TARGET_PAGE_BITS,
+                block->length >> TARGET_PAGE_BITS);
     }
 
     return count;
@@ -255,7 +476,6 @@ static void sort_ram_list(void)
 
 int ram_save_live(QEMUFile *f, int stage, void *opaque)
 {
-    ram_addr_t addr;
     uint64_t bytes_transferred_last;
     double bwidth = 0;
     uint64_t expected_time = 0;
@@ -279,14 +499,9 @@ int ram_save_live(QEMUFile *f, int stage, void *opaque)
 
         /* Make sure all dirty bits are set */
         QTAILQ_FOREACH(block, &ram_list.blocks, next) {
-            for (addr = block->offset; addr < block->offset + block->length;
-                 addr += TARGET_PAGE_SIZE) {
-                if (!cpu_physical_memory_get_dirty(addr, TARGET_PAGE_SIZE,
-                                                   DIRTY_MEMORY_MIGRATION)) {
-                    cpu_physical_memory_set_dirty_flag(
-                            addr, DIRTY_MEMORY_MIGRATION);
-                }
-            }
+            bitmap_set(ram_list.dirty_memory[DIRTY_MEMORY_MIGRATION],
+                       block->offset >> TARGET_PAGE_BITS,
+                       block->length >> TARGET_PAGE_BITS);
         }
 
         /* Enable dirty memory tracking */
@@ -299,6 +514,18 @@ int ram_save_live(QEMUFile *f, int stage, void *opaque)
             qemu_put_buffer(f, (uint8_t *)block->idstr, strlen(block->idstr));
             qemu_put_be64(f, block->length);
         }
+
+#ifndef _WIN32
+        /* 'savevm' stops the VM, so the RAM file content can't change
+         * before the end of the save, and no page needs to be sent. */
+        if (snapshot_ram_dir && ram_file_snapshot_name &&
+            ram_file_save(f) == 0) {
+            QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+                cpu_physical_memory_reset_dirty(block->offset, block->length,
+                                                DIRTY_MEMORY_MIGRATION);
+            }
+        }
+#endif
     }
 
     bytes_transferred_last = bytes_transferred;
@@ -387,6 +614,17 @@ int ram_load(QEMUFile *f, void *opaque, int version_id)
         addr &= TARGET_PAGE_MASK;
 
         if (flags & RAM_SAVE_FLAG_MEM_SIZE) {
+#ifndef _WIN32
+            RAMBlock *block;
+
+            /* Pages of a RAM file mapping that are not sent would keep
+             * the RAM file content, go back to anonymous memory. */
+            QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+                if (block->flags & RAM_FILE_MAPPED_MASK) {
+                    qemu_ram_remap(block->offset, block->length);
+                }
+            }
+#endif
             if (version_id != 3) {
                 if (addr != ram_bytes_total()) {
                     return -EINVAL;
@@ -452,6 +690,13 @@ int ram_load(QEMUFile *f, void *opaque, int version_id)
                 host = host_from_stream_offset(f, addr, flags);
 
             qemu_get_buffer(f, host, TARGET_PAGE_SIZE);
+#ifndef _WIN32
+        } else if (flags & RAM_SAVE_FLAG_FILE) {
+            int ret = ram_file_load(f);
+            if (ret < 0) {
+                return ret;
+            }
+#endif
         }
         if (qemu_file_get_error(f)) {
             return -EIO;
@@ -27,6 +27,7 @@
 #include "block/block_int.h"
 #include "qemu/iov.h"
 #include "qemu/module.h"
+#include "qemu/timer.h"
 //#include "qapi/qmp/types.h"
 #include "qapi/qmp/qjson.h"
 
@@ -1647,11 +1648,15 @@ static void bdrv_stats_iter(QObject *data, void *opaque)
                         " wr_bytes=%" PRId64
                         " rd_operations=%" PRId64
                         " wr_operations=%" PRId64
+                        " rd_total_time_ns=%" PRId64
+                        " wr_total_time_ns=%" PRId64
                         "\n",
                         qdict_get_int(qdict, "rd_bytes"),
                         qdict_get_int(qdict, "wr_bytes"),
                         qdict_get_int(qdict, "rd_operations"),
-                        qdict_get_int(qdict, "wr_operations"));
+                        qdict_get_int(qdict, "wr_operations"),
+                        qdict_get_int(qdict, "rd_total_time_ns"),
+                        qdict_get_int(qdict, "wr_total_time_ns"));
 }
 
 void bdrv_stats_print(Monitor *mon, const QObject *data)
@@ -1669,10 +1674,13 @@ static QObject* bdrv_info_stats_bs(BlockDriverState *bs)
                              "'wr_bytes': %" PRId64 ","
                              "'rd_operations': %" PRId64 ","
                              "'wr_operations': %" PRId64 ","
+                             "'rd_total_time_ns': %" PRId64 ","
+                             "'wr_total_time_ns': %" PRId64 ","
                              "'wr_highest_offset': %" PRId64
                              "} }",
                              bs->rd_bytes, bs->wr_bytes,
                              bs->rd_ops, bs->wr_ops,
+                             bs->rd_total_time_ns, bs->wr_total_time_ns,
                              bs->wr_highest_sector *
                              (uint64_t)BDRV_SECTOR_SIZE);
     dict  = qobject_to_qdict(res);
@@ -1976,6 +1984,113 @@ char *bdrv_snapshot_dump(char *buf, int buf_size, QEMUSnapshotInfo *sn)
 /**************************************************************/
 /* async I/Os */
 
+/* Requests submitted with bdrv_aio_readv/writev() are wrapped to measure
+ * the time spent until their completion, see "info blockstats". */
+typedef struct BlockAcctAIOCB {
+    BlockDriverAIOCB common;
+    BlockDriverAIOCB *inner;
+    QEMUBH *bh;
+    int64_t start_ns;
+    int is_write;
+    int submitting;
+    int done;
+    int cancelled;
+    int ret;
+} BlockAcctAIOCB;
+
+static void bdrv_aio_cancel_acct(BlockDriverAIOCB *blockacb)
+{
+    BlockAcctAIOCB *acb = container_of(blockacb, BlockAcctAIOCB, common);
+
+    if (acb->bh) {
+        qemu_bh_delete(acb->bh);
+        acb->bh = NULL;
+    } else {
+        acb->cancelled = 1;
+        bdrv_aio_cancel(acb->inner);
+    }
+    qemu_aio_release(acb);
+}
+
+static AIOPool bdrv_acct_aio_pool = {
+    .aiocb_size         = sizeof(BlockAcctAIOCB),
+    .cancel             = bdrv_aio_cancel_acct,
+};
+
+static void bdrv_acct_bh_cb(void *opaque)
+{
+    BlockAcctAIOCB *acb = opaque;
+
+    qemu_bh_delete(acb->bh);
+    acb->bh = NULL;
+    acb->common.cb(acb->common.opaque, acb->ret);
+    qemu_aio_release(acb);
+}
+
+static void bdrv_acct_cb(void *opaque, int ret)
+{
+    BlockAcctAIOCB *acb = opaque;
+    BlockDriverState *bs = acb->common.bs;
+    int64_t ns = get_clock() - acb->start_ns;
+
+    if (acb->is_write) {
+        bs->wr_total_time_ns += ns;
+    } else {
+        bs->rd_total_time_ns += ns;
+    }
+
+    if (acb->cancelled) {
+        return;
+    }
+    if (acb->submitting) {
+        /* The caller doesn't have the ACB yet, call it from a BH. */
+        acb->done = 1;
+        acb->ret = ret;
+        return;
+    }
+    acb->common.cb(acb->common.opaque, ret);
+    qemu_aio_release(acb);
+}
+
+static BlockDriverAIOCB *bdrv_aio_rw_acct(BlockDriverState *bs,
+                                          int64_t sector_num,
+                                          QEMUIOVector *qiov,
+                                          int nb_sectors,
+                                          BlockDriverCompletionFunc *cb,
+                                          void *opaque,
+                                          int is_write)
+{
+    BlockDriver *drv = bs->drv;
+    BlockAcctAIOCB *acb;
+
+    acb = qemu_aio_get(&bdrv_acct_aio_pool, bs, cb, opaque);
+    acb->bh = NULL;
+    acb->start_ns = get_clock();
+    acb->is_write = is_write;
+    acb->submitting = 1;
+    acb->done = 0;
+    acb->cancelled = 0;
+
+    if (is_write) {
+        acb->inner = drv->bdrv_aio_writev(bs, sector_num, qiov, nb_sectors,
+                                          bdrv_acct_cb, acb);
+    } else {
+        acb->inner = drv->bdrv_aio_readv(bs, sector_num, qiov, nb_sectors,
+                                         bdrv_acct_cb, acb);
+    }
+    acb->submitting = 0;
+
+    if (!acb->inner) {
+        qemu_aio_release(acb);
+        return NULL;
+    }
+    if (acb->done) {
+        acb->bh = qemu_bh_new(bdrv_acct_bh_cb, acb);
+        qemu_bh_schedule(acb->bh);
+    }
+    return &acb->common;
+}
+
 BlockDriverAIOCB *bdrv_aio_readv(BlockDriverState *bs, int64_t sector_num,
                                  QEMUIOVector *qiov, int nb_sectors,
                                  BlockDriverCompletionFunc *cb, void *opaque)
@@ -1988,8 +2103,7 @@ BlockDriverAIOCB *bdrv_aio_readv(BlockDriverState *bs, int64_t sector_num,
     if (bdrv_check_request(bs, sector_num, nb_sectors))
         return NULL;
 
-    ret = drv->bdrv_aio_readv(bs, sector_num, qiov, nb_sectors,
-                              cb, opaque);
+    ret = bdrv_aio_rw_acct(bs, sector_num, qiov, nb_sectors, cb, opaque, 0);
 
     if (ret) {
 	/* Update stats even though technically transfer has not happened. */
@@ -2018,8 +2132,7 @@ BlockDriverAIOCB *bdrv_aio_writev(BlockDriverState *bs, int64_t sector_num,
         set_dirty_bitmap(bs, sector_num, nb_sectors, 1);
     }
 
-    ret = drv->bdrv_aio_writev(bs, sector_num, qiov, nb_sectors,
-                               cb, opaque);
+    ret = bdrv_aio_rw_acct(bs, sector_num, qiov, nb_sectors, cb, opaque, 1);
 
     if (ret) {
         /* Update stats even though technically transfer has not happened. */
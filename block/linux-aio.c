@@ -0,0 +1,378 @@
+/*
+ * Linux native AIO support.
+ *
+ * Copyright (C) 2009 IBM, Corp.
+ * Copyright (C) 2009 Red Hat, Inc.
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/* Requests are not submitted to the kernel one at a time: they are queued
+ * and sent with a single io_submit() call from a bottom half, so that all
+ * requests issued by a device model in one go only cost one system call.
+ * Completions are signaled through an eventfd, which is polled with the
+ * other AIO file descriptors.
+ *
+ * The io_*() system calls are invoked directly, so that this doesn't
+ * depend on libaio being installed on the build or the host machine.
+ */
+
+#include "qemu-common.h"
+#include "qemu/queue.h"
+#include "block/aio.h"
+#include "block/block_int.h"
+#include "block/raw-posix-aio.h"
+
+#include <linux/aio_abi.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+/*
+ * Maximum number of requests that can be in flight, or queued for
+ * submission, at the same time. laio_submit() fails once it is reached,
+ * and raw-posix falls back to the thread pool.
+ */
+#define MAX_EVENTS 128
+
+struct qemu_laiocb {
+    BlockDriverAIOCB common;
+    struct qemu_laio_state *ctx;
+    struct iocb iocb;
+    ssize_t ret;
+    size_t nbytes;
+    int async_context_id;
+    QLIST_ENTRY(qemu_laiocb) node;
+};
+
+struct qemu_laio_state {
+    aio_context_t ctx;
+    int efd;
+
+    /* number of requests in flight or queued */
+    int count;
+
+    /* requests waiting for the next io_submit() */
+    struct iocb *queue[MAX_EVENTS];
+    int queued;
+    QEMUBH *submit_bh;
+    int submit_context_id;
+
+    /* completed requests of another AsyncContext */
+    QLIST_HEAD(, qemu_laiocb) completed_reqs;
+};
+
+static int io_setup(unsigned nr_events, aio_context_t *ctx)
+{
+    return syscall(SYS_io_setup, nr_events, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+    return syscall(SYS_io_submit, ctx, nr, iocbpp);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long nr,
+                        struct io_event *events, struct timespec *timeout)
+{
+    return syscall(SYS_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+static int io_cancel(aio_context_t ctx, struct iocb *iocb,
+                     struct io_event *result)
+{
+    return syscall(SYS_io_cancel, ctx, iocb, result);
+}
+
+/*
+ * Completes an AIO request (calls the callback and frees the ACB).
+ * Be sure to be in the right AsyncContext before calling this function.
+ */
+static void qemu_laio_process_completion(struct qemu_laio_state *s,
+    struct qemu_laiocb *laiocb)
+{
+    int ret;
+
+    s->count--;
+
+    ret = laiocb->ret;
+    if (ret != -ECANCELED) {
+        if (ret == laiocb->nbytes)
+            ret = 0;
+        else if (ret >= 0)
+            ret = -EINVAL;
+
+        laiocb->common.cb(laiocb->common.opaque, ret);
+    }
+
+    qemu_aio_release(laiocb);
+}
+
+/*
+ * Processes all queued AIO requests, i.e. requests that have returned from
+ * the kernel but whose callback could not be run because they belonged to
+ * another AsyncContext.
+ */
+static int qemu_laio_process_requests(void *opaque)
+{
+    struct qemu_laio_state *s = opaque;
+    struct qemu_laiocb *laiocb, *next;
+    int res = 0;
+
+    QLIST_FOREACH_SAFE (laiocb, &s->completed_reqs, node, next) {
+        if (laiocb->async_context_id == get_async_context_id()) {
+            QLIST_REMOVE(laiocb, node);
+            qemu_laio_process_completion(s, laiocb);
+            res = 1;
+        }
+    }
+
+    return res;
+}
+
+/*
+ * Puts a request in the completion queue so that its callback is called the
+ * next time when it's possible. If we already are in the right AsyncContext,
+ * the request is completed immediately instead.
+ */
+static void qemu_laio_enqueue_completed(struct qemu_laio_state *s,
+    struct qemu_laiocb* laiocb)
+{
+    if (laiocb->async_context_id == get_async_context_id()) {
+        qemu_laio_process_completion(s, laiocb);
+    } else {
+        QLIST_INSERT_HEAD(&s->completed_reqs, laiocb, node);
+    }
+}
+
+/* Send all queued requests to the kernel. Requests that cannot be
+ * submitted are completed with an error. */
+static void qemu_laio_submit_queued(struct qemu_laio_state *s)
+{
+    struct iocb *queue[MAX_EVENTS];
+    struct qemu_laiocb *failed[MAX_EVENTS];
+    int queued = s->queued;
+    int nfailed = 0;
+    int done = 0;
+    int i, ret;
+
+    /* Completion callbacks may queue new requests, so take the current
+     * ones out of the queue first. */
+    memcpy(queue, s->queue, queued * sizeof(queue[0]));
+    s->queued = 0;
+
+    while (done < queued) {
+        ret = io_submit(s->ctx, queued - done, &queue[done]);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            /* Fail the first request, and try again with the others. */
+            struct qemu_laiocb *laiocb =
+                container_of(queue[done], struct qemu_laiocb, iocb);
+
+            laiocb->ret = (ret < 0) ? -errno : -EIO;
+            failed[nfailed++] = laiocb;
+            ret = 1;
+        }
+        done += ret;
+    }
+
+    for (i = 0; i < nfailed; i++) {
+        qemu_laio_enqueue_completed(s, failed[i]);
+    }
+}
+
+static void qemu_laio_submit_bh(void *opaque)
+{
+    struct qemu_laio_state *s = opaque;
+
+    qemu_bh_delete(s->submit_bh);
+    s->submit_bh = NULL;
+    qemu_laio_submit_queued(s);
+}
+
+static void qemu_laio_completion_cb(void *opaque)
+{
+    struct qemu_laio_state *s = opaque;
+
+    while (1) {
+        struct io_event events[MAX_EVENTS];
+        uint64_t val;
+        ssize_t ret;
+        struct timespec ts = { 0 };
+        int nevents, i;
+
+        do {
+            ret = read(s->efd, &val, sizeof(val));
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret == -1 && errno == EAGAIN)
+            break;
+
+        if (ret != 8)
+            break;
+
+        do {
+            nevents = io_getevents(s->ctx, val, MAX_EVENTS, events, &ts);
+        } while (nevents == -1 && errno == EINTR);
+
+        for (i = 0; i < nevents; i++) {
+            struct iocb *iocb = (struct iocb *)(uintptr_t)events[i].obj;
+            struct qemu_laiocb *laiocb =
+                    container_of(iocb, struct qemu_laiocb, iocb);
+
+            laiocb->ret = events[i].res;
+            qemu_laio_enqueue_completed(s, laiocb);
+        }
+    }
+}
+
+static int qemu_laio_flush_cb(void *opaque)
+{
+    struct qemu_laio_state *s = opaque;
+
+    return (s->count > 0) ? 1 : 0;
+}
+
+static void laio_cancel(BlockDriverAIOCB *blockacb)
+{
+    struct qemu_laiocb *laiocb = (struct qemu_laiocb *)blockacb;
+    struct qemu_laio_state *s = laiocb->ctx;
+    struct io_event event;
+    int i, ret;
+
+    if (laiocb->ret != -EINPROGRESS) {
+        /* Completed, but waiting for its AsyncContext: drop the callback. */
+        laiocb->ret = -ECANCELED;
+        return;
+    }
+
+    /* The request may not have been sent to the kernel yet. */
+    for (i = 0; i < s->queued; i++) {
+        if (s->queue[i] == &laiocb->iocb) {
+            memmove(&s->queue[i], &s->queue[i + 1],
+                    (s->queued - i - 1) * sizeof(s->queue[0]));
+            s->queued--;
+            s->count--;
+            qemu_aio_release(laiocb);
+            return;
+        }
+    }
+
+    /*
+     * Note that as of Linux 2.6.31 neither the block device code nor any
+     * filesystem implements cancellation of AIO request.
+     * Thus the polling loop below is the normal code path.
+     */
+    ret = io_cancel(s->ctx, &laiocb->iocb, &event);
+    if (ret == 0) {
+        s->count--;
+        qemu_aio_release(laiocb);
+        return;
+    }
+
+    /*
+     * We have to wait for the iocb to finish.
+     *
+     * The only way to get the iocb status update is by polling the io context.
+     * We might be able to do this slightly more optimal by removing the
+     * O_NONBLOCK flag.
+     */
+    while (laiocb->ret == -EINPROGRESS)
+        qemu_laio_completion_cb(s);
+}
+
+static AIOPool laio_pool = {
+    .aiocb_size         = sizeof(struct qemu_laiocb),
+    .cancel             = laio_cancel,
+};
+
+BlockDriverAIOCB *laio_submit(BlockDriverState *bs, void *aio_ctx, int fd,
+        int64_t sector_num, QEMUIOVector *qiov, int nb_sectors,
+        BlockDriverCompletionFunc *cb, void *opaque, int type)
+{
+    struct qemu_laio_state *s = aio_ctx;
+    struct qemu_laiocb *laiocb;
+    struct iocb *iocbs;
+    off_t offset = sector_num * 512;
+
+    if (s->count >= MAX_EVENTS)
+        return NULL;
+
+    laiocb = qemu_aio_get(&laio_pool, bs, cb, opaque);
+    if (!laiocb)
+        return NULL;
+    laiocb->ctx = s;
+    laiocb->nbytes = nb_sectors * 512;
+    laiocb->ret = -EINPROGRESS;
+    laiocb->async_context_id = get_async_context_id();
+
+    iocbs = &laiocb->iocb;
+    memset(iocbs, 0, sizeof(*iocbs));
+    iocbs->aio_fildes = fd;
+    iocbs->aio_buf = (uintptr_t)qiov->iov;
+    iocbs->aio_nbytes = qiov->niov;
+    iocbs->aio_offset = offset;
+    iocbs->aio_flags = IOCB_FLAG_RESFD;
+    iocbs->aio_resfd = s->efd;
+    iocbs->aio_data = (uintptr_t)iocbs;
+
+    switch (type) {
+    case QEMU_AIO_WRITE:
+        iocbs->aio_lio_opcode = IOCB_CMD_PWRITEV;
+        break;
+    case QEMU_AIO_READ:
+        iocbs->aio_lio_opcode = IOCB_CMD_PREADV;
+        break;
+    default:
+        fprintf(stderr, "%s: invalid AIO request type 0x%x.\n",
+                        __func__, type);
+        qemu_aio_release(laiocb);
+        return NULL;
+    }
+
+    /* A bottom half only runs in the AsyncContext that created it, so
+     * send the requests of another context before queuing this one. */
+    if (s->queued > 0 && s->submit_context_id != get_async_context_id()) {
+        qemu_bh_delete(s->submit_bh);
+        s->submit_bh = NULL;
+        qemu_laio_submit_queued(s);
+    }
+
+    s->queue[s->queued++] = iocbs;
+    s->count++;
+    if (!s->submit_bh) {
+        s->submit_bh = qemu_bh_new(qemu_laio_submit_bh, s);
+        s->submit_context_id = get_async_context_id();
+        qemu_bh_schedule(s->submit_bh);
+    }
+    return &laiocb->common;
+}
+
+void *laio_init(void)
+{
+    struct qemu_laio_state *s;
+
+    s = g_malloc0(sizeof(*s));
+    QLIST_INIT(&s->completed_reqs);
+    s->efd = eventfd(0, 0);
+    if (s->efd == -1)
+        goto out_free_state;
+    fcntl(s->efd, F_SETFL, O_NONBLOCK);
+
+    if (io_setup(MAX_EVENTS, &s->ctx) != 0)
+        goto out_close_efd;
+
+    qemu_aio_set_fd_handler(s->efd, qemu_laio_completion_cb, NULL,
+        qemu_laio_flush_cb, qemu_laio_process_requests, s);
+
+    return s;
+
+out_close_efd:
+    close(s->efd);
+out_free_state:
+    g_free(s);
+    return NULL;
+}
@@ -518,8 +518,14 @@ static BlockDriverAIOCB *raw_aio_submit(BlockDriverState *bs,
             type |= QEMU_AIO_MISALIGNED;
 #ifdef CONFIG_LINUX_AIO
         } else if (s->use_aio) {
-            return laio_submit(bs, s->aio_ctx, s->fd, sector_num, qiov,
-                               nb_sectors, cb, opaque, type);
+            BlockDriverAIOCB *acb;
+
+            /* Use the thread pool when too many requests are in flight. */
+            acb = laio_submit(bs, s->aio_ctx, s->fd, sector_num, qiov,
+                              nb_sectors, cb, opaque, type);
+            if (acb) {
+                return acb;
+            }
 #endif
         }
     }
@@ -19,4 +19,8 @@
 //
 CodeProfileRecordFunc code_profile_record_func = NULL;
 
+CodeProfileBinaryFunc code_profile_binary_func = NULL;
+
 const char *code_profile_dirname = NULL;
+
+const char *guest_profile_filename = NULL;
@@ -155,7 +155,8 @@ static TranslationBlock *tb_find_slow(CPUArchState *env,
     }
  not_found:
    /* if no translated code available, then translate it now */
-    tb = tb_gen_code(env, pc, cs_base, flags, 0);
+    tb = tb_gen_code(env, pc, cs_base, flags,
+                     (tcg_trace_threshold && !use_icount) ? CF_HOT_COUNT : 0);
 
  found:
     /* Move the last found TB to the head of the list */
@@ -187,6 +188,26 @@ static inline TranslationBlock *tb_find_fast(CPUArchState *env)
     return tb;
 }
 
+/* Look up the TB that follows an indirect branch, from generated code.
+   Only tb_jmp_cache is probed: return the host code of the TB, or the
+   epilogue that goes back to cpu_exec() to find or translate it. */
+void *helper_lookup_tb_ptr(CPUArchState *env)
+{
+    TranslationBlock *tb;
+    target_ulong cs_base, pc;
+    int flags;
+
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+    tb = env->tb_jmp_cache[tb_jmp_cache_hash_func(pc)];
+    if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
+                 tb->flags != flags)) {
+        tcg_ctx.tb_ctx.tb_lookup_miss_count++;
+        return tcg_ctx.code_gen_epilogue;
+    }
+    tcg_ctx.tb_ctx.tb_lookup_hit_count++;
+    return tb->tc_ptr;
+}
+
 static CPUDebugExcpHandler *debug_excp_handler;
 
 void cpu_set_debug_excp_handler(CPUDebugExcpHandler *handler)
@@ -560,6 +581,13 @@ int cpu_exec(CPUOldState *env)
 #endif /* DEBUG_DISAS || CONFIG_DEBUG_EXEC */
                 spin_lock(&tcg_ctx.tb_ctx.tb_lock);
                 tb = tb_find_fast(env);
+                /* The block ran often enough to be worth a trace, and
+                   exited with TB_EXIT_REQUESTED for that purpose. */
+                if (unlikely((tb->cflags & CF_HOT_COUNT) &&
+                             tb->exec_count <= 0)) {
+                    tb = tb_gen_trace(env, tb);
+                    next_tb = 0;
+                }
                 /* Note: we do it here to avoid a gcc bug on Mac OS X when
                    doing it in tb_find_slow */
                 if (tcg_ctx.tb_ctx.tb_invalidated_flag) {
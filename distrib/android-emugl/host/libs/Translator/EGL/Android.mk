@@ -4,7 +4,8 @@ host_OS_SRCS :=
 host_common_LDLIBS :=
 
 ifeq ($(HOST_OS),linux)
-    host_OS_SRCS = EglOsApi_glx.cpp
+    host_OS_SRCS = EglOsApi_glx.cpp \
+                   EglOsApi_egl.cpp
     host_common_LDLIBS += -lGL -lX11 -ldl -lpthread
 endif
 
@@ -21,6 +21,9 @@
 
 #include "emugl/common/lazy_instance.h"
 
+#include "OpenglCodecCommon/ErrorLog.h"
+
+#include <stdlib.h>
 #include <string.h>
 
 namespace {
@@ -40,8 +43,18 @@ EglGlobalInfo::EglGlobalInfo() :
         m_engine(NULL),
         m_display(NULL),
         m_lock() {
-    // TODO(digit): Choose alternate engine based on env. variable?
-    m_engine = EglOS::Engine::getHostInstance();
+    // Use the headless engine if ANDROID_EMUGL_HEADLESS is defined, and
+    // fall back to the host one if it is not available.
+    const char* headless = getenv("ANDROID_EMUGL_HEADLESS");
+    if (headless && headless[0] && headless[0] != '0') {
+        m_engine = EglOS::Engine::getHeadlessInstance();
+        if (!m_engine) {
+            ERR("%s: No headless EGL engine, using host one\n", __FUNCTION__);
+        }
+    }
+    if (!m_engine) {
+        m_engine = EglOS::Engine::getHostInstance();
+    }
     m_display = m_engine->getDefaultDisplay();
 
     memset(m_gles_ifaces, 0, sizeof(m_gles_ifaces));
@@ -181,6 +181,12 @@ public:
     // Retrieve the implementation for the current host. This can be called
     // multiple times, and will initialize the engine on first call.
     static Engine* getHostInstance();
+
+    // Retrieve an implementation that doesn't need a windowing system,
+    // and only supports Pbuffer surfaces. Return NULL if there is none
+    // on this host. Currently only implemented on Linux, on top of the
+    // host EGL device or Mesa surfaceless platforms.
+    static Engine* getHeadlessInstance();
 };
 
 }  // namespace EglOS
@@ -0,0 +1,505 @@
+/*
+* Copyright (C) 2015 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// An EglOS::Engine implementation that runs on top of the host's own EGL
+// library, using either the EGL_EXT_platform_device or the
+// EGL_MESA_platform_surfaceless platform. Neither one requires an X11
+// server, which makes it suitable for headless emulator instances.
+//
+// Only Pbuffer surfaces are supported, window surfaces are never
+// created. Desktop GL contexts are created through EGL_OPENGL_API, and
+// desktop GL entry points are resolved through the host's
+// eglGetProcAddress().
+//
+// IMPORTANT: The host EGL library exports functions with the same names
+// as our own EGL translator, so all host entry points are accessed
+// through function pointers probed at runtime, never linked directly.
+
+#include "EglOsApi.h"
+
+#include "emugl/common/lazy_instance.h"
+#include "emugl/common/shared_library.h"
+#include "GLcommon/GLLibrary.h"
+
+#include "OpenglCodecCommon/ErrorLog.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Definitions from EGL_EXT_platform_base, EGL_EXT_device_base and
+// EGL_MESA_platform_surfaceless, which are not part of our EGL headers.
+typedef void* HostEGLDeviceEXT;
+
+#define HOST_EGL_PLATFORM_DEVICE_EXT        0x313F
+#define HOST_EGL_PLATFORM_SURFACELESS_MESA  0x31DD
+
+// The list of host EGL functions used by this engine. Each entry is
+// X(return_type, function_name, signature).
+#define LIST_HOST_EGL_FUNCTIONS(X) \
+    X(EGLint, eglGetError, (void)) \
+    X(EGLDisplay, eglGetDisplay, (EGLNativeDisplayType)) \
+    X(EGLBoolean, eglInitialize, (EGLDisplay, EGLint*, EGLint*)) \
+    X(EGLBoolean, eglTerminate, (EGLDisplay)) \
+    X(const char*, eglQueryString, (EGLDisplay, EGLint)) \
+    X(EGLBoolean, eglGetConfigs, (EGLDisplay, EGLConfig*, EGLint, EGLint*)) \
+    X(EGLBoolean, eglGetConfigAttrib, \
+            (EGLDisplay, EGLConfig, EGLint, EGLint*)) \
+    X(EGLBoolean, eglBindAPI, (EGLenum)) \
+    X(EGLContext, eglCreateContext, \
+            (EGLDisplay, EGLConfig, EGLContext, const EGLint*)) \
+    X(EGLBoolean, eglDestroyContext, (EGLDisplay, EGLContext)) \
+    X(EGLSurface, eglCreatePbufferSurface, \
+            (EGLDisplay, EGLConfig, const EGLint*)) \
+    X(EGLBoolean, eglDestroySurface, (EGLDisplay, EGLSurface)) \
+    X(EGLBoolean, eglMakeCurrent, \
+            (EGLDisplay, EGLSurface, EGLSurface, EGLContext)) \
+    X(EGLBoolean, eglSwapBuffers, (EGLDisplay, EGLSurface)) \
+    X(__eglMustCastToProperFunctionPointerType, eglGetProcAddress, \
+            (const char*))
+
+// Optional extension functions, probed through eglGetProcAddress().
+typedef EGLDisplay (EGLAPIENTRY *GetPlatformDisplayFunc)(
+        EGLenum, void*, const EGLint*);
+typedef EGLBoolean (EGLAPIENTRY *QueryDevicesFunc)(
+        EGLint, HostEGLDeviceEXT*, EGLint*);
+
+// A class used to hold the host EGL entry points.
+class HostEgl {
+public:
+    HostEgl() : mLib(NULL), mValid(false) {
+        static const char kLibName[] = "libEGL.so.1";
+        char error[256];
+        mLib = emugl::SharedLibrary::open(kLibName, error, sizeof(error));
+        if (!mLib) {
+            ERR("%s: Could not open host EGL library %s [%s]\n",
+                __FUNCTION__, kLibName, error);
+            return;
+        }
+#define LOAD_HOST_EGL_FUNCTION(return_type, name, signature) \
+        name = reinterpret_cast<return_type (EGLAPIENTRY *) signature>( \
+                mLib->findSymbol(#name)); \
+        if (!name) { \
+            ERR("%s: Could not find %s in %s\n", \
+                __FUNCTION__, #name, kLibName); \
+            return; \
+        }
+        LIST_HOST_EGL_FUNCTIONS(LOAD_HOST_EGL_FUNCTION)
+#undef LOAD_HOST_EGL_FUNCTION
+
+        eglGetPlatformDisplayEXT = reinterpret_cast<GetPlatformDisplayFunc>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        eglQueryDevicesEXT = reinterpret_cast<QueryDevicesFunc>(
+                eglGetProcAddress("eglQueryDevicesEXT"));
+        mValid = true;
+    }
+
+    ~HostEgl() {
+        delete mLib;
+    }
+
+    bool isValid() const { return mValid; }
+
+#define DECLARE_HOST_EGL_FUNCTION(return_type, name, signature) \
+    return_type (EGLAPIENTRY *name) signature;
+    LIST_HOST_EGL_FUNCTIONS(DECLARE_HOST_EGL_FUNCTION)
+#undef DECLARE_HOST_EGL_FUNCTION
+
+    GetPlatformDisplayFunc eglGetPlatformDisplayEXT;
+    QueryDevicesFunc eglQueryDevicesEXT;
+
+private:
+    emugl::SharedLibrary* mLib;
+    bool mValid;
+};
+
+emugl::LazyInstance<HostEgl> sHostEgl = LAZY_INSTANCE_INIT;
+
+// Return true iff |ext| appears in the space-separated |extensions| list.
+bool hasExtension(const char* extensions, const char* ext) {
+    if (!extensions) {
+        return false;
+    }
+    size_t extLen = strlen(ext);
+    const char* p = extensions;
+    while ((p = strstr(p, ext)) != NULL) {
+        if ((p == extensions || p[-1] == ' ') &&
+            (p[extLen] == ' ' || p[extLen] == '\0')) {
+            return true;
+        }
+        p += extLen;
+    }
+    return false;
+}
+
+// Open a headless host EGL display. If ANDROID_EMUGL_HEADLESS is set to
+// 'surfaceless', only the Mesa surfaceless platform is tried, otherwise
+// the first EGL device is preferred, falling back to surfaceless.
+EGLDisplay openHeadlessDisplay(HostEgl* egl) {
+    if (!egl->eglGetPlatformDisplayEXT) {
+        ERR("%s: Host EGL does not support eglGetPlatformDisplayEXT\n",
+            __FUNCTION__);
+        return EGL_NO_DISPLAY;
+    }
+    const char* clientExtensions =
+            egl->eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    const char* env = getenv("ANDROID_EMUGL_HEADLESS");
+    bool forceSurfaceless = env && !strcmp(env, "surfaceless");
+
+    if (!forceSurfaceless && egl->eglQueryDevicesEXT &&
+        hasExtension(clientExtensions, "EGL_EXT_platform_device")) {
+        HostEGLDeviceEXT device = NULL;
+        EGLint numDevices = 0;
+        if (egl->eglQueryDevicesEXT(1, &device, &numDevices) &&
+            numDevices > 0) {
+            EGLDisplay dpy = egl->eglGetPlatformDisplayEXT(
+                    HOST_EGL_PLATFORM_DEVICE_EXT, device, NULL);
+            if (dpy != EGL_NO_DISPLAY) {
+                return dpy;
+            }
+        }
+    }
+
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        return egl->eglGetPlatformDisplayEXT(
+                HOST_EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+
+    ERR("%s: Host EGL supports neither device nor surfaceless platforms\n",
+        __FUNCTION__);
+    return EGL_NO_DISPLAY;
+}
+
+// Implementation of EglOS::PixelFormat based on a host EGLConfig.
+class EglPixelFormat : public EglOS::PixelFormat {
+public:
+    explicit EglPixelFormat(EGLConfig config) : mConfig(config) {}
+
+    virtual EglOS::PixelFormat* clone() {
+        return new EglPixelFormat(mConfig);
+    }
+
+    EGLConfig config() const { return mConfig; }
+
+    static EGLConfig from(const EglOS::PixelFormat* f) {
+        return static_cast<const EglPixelFormat*>(f)->config();
+    }
+
+private:
+    EGLConfig mConfig;
+};
+
+// Implementation of EglOS::Surface based on a host EGL Pbuffer.
+class EglPbuffer : public EglOS::Surface {
+public:
+    explicit EglPbuffer(EGLSurface surface) :
+            Surface(PBUFFER), mSurface(surface) {}
+
+    EGLSurface surface() const { return mSurface; }
+
+    static EGLSurface surfaceFor(EglOS::Surface* surface) {
+        return surface ? static_cast<EglPbuffer*>(surface)->surface()
+                       : EGL_NO_SURFACE;
+    }
+
+private:
+    EGLSurface mSurface;
+};
+
+// Implementation of EglOS::Context based on a host EGLContext.
+class EglHostContext : public EglOS::Context {
+public:
+    explicit EglHostContext(EGLContext context) : mContext(context) {}
+
+    EGLContext context() const { return mContext; }
+
+    static EGLContext contextFor(EglOS::Context* context) {
+        return context ? static_cast<EglHostContext*>(context)->context()
+                       : EGL_NO_CONTEXT;
+    }
+
+private:
+    EGLContext mContext;
+};
+
+// Implementation of EglOS::Display based on a headless host EGLDisplay.
+class EglHeadlessDisplay : public EglOS::Display {
+public:
+    EglHeadlessDisplay(HostEgl* egl, EGLDisplay dpy) :
+            mEgl(egl), mDisplay(dpy) {}
+
+    virtual bool release() {
+        return mEgl->eglTerminate(mDisplay);
+    }
+
+    virtual void queryConfigs(int renderableType,
+                              EglOS::AddConfigCallback* addConfigFunc,
+                              void* addConfigOpaque) {
+        EGLint n = 0;
+        if (!mEgl->eglGetConfigs(mDisplay, NULL, 0, &n) || n <= 0) {
+            return;
+        }
+        EGLConfig* configs = new EGLConfig[n];
+        mEgl->eglGetConfigs(mDisplay, configs, n, &n);
+        for (EGLint i = 0; i < n; ++i) {
+            configToInfo(renderableType,
+                         configs[i],
+                         addConfigFunc,
+                         addConfigOpaque);
+        }
+        delete [] configs;
+    }
+
+    virtual bool isValidNativeWin(EglOS::Surface* win) {
+        return false;
+    }
+
+    virtual bool isValidNativeWin(EGLNativeWindowType win) {
+        return false;
+    }
+
+    virtual bool checkWindowPixelFormatMatch(
+            EGLNativeWindowType win,
+            const EglOS::PixelFormat* pixelFormat,
+            unsigned int* width,
+            unsigned int* height) {
+        return false;
+    }
+
+    virtual EglOS::Context* createContext(
+            const EglOS::PixelFormat* pixelFormat,
+            EglOS::Context* sharedContext) {
+        // The bound API is per-thread state, so set it on each call.
+        mEgl->eglBindAPI(EGL_OPENGL_API);
+        EGLContext ctx = mEgl->eglCreateContext(
+                mDisplay,
+                EglPixelFormat::from(pixelFormat),
+                EglHostContext::contextFor(sharedContext),
+                NULL);
+        if (ctx == EGL_NO_CONTEXT) {
+            ERR("%s: Could not create host context: 0x%x\n",
+                __FUNCTION__, mEgl->eglGetError());
+            return NULL;
+        }
+        return new EglHostContext(ctx);
+    }
+
+    virtual bool destroyContext(EglOS::Context* context) {
+        return mEgl->eglDestroyContext(
+                mDisplay, EglHostContext::contextFor(context));
+    }
+
+    virtual EglOS::Surface* createPbufferSurface(
+            const EglOS::PixelFormat* pixelFormat,
+            const EglOS::PbufferInfo* info) {
+        const EGLint attribs[] = {
+            EGL_WIDTH, info->width,
+            EGL_HEIGHT, info->height,
+            EGL_LARGEST_PBUFFER, info->largest,
+            EGL_NONE
+        };
+        EGLSurface surface = mEgl->eglCreatePbufferSurface(
+                mDisplay, EglPixelFormat::from(pixelFormat), attribs);
+        return (surface != EGL_NO_SURFACE) ? new EglPbuffer(surface) : NULL;
+    }
+
+    virtual bool releasePbuffer(EglOS::Surface* pb) {
+        if (!pb) {
+            return false;
+        }
+        return mEgl->eglDestroySurface(mDisplay, EglPbuffer::surfaceFor(pb));
+    }
+
+    virtual bool makeCurrent(EglOS::Surface* read,
+                             EglOS::Surface* draw,
+                             EglOS::Context* context) {
+        if (!context && !read && !draw) {
+            // unbind
+            mEgl->eglBindAPI(EGL_OPENGL_API);
+            return mEgl->eglMakeCurrent(
+                    mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        if (!context || !read || !draw) {
+            return false;
+        }
+        mEgl->eglBindAPI(EGL_OPENGL_API);
+        return mEgl->eglMakeCurrent(mDisplay,
+                                    EglPbuffer::surfaceFor(draw),
+                                    EglPbuffer::surfaceFor(read),
+                                    EglHostContext::contextFor(context));
+    }
+
+    virtual void swapBuffers(EglOS::Surface* srfc) {
+        // Nothing to do for Pbuffers.
+    }
+
+private:
+    void configToInfo(int renderableType,
+                      EGLConfig config,
+                      EglOS::AddConfigCallback* addConfigFunc,
+                      void* addConfigOpaque) {
+        EGLint tmp = 0;
+
+        // Only keep configs that can render desktop GL to a Pbuffer.
+        if (!getAttrib(config, EGL_RENDERABLE_TYPE, &tmp) ||
+            !(tmp & EGL_OPENGL_BIT)) {
+            return;
+        }
+        if (!getAttrib(config, EGL_SURFACE_TYPE, &tmp) ||
+            !(tmp & EGL_PBUFFER_BIT)) {
+            return;
+        }
+        if (!getAttrib(config, EGL_COLOR_BUFFER_TYPE, &tmp) ||
+            tmp != EGL_RGB_BUFFER) {
+            return;
+        }
+
+        EglOS::ConfigInfo info;
+        memset(&info, 0, sizeof(info));
+
+        if (!getAttrib(config, EGL_RED_SIZE, &info.red_size) ||
+            !getAttrib(config, EGL_GREEN_SIZE, &info.green_size) ||
+            !getAttrib(config, EGL_BLUE_SIZE, &info.blue_size) ||
+            !getAttrib(config, EGL_ALPHA_SIZE, &info.alpha_size) ||
+            !getAttrib(config, EGL_DEPTH_SIZE, &info.depth_size) ||
+            !getAttrib(config, EGL_STENCIL_SIZE, &info.stencil_size) ||
+            !getAttrib(config, EGL_CONFIG_ID, &info.config_id) ||
+            !getAttrib(config, EGL_LEVEL, &info.frame_buffer_level) ||
+            !getAttrib(config, EGL_SAMPLES, &info.samples_per_pixel) ||
+            !getAttrib(config, EGL_MAX_PBUFFER_WIDTH,
+                       &info.max_pbuffer_width) ||
+            !getAttrib(config, EGL_MAX_PBUFFER_HEIGHT,
+                       &info.max_pbuffer_height) ||
+            !getAttrib(config, EGL_MAX_PBUFFER_PIXELS,
+                       &info.max_pbuffer_size)) {
+            return;
+        }
+
+        if (!getAttrib(config, EGL_CONFIG_CAVEAT, &tmp)) {
+            return;
+        }
+        info.caveat = tmp;
+
+        info.renderable_type = renderableType;
+        info.native_renderable = EGL_FALSE;
+        info.native_visual_id = 0;
+        info.native_visual_type = EGL_NONE;
+        info.surface_type = EGL_PBUFFER_BIT;
+        info.transparent_type = EGL_NONE;
+        info.frmt = new EglPixelFormat(config);
+
+        (*addConfigFunc)(addConfigOpaque, &info);
+    }
+
+    bool getAttrib(EGLConfig config, EGLint attrib, EGLint* value) {
+        return mEgl->eglGetConfigAttrib(mDisplay, config, attrib, value);
+    }
+
+    HostEgl* mEgl;
+    EGLDisplay mDisplay;
+};
+
+class EglHeadlessLibrary : public GlLibrary {
+public:
+    explicit EglHeadlessLibrary(HostEgl* egl) : mEgl(egl), mLib(NULL) {
+        // Under GLVND, desktop GL entry points are exported by
+        // libOpenGL.so.0, while legacy drivers put them in libGL.so.1.
+        static const char* const kLibNames[] = {
+            "libOpenGL.so.0",
+            "libGL.so.1",
+        };
+        for (size_t n = 0; n < sizeof(kLibNames) / sizeof(kLibNames[0]);
+             ++n) {
+            mLib = emugl::SharedLibrary::open(kLibNames[n]);
+            if (mLib) {
+                break;
+            }
+        }
+    }
+
+    ~EglHeadlessLibrary() {
+        delete mLib;
+    }
+
+    // override
+    virtual GlFunctionPointer findSymbol(const char* name) {
+        GlFunctionPointer ret = NULL;
+        if (mEgl->isValid()) {
+            ret = reinterpret_cast<GlFunctionPointer>(
+                    mEgl->eglGetProcAddress(name));
+        }
+        if (!ret && mLib) {
+            ret = reinterpret_cast<GlFunctionPointer>(mLib->findSymbol(name));
+        }
+        return ret;
+    }
+
+private:
+    HostEgl* mEgl;
+    emugl::SharedLibrary* mLib;
+};
+
+class EglHeadlessEngine : public EglOS::Engine {
+public:
+    EglHeadlessEngine() :
+            mEgl(sHostEgl.ptr()), mGlLib(mEgl), mDisplay(EGL_NO_DISPLAY) {
+        if (!mEgl->isValid()) {
+            return;
+        }
+        EGLDisplay dpy = openHeadlessDisplay(mEgl);
+        if (dpy == EGL_NO_DISPLAY) {
+            return;
+        }
+        EGLint major = 0, minor = 0;
+        if (!mEgl->eglInitialize(dpy, &major, &minor)) {
+            ERR("%s: Could not initialize headless display: 0x%x\n",
+                __FUNCTION__, mEgl->eglGetError());
+            return;
+        }
+        mDisplay = dpy;
+    }
+
+    bool isValid() const { return mDisplay != EGL_NO_DISPLAY; }
+
+    virtual EglOS::Display* getDefaultDisplay() {
+        return new EglHeadlessDisplay(mEgl, mDisplay);
+    }
+
+    virtual GlLibrary* getGlLibrary() {
+        return &mGlLib;
+    }
+
+    virtual EglOS::Surface* createWindowSurface(EGLNativeWindowType wnd) {
+        return NULL;
+    }
+
+private:
+    HostEgl* mEgl;
+    EglHeadlessLibrary mGlLib;
+    EGLDisplay mDisplay;
+};
+
+emugl::LazyInstance<EglHeadlessEngine> sHeadlessEngine = LAZY_INSTANCE_INIT;
+
+}  // namespace
+
+// static
+EglOS::Engine* EglOS::Engine::getHeadlessInstance() {
+    EglHeadlessEngine* engine = sHeadlessEngine.ptr();
+    return engine->isValid() ? engine : NULL;
+}
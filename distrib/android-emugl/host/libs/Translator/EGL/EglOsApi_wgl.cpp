@@ -1004,3 +1004,9 @@ emugl::LazyInstance<WinEngine> sHostEngine = LAZY_INSTANCE_INIT;
 EglOS::Engine* EglOS::Engine::getHostInstance() {
     return sHostEngine.ptr();
 }
+
+// static
+EglOS::Engine* EglOS::Engine::getHeadlessInstance() {
+    // Not supported on this host.
+    return NULL;
+}
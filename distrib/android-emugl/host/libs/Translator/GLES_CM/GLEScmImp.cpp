@@ -210,6 +210,14 @@ static TextureData* getTextureTargetData(GLenum target){
     return getTextureData(TextureLocalName(target,tex));
 }
 
+// Decode the levels of the texture bound to |target| that the host still
+// stores as ETC1 data, before the texture is modified.
+static void decodeTextureTargetEtc1Levels(GLEScontext* ctx, GLenum target){
+    if (ctx->shareGroup().Ptr()) {
+        decodeEtc1Levels(ctx, getTextureTargetData(target), 0);
+    }
+}
+
 GL_API GLboolean GL_APIENTRY glIsBuffer(GLuint buffer) {
     GET_CTX_RET(GL_FALSE)
 
@@ -461,6 +469,7 @@ GL_API void GL_APIENTRY  glCompressedTexSubImage2D( GLenum target, GLint level,
 
     GLenum uncompressedFrmt;
     unsigned char* uncompressed = uncompressTexture(format,uncompressedFrmt,width,height,imageSize,data,level);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glTexSubImage2D(target,level,xoffset,yoffset,width,height,uncompressedFrmt,GL_UNSIGNED_BYTE,uncompressed);
     delete uncompressed;
 }
@@ -469,12 +478,14 @@ GL_API void GL_APIENTRY  glCopyTexImage2D( GLenum target, GLint level, GLenum in
     GET_CTX()
     SET_ERROR_IF(!(GLEScmValidate::pixelFrmt(ctx,internalformat) && GLEScmValidate::textureTargetEx(target)),GL_INVALID_ENUM);
     SET_ERROR_IF(border != 0,GL_INVALID_VALUE);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glCopyTexImage2D(target,level,internalformat,x,y,width,height,border);
 }
 
 GL_API void GL_APIENTRY  glCopyTexSubImage2D( GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height) {
     GET_CTX()
     SET_ERROR_IF(!GLEScmValidate::textureTargetEx(target),GL_INVALID_ENUM);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glCopyTexSubImage2D(target,level,xoffset,yoffset,x,y,width,height);
 }
 
@@ -1478,6 +1489,11 @@ GL_API void GL_APIENTRY  glTexImage2D( GLenum target, GLint level, GLint interna
             texData->internalFormat = internalformat;
             texData->target = target;
 
+            // The host can't mix the other levels with this one if they
+            // are still stored as ETC1 data.
+            texData->etc1Levels.erase(level);
+            decodeEtc1Levels(ctx, texData, 0);
+
             if (texData->sourceEGLImage != 0) {
                 //
                 // This texture was a target of EGLImage,
@@ -1620,6 +1636,7 @@ GL_API void GL_APIENTRY  glTexSubImage2D( GLenum target, GLint level, GLint xoff
                    GLEScmValidate::pixelType(ctx,type)),GL_INVALID_ENUM);
     SET_ERROR_IF(!GLEScmValidate::pixelOp(format,type),GL_INVALID_OPERATION);
 
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glTexSubImage2D(target,level,xoffset,yoffset,width,height,format,type,pixels);
 
     if (ctx->shareGroup().Ptr()){
@@ -1686,6 +1703,7 @@ GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES(GLenum target, GLeglImageOE
             texData->sourceEGLImage = imagehndl;
             texData->eglImageDetach = s_eglIface->eglDetachEGLImage;
             texData->oldGlobal = oldGlobal;
+            texData->etc1Levels.clear();
         }
     }
 }
@@ -1973,6 +1991,7 @@ GL_API void GLAPIENTRY glFramebufferTexture2DOES(GLenum target, GLenum attachmen
         }
         ObjectLocalName texname = TextureLocalName(textarget,texture);
         globalTexName = ctx->shareGroup()->getGlobalName(TEXTURE,texname);
+        decodeEtc1Levels(ctx, getTextureData(texname), globalTexName);
     }
 
     ctx->dispatcher().glFramebufferTexture2DEXT(target,attachment,textarget,globalTexName,level);
@@ -2074,6 +2093,7 @@ GL_API void GL_APIENTRY glGenerateMipmapOES(GLenum target) {
     GET_CTX()
     SET_ERROR_IF(!ctx->getCaps()->GL_EXT_FRAMEBUFFER_OBJECT,GL_INVALID_OPERATION);
     SET_ERROR_IF(!GLEScmValidate::textureTargetLimited(target),GL_INVALID_ENUM);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glGenerateMipmapEXT(target);
 }
 
@@ -171,6 +171,14 @@ static TextureData* getTextureTargetData(GLenum target){
     return getTextureData(TextureLocalName(target,tex));
 }
 
+// Decode the levels of the texture bound to |target| that the host still
+// stores as ETC1 data, before the texture is modified.
+static void decodeTextureTargetEtc1Levels(GLEScontext* ctx, GLenum target){
+    if (ctx->shareGroup().Ptr()) {
+        decodeEtc1Levels(ctx, getTextureTargetData(target), 0);
+    }
+}
+
 GL_APICALL void  GL_APIENTRY glActiveTexture(GLenum texture){
     GET_CTX_V2();
     SET_ERROR_IF (!GLESv2Validate::textureEnum(texture,ctx->getMaxTexUnits()),GL_INVALID_ENUM);
@@ -413,6 +421,7 @@ GL_APICALL void  GL_APIENTRY glCompressedTexImage2D(GLenum target, GLint level,
 GL_APICALL void  GL_APIENTRY glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data){
     GET_CTX();
     SET_ERROR_IF(!GLESv2Validate::textureTargetEx(target),GL_INVALID_ENUM);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glCompressedTexSubImage2D(target,level,xoffset,yoffset,width,height,format,imageSize,data);
 }
 
@@ -421,12 +430,14 @@ GL_APICALL void  GL_APIENTRY glCopyTexImage2D(GLenum target, GLint level, GLenum
     SET_ERROR_IF(!(GLESv2Validate::pixelFrmt(ctx,internalformat) && GLESv2Validate::textureTargetEx(target)),GL_INVALID_ENUM);
     SET_ERROR_IF((GLESv2Validate::textureIsCubeMap(target) && width != height), GL_INVALID_VALUE);
     SET_ERROR_IF(border != 0,GL_INVALID_VALUE);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glCopyTexImage2D(target,level,internalformat,x,y,width,height,border);
 }
 
 GL_APICALL void  GL_APIENTRY glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height){
     GET_CTX();
     SET_ERROR_IF(!GLESv2Validate::textureTargetEx(target),GL_INVALID_ENUM);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glCopyTexSubImage2D(target,level,xoffset,yoffset,x,y,width,height);
 }
 
@@ -788,6 +799,7 @@ GL_APICALL void  GL_APIENTRY glFramebufferTexture2D(GLenum target, GLenum attach
         }
         ObjectLocalName texname = TextureLocalName(textarget,texture);
         globalTextureName = ctx->shareGroup()->getGlobalName(TEXTURE,texname);
+        decodeEtc1Levels(ctx, getTextureData(texname), globalTextureName);
     }
 
     ctx->dispatcher().glFramebufferTexture2DEXT(target,attachment,textarget,globalTextureName,level);
@@ -823,6 +835,7 @@ GL_APICALL void  GL_APIENTRY glGenBuffers(GLsizei n, GLuint* buffers){
 GL_APICALL void  GL_APIENTRY glGenerateMipmap(GLenum target){
     GET_CTX();
     SET_ERROR_IF(!GLESvalidate::textureTarget(target), GL_INVALID_ENUM);
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glGenerateMipmapEXT(target);
 }
 
@@ -1900,6 +1913,11 @@ GL_APICALL void  GL_APIENTRY glTexImage2D(GLenum target, GLint level, GLint inte
             texData->internalFormat = internalformat;
             texData->target = target;
 
+            // The host can't mix the other levels with this one if they
+            // are still stored as ETC1 data.
+            texData->etc1Levels.erase(level);
+            decodeEtc1Levels(ctx, texData, 0);
+
             if (texData->sourceEGLImage != 0) {
                 //
                 // This texture was a target of EGLImage,
@@ -1960,6 +1978,7 @@ GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint x
     if (type==GL_HALF_FLOAT_OES)
         type = GL_HALF_FLOAT_NV;
 
+    decodeTextureTargetEtc1Levels(ctx, target);
     ctx->dispatcher().glTexSubImage2D(target,level,xoffset,yoffset,width,height,format,type,pixels);
 
 }
@@ -2202,6 +2221,7 @@ GL_APICALL void GL_APIENTRY glEGLImageTargetTexture2DOES(GLenum target, GLeglIma
             texData->sourceEGLImage = imagehndl;
             texData->eglImageDetach = s_eglIface->eglDetachEGLImage;
             texData->oldGlobal = oldGlobal;
+            texData->etc1Levels.clear();
         }
     }
 }
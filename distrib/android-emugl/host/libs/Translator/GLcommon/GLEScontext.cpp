@@ -554,6 +554,12 @@ void GLEScontext::initCapsLocked(const GLubyte * extensionString)
     if (strstr(cstring,"GL_ARB_ES2_compatibility ")!=NULL)
         s_glSupport.GL_ARB_ES2_COMPATIBILITY = true;
 
+    if (strstr(cstring,"GL_ARB_ES3_compatibility ")!=NULL)
+        s_glSupport.GL_ARB_ES3_COMPATIBILITY = true;
+
+    if (strstr(cstring,"GL_OES_compressed_ETC1_RGB8_texture ")!=NULL)
+        s_glSupport.GL_OES_COMPRESSED_ETC1_RGB8_TEXTURE = true;
+
     if (strstr(cstring,"GL_OES_standard_derivatives ")!=NULL)
         s_glSupport.GL_OES_STANDARD_DERIVATIVES = true;
 
@@ -143,6 +143,16 @@ unsigned char* uncompressTexture(GLenum internalformat,GLenum& formatOut,GLsizei
 
     int maxIndices = (leftPixels < nPixels) ? leftPixels:nPixels;
 
+    //decoding the palette once, instead of once per pixel
+    unsigned char colors[256][4];
+    for(int i = 0; i < nColors; i++) {
+        Color c = paletteColor(palette,i*colorSizeBytes,internalformat);
+        colors[i][0] = c.red;
+        colors[i][1] = c.green;
+        colors[i][2] = c.blue;
+        colors[i][3] = c.alpha;
+    }
+
     //filling the pixels array
     for(int i =0 ; i < maxIndices ; i++) {
         int paletteIndex = 0;
@@ -155,14 +165,12 @@ unsigned char* uncompressTexture(GLenum internalformat,GLenum& formatOut,GLsizei
             paletteIndex = imageIndices[i];
         }
 
-        paletteIndex*=colorSizeBytes;
-        Color c = paletteColor(palette,paletteIndex,internalformat);
-
-        pixelsOut[indexOut] = c.red;
-        pixelsOut[indexOut+1] = c.green;
-        pixelsOut[indexOut+2] = c.blue;
+        const unsigned char* c = colors[paletteIndex];
+        pixelsOut[indexOut] = c[0];
+        pixelsOut[indexOut+1] = c[1];
+        pixelsOut[indexOut+2] = c[2];
         if(formatOut == GL_RGBA) {
-            pixelsOut[indexOut+3] = c.alpha;
+            pixelsOut[indexOut+3] = c[3];
         }
     }
     return pixelsOut;
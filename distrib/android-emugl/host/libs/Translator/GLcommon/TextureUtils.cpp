@@ -17,9 +17,263 @@
 #include <GLcommon/GLESmacros.h>
 #include <GLcommon/GLDispatch.h>
 #include <GLcommon/GLESvalidate.h>
+#include "emugl/common/condition_variable.h"
+#include "emugl/common/lazy_instance.h"
+#include "emugl/common/mutex.h"
+#include "emugl/common/thread.h"
 #include <stdio.h>
 #include <cmath>
 
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+namespace {
+
+// ETC1 images with at least that many pixels are decoded in parallel
+// stripes on the worker pool below. Smaller images are not worth the
+// synchronization overhead.
+const GLsizei kParallelDecodeMinPixels = 512 * 512;
+
+// A StripeTask is a piece of work that can be split into independent
+// stripes, identified by their index.
+class StripeTask {
+public:
+    virtual ~StripeTask() {}
+    virtual void runStripe(int stripe) = 0;
+};
+
+// A small pool of worker threads used to run StripeTask instances.
+// The calling thread participates in the work too, and run() only
+// returns once all stripes are completed. Calls to run() from different
+// render threads are serialized.
+class StripeWorkerPool {
+public:
+    enum { kNumWorkers = 3 };
+
+    StripeWorkerPool() : mTask(NULL), mCount(0), mNext(0), mDone(0) {
+        for (int n = 0; n < kNumWorkers; ++n) {
+            mWorkers[n] = new Worker(this);
+            mWorkers[n]->start();
+        }
+    }
+
+    int numThreads() const { return kNumWorkers + 1; }
+
+    void run(StripeTask* task, int count) {
+        emugl::Mutex::AutoLock runLock(mRunLock);
+
+        mLock.lock();
+        mTask = task;
+        mCount = count;
+        mNext = 0;
+        mDone = 0;
+        for (int n = 0; n < count - 1 && n < kNumWorkers; ++n) {
+            mWorkCond.signal();
+        }
+        mLock.unlock();
+
+        // Help the workers, then wait for the stripes they took.
+        doWork();
+
+        mLock.lock();
+        while (mDone < mCount) {
+            mDoneCond.wait(&mLock);
+        }
+        mTask = NULL;
+        mLock.unlock();
+    }
+
+private:
+    class Worker : public emugl::Thread {
+    public:
+        explicit Worker(StripeWorkerPool* pool) : Thread(), mPool(pool) {}
+
+        virtual intptr_t main() {
+            for (;;) {
+                mPool->mLock.lock();
+                while (!mPool->mTask || mPool->mNext >= mPool->mCount) {
+                    mPool->mWorkCond.wait(&mPool->mLock);
+                }
+                mPool->mLock.unlock();
+                mPool->doWork();
+            }
+            return 0;
+        }
+
+    private:
+        StripeWorkerPool* mPool;
+    };
+
+    // Run stripes from the current task until none are left.
+    void doWork() {
+        for (;;) {
+            mLock.lock();
+            if (!mTask || mNext >= mCount) {
+                mLock.unlock();
+                return;
+            }
+            StripeTask* task = mTask;
+            int stripe = mNext++;
+            mLock.unlock();
+
+            task->runStripe(stripe);
+
+            mLock.lock();
+            if (++mDone == mCount) {
+                mDoneCond.signal();
+            }
+            mLock.unlock();
+        }
+    }
+
+    emugl::Mutex mRunLock;
+    emugl::Mutex mLock;
+    emugl::ConditionVariable mWorkCond;
+    emugl::ConditionVariable mDoneCond;
+    StripeTask* mTask;
+    int mCount;
+    int mNext;
+    int mDone;
+    Worker* mWorkers[kNumWorkers];
+};
+
+emugl::LazyInstance<StripeWorkerPool> sStripeWorkerPool = LAZY_INSTANCE_INIT;
+
+// Decodes an ETC1 image as horizontal stripes whose height is a multiple
+// of the 4-pixel ETC1 block height, so each stripe maps to a contiguous
+// range of the compressed data.
+class Etc1DecodeTask : public StripeTask {
+public:
+    Etc1DecodeTask(const etc1_byte* in, etc1_byte* out,
+                   GLsizei width, GLsizei height, int stride,
+                   int numStripes) :
+            mIn(in), mOut(out), mWidth(width), mHeight(height),
+            mStride(stride), mResult(0) {
+        int blockRows = (height + 3) / 4;
+        mBlockRowsPerStripe = (blockRows + numStripes - 1) / numStripes;
+    }
+
+    int numStripes() const {
+        int blockRows = (mHeight + 3) / 4;
+        return (blockRows + mBlockRowsPerStripe - 1) / mBlockRowsPerStripe;
+    }
+
+    virtual void runStripe(int stripe) {
+        GLsizei y = stripe * mBlockRowsPerStripe * 4;
+        GLsizei h = mHeight - y;
+        if (h > mBlockRowsPerStripe * 4) {
+            h = mBlockRowsPerStripe * 4;
+        }
+        size_t blocksPerRow = (mWidth + 3) / 4;
+        const etc1_byte* in = mIn + (y / 4) * blocksPerRow *
+                                    ETC1_ENCODED_BLOCK_SIZE;
+        if (etc1_decode_image(in, mOut + y * mStride, mWidth, h, 3,
+                              mStride) != 0) {
+            mResult = -1;
+        }
+    }
+
+    int result() const { return mResult; }
+
+private:
+    const etc1_byte* mIn;
+    etc1_byte* mOut;
+    GLsizei mWidth;
+    GLsizei mHeight;
+    int mStride;
+    int mBlockRowsPerStripe;
+    int mResult;
+};
+
+// Decode an ETC1 image, using the worker pool for large images.
+int decodeEtc1Image(const etc1_byte* in, etc1_byte* out,
+                    GLsizei width, GLsizei height, int stride) {
+    if (width * height < kParallelDecodeMinPixels) {
+        return etc1_decode_image(in, out, width, height, 3, stride);
+    }
+    StripeWorkerPool* pool = sStripeWorkerPool.ptr();
+    Etc1DecodeTask task(in, out, width, height, stride, pool->numThreads());
+    pool->run(&task, task.numStripes());
+    return task.result();
+}
+
+// Return the data of the texture bound to |target|, or NULL if there is
+// none yet.
+TextureData* getBoundTextureData(GLEScontext* ctx, GLenum target) {
+    if (!ctx->shareGroup().Ptr()) {
+        return NULL;
+    }
+    unsigned int tex = ctx->getBindedTexture(target);
+    ObjectLocalName name = tex ? tex : ctx->getDefaultTextureName(target);
+    ObjectDataPtr objData = ctx->shareGroup()->getObjectData(TEXTURE, name);
+    return (TextureData*)objData.Ptr();
+}
+
+// Try to upload an ETC1 image directly to the host GL, if it supports
+// ETC1 or ETC2 (a superset of ETC1) compressed textures. Return true on
+// success, false if the caller should decode the image instead.
+//
+// The guest sees the level as GL_RGB, which is what is recorded in the
+// TextureData, along with a copy of the compressed data to decode it with
+// decodeEtc1Levels() if the texture is later modified in a way the host
+// can't do on compressed storage. Only plain 2D textures without automatic
+// mipmap generation are passed through.
+bool passThroughEtc1Image(GLEScontext* ctx, GLenum target, GLint level,
+                          GLsizei width, GLsizei height, GLint border,
+                          GLsizei imageSize, const GLvoid* data) {
+    GLenum hostFormat;
+    if (ctx->getCaps()->GL_OES_COMPRESSED_ETC1_RGB8_TEXTURE) {
+        hostFormat = GL_ETC1_RGB8_OES;
+    } else if (ctx->getCaps()->GL_ARB_ES3_COMPATIBILITY) {
+        hostFormat = GL_COMPRESSED_RGB8_ETC2;
+    } else {
+        return false;
+    }
+    if (target != GL_TEXTURE_2D || border != 0 || !data || imageSize == 0) {
+        return false;
+    }
+    // Textures bound to an EGLImage are left to glTexImage2D(), which
+    // detaches them first.
+    TextureData* texData = getBoundTextureData(ctx, target);
+    if (!texData || texData->requiresAutoMipmap ||
+        texData->sourceEGLImage != 0) {
+        return false;
+    }
+
+    // Errors left by previous calls must not be mistaken for a failure
+    // of the upload, but they still belong to the guest.
+    GLenum pendingError = ctx->dispatcher().glGetError();
+    while (ctx->dispatcher().glGetError() != GL_NO_ERROR) {}
+
+    ctx->dispatcher().glCompressedTexImage2D(target, level, hostFormat,
+                                             width, height, border,
+                                             imageSize, data);
+    bool ok = ctx->dispatcher().glGetError() == GL_NO_ERROR;
+
+    if (pendingError != GL_NO_ERROR && ctx->getGLerror() == GL_NO_ERROR) {
+        ctx->setGLerror(pendingError);
+    }
+    if (!ok) {
+        return false;
+    }
+
+    texData->width = width;
+    texData->height = height;
+    texData->border = border;
+    texData->internalFormat = GL_RGB;
+    texData->target = target;
+
+    Etc1Level& etc1Level = texData->etc1Levels[level];
+    etc1Level.width = width;
+    etc1Level.height = height;
+    etc1Level.data.assign((const unsigned char*)data,
+                          (const unsigned char*)data + imageSize);
+    return true;
+}
+
+}  // namespace
+
 int getCompressedFormats(int* formats){
     if(formats){
         //Palette
@@ -57,14 +311,19 @@ void  doCompressedTexImage2D(GLEScontext * ctx, GLenum target, GLint level,
                 GLint type = GL_UNSIGNED_BYTE;
 
                 GLsizei compressedSize = etc1_get_encoded_data_size(width, height);
-                SET_ERROR_IF((compressedSize > imageSize), GL_INVALID_VALUE);
+                SET_ERROR_IF((compressedSize != imageSize), GL_INVALID_VALUE);
+
+                if (passThroughEtc1Image(ctx, target, level, width, height,
+                                         border, imageSize, data)) {
+                    break;
+                }
 
                 const int32_t align = ctx->getUnpackAlignment()-1;
                 const int32_t bpr = ((width * 3) + align) & ~align;
                 const size_t size = bpr * height;
 
                 etc1_byte* pOut = new etc1_byte[size];
-                int res = etc1_decode_image((const etc1_byte*)data, pOut, width, height, 3, bpr);
+                int res = decodeEtc1Image((const etc1_byte*)data, pOut, width, height, bpr);
                 SET_ERROR_IF(res!=0, GL_INVALID_VALUE);
                 glTexImage2DPtr(target,level,format,width,height,border,format,type,pOut);
                 delete [] pOut;
@@ -107,3 +366,35 @@ void  doCompressedTexImage2D(GLEScontext * ctx, GLenum target, GLint level,
             break;
     }
 }
+
+void decodeEtc1Levels(GLEScontext* ctx, TextureData* texData,
+                      GLuint globalTexName) {
+    if (!texData || texData->etc1Levels.empty()) {
+        return;
+    }
+
+    GLint prevTexName = 0;
+    if (globalTexName) {
+        ctx->dispatcher().glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTexName);
+        ctx->dispatcher().glBindTexture(GL_TEXTURE_2D, globalTexName);
+    }
+
+    const int32_t align = ctx->getUnpackAlignment()-1;
+    for (Etc1LevelMap::const_iterator it = texData->etc1Levels.begin();
+         it != texData->etc1Levels.end(); ++it) {
+        const Etc1Level& etc1Level = it->second;
+        const int32_t bpr = ((etc1Level.width * 3) + align) & ~align;
+        etc1_byte* pOut = new etc1_byte[bpr * etc1Level.height];
+        decodeEtc1Image(&etc1Level.data[0], pOut, etc1Level.width,
+                        etc1Level.height, bpr);
+        ctx->dispatcher().glTexImage2D(GL_TEXTURE_2D, it->first, GL_RGB,
+                                       etc1Level.width, etc1Level.height, 0,
+                                       GL_RGB, GL_UNSIGNED_BYTE, pOut);
+        delete [] pOut;
+    }
+    texData->etc1Levels.clear();
+
+    if (globalTexName) {
+        ctx->dispatcher().glBindTexture(GL_TEXTURE_2D, prevTexName);
+    }
+}
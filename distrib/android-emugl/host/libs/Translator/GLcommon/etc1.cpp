@@ -166,6 +166,15 @@ inline int convertDiff(int base, int diff) {
 static
 void decode_subblock(etc1_byte* pOut, int r, int g, int b, const int* table,
         etc1_uint32 low, bool second, bool flipped) {
+    // There are only four possible output colors per sub-block, compute
+    // and clamp them once, then each pixel is a simple 3-byte copy.
+    etc1_byte colors[4][3];
+    for (int i = 0; i < 4; i++) {
+        int delta = table[i];
+        colors[i][0] = clamp(r + delta);
+        colors[i][1] = clamp(g + delta);
+        colors[i][2] = clamp(b + delta);
+    }
     int baseX = 0;
     int baseY = 0;
     if (second) {
@@ -186,11 +195,11 @@ void decode_subblock(etc1_byte* pOut, int r, int g, int b, const int* table,
         }
         int k = y + (x * 4);
         int offset = ((low >> k) & 1) | ((low >> (k + 15)) & 2);
-        int delta = table[offset];
+        const etc1_byte* c = colors[offset];
         etc1_byte* q = pOut + 3 * (x + 4 * y);
-        *q++ = clamp(r + delta);
-        *q++ = clamp(g + delta);
-        *q++ = clamp(b + delta);
+        q[0] = c[0];
+        q[1] = c[1];
+        q[2] = c[2];
     }
 }
 
@@ -26,6 +26,11 @@ NameSpace::NameSpace(NamedObjectType p_type,
 
 NameSpace::~NameSpace()
 {
+    for (ObjectLocalName n = m_denseLocalToGlobal.nextKey(0);
+         n < emugl::DenseNameTable::kMaxKey;
+         n = m_denseLocalToGlobal.nextKey(n + 1)) {
+        m_globalNameSpace->deleteName(m_type, m_denseLocalToGlobal.get(n));
+    }
     for (NamesMap::iterator n = m_localToGlobalMap.begin();
          n != m_localToGlobalMap.end();
          n++) {
@@ -33,6 +38,49 @@ NameSpace::~NameSpace()
     }
 }
 
+void
+NameSpace::setGlobalName(ObjectLocalName p_localName,
+                         unsigned int p_globalName)
+{
+    removeGlobalName(p_localName);
+    if (!p_globalName) {
+        // A zero global name (e.g. SHADER objects, or a failed glGen*()),
+        // still needs an entry in the sparse map for isObject() to work.
+        m_localToGlobalMap[p_localName] = 0;
+        return;
+    }
+    if (!m_denseLocalToGlobal.set(p_localName, p_globalName)) {
+        m_localToGlobalMap[p_localName] = p_globalName;
+    }
+    m_globalToLocalMap.insert(
+            std::pair<unsigned int, ObjectLocalName>(p_globalName,
+                                                     p_localName));
+}
+
+unsigned int
+NameSpace::removeGlobalName(ObjectLocalName p_localName)
+{
+    unsigned int globalName = m_denseLocalToGlobal.remove(p_localName);
+    if (!globalName) {
+        NamesMap::iterator n( m_localToGlobalMap.find(p_localName) );
+        if (n == m_localToGlobalMap.end()) {
+            return 0;
+        }
+        globalName = (*n).second;
+        m_localToGlobalMap.erase(n);
+    }
+
+    std::pair<GlobalNamesMap::iterator, GlobalNamesMap::iterator> range =
+            m_globalToLocalMap.equal_range(globalName);
+    for (GlobalNamesMap::iterator it = range.first; it != range.second; ++it) {
+        if ((*it).second == p_localName) {
+            m_globalToLocalMap.erase(it);
+            break;
+        }
+    }
+    return globalName;
+}
+
 ObjectLocalName
 NameSpace::genName(ObjectLocalName p_localName,
                    bool genGlobal, bool genLocal)
@@ -41,14 +89,12 @@ NameSpace::genName(ObjectLocalName p_localName,
     if (genLocal) {
         do {
             localName = ++m_nextName;
-        } while(localName == 0 ||
-                m_localToGlobalMap.find(localName) !=
-                        m_localToGlobalMap.end() );
+        } while(localName == 0 || isObject(localName));
     }
 
     if (genGlobal) {
         unsigned int globalName = m_globalNameSpace->genName(m_type);
-        m_localToGlobalMap[localName] = globalName;
+        setGlobalName(localName, globalName);
     }
 
     return localName;
@@ -64,6 +110,11 @@ NameSpace::genGlobalName(void)
 unsigned int
 NameSpace::getGlobalName(ObjectLocalName p_localName)
 {
+    unsigned int globalName = m_denseLocalToGlobal.get(p_localName);
+    if (globalName || isDenseName(p_localName)) {
+        return globalName;
+    }
+
     NamesMap::iterator n( m_localToGlobalMap.find(p_localName) );
     if (n != m_localToGlobalMap.end()) {
         // object found - return its global name map
@@ -77,41 +128,72 @@ NameSpace::getGlobalName(ObjectLocalName p_localName)
 ObjectLocalName
 NameSpace::getLocalName(unsigned int p_globalName)
 {
-    for(NamesMap::iterator it = m_localToGlobalMap.begin(); it != m_localToGlobalMap.end();it++){
-        if((*it).second == p_globalName){
-            // object found - return its local name
-            return (*it).first;
+    // Several local names can share the same global name (see
+    // replaceGlobalName()), return the smallest one.
+    std::pair<GlobalNamesMap::iterator, GlobalNamesMap::iterator> range =
+            m_globalToLocalMap.equal_range(p_globalName);
+    ObjectLocalName localName = 0;
+    for (GlobalNamesMap::iterator it = range.first; it != range.second; ++it) {
+        if (!localName || (*it).second < localName) {
+            localName = (*it).second;
         }
     }
 
-    // object does not exist;
-    return 0;
+    // returns 0 if the object does not exist.
+    return localName;
 }
 
 void
 NameSpace::deleteName(ObjectLocalName p_localName)
 {
-    NamesMap::iterator n( m_localToGlobalMap.find(p_localName) );
-    if (n != m_localToGlobalMap.end()) {
-        m_globalNameSpace->deleteName(m_type, (*n).second);
-        m_localToGlobalMap.erase(p_localName);
+    if (!isObject(p_localName)) {
+        return;
     }
+    unsigned int globalName = removeGlobalName(p_localName);
+    m_globalNameSpace->deleteName(m_type, globalName);
 }
 
 bool
 NameSpace::isObject(ObjectLocalName p_localName)
 {
+    if (m_denseLocalToGlobal.contains(p_localName)) {
+        return true;
+    }
     return (m_localToGlobalMap.find(p_localName) != m_localToGlobalMap.end() );
 }
 
 void
 NameSpace::replaceGlobalName(ObjectLocalName p_localName, unsigned int p_globalName)
 {
-    NamesMap::iterator n( m_localToGlobalMap.find(p_localName) );
-    if (n != m_localToGlobalMap.end()) {
-        m_globalNameSpace->deleteName(m_type, (*n).second);
-        (*n).second = p_globalName;
+    if (!isObject(p_localName)) {
+        return;
     }
+    unsigned int oldGlobalName = getGlobalName(p_localName);
+
+    std::pair<GlobalNamesMap::iterator, GlobalNamesMap::iterator> range =
+            m_globalToLocalMap.equal_range(oldGlobalName);
+    for (GlobalNamesMap::iterator it = range.first; it != range.second; ++it) {
+        if ((*it).second == p_localName) {
+            m_globalToLocalMap.erase(it);
+            break;
+        }
+    }
+
+    // Overwrite the dense entry with a single store, instead of removing
+    // then adding it, so that lock-free readers in getGlobalName() never
+    // see 0 for a live object.
+    if (p_globalName && m_denseLocalToGlobal.set(p_localName, p_globalName)) {
+        m_localToGlobalMap.erase(p_localName);
+    } else {
+        m_denseLocalToGlobal.remove(p_localName);
+        m_localToGlobalMap[p_localName] = p_globalName;
+    }
+    if (p_globalName) {
+        m_globalToLocalMap.insert(
+                std::pair<unsigned int, ObjectLocalName>(p_globalName,
+                                                         p_localName));
+    }
+    m_globalNameSpace->deleteName(m_type, oldGlobalName);
 }
 
 
@@ -200,6 +282,12 @@ ShareGroup::getGlobalName(NamedObjectType p_type,
 {
     if (p_type >= NUM_OBJECT_TYPES) return 0;
 
+    // Lookups of dense names don't need the lock, this is called
+    // on every bind and draw.
+    if (NameSpace::isDenseName(p_localName)) {
+        return m_nameSpace[p_type]->m_denseLocalToGlobal.get(p_localName);
+    }
+
     emugl::Mutex::AutoLock _lock(m_lock);
     return m_nameSpace[p_type]->getGlobalName(p_localName);
 }
@@ -232,6 +320,10 @@ ShareGroup::isObject(NamedObjectType p_type, ObjectLocalName p_localName)
 {
     if (p_type >= NUM_OBJECT_TYPES) return 0;
 
+    if (m_nameSpace[p_type]->m_denseLocalToGlobal.contains(p_localName)) {
+        return true;
+    }
+
     emugl::Mutex::AutoLock _lock(m_lock);
     return m_nameSpace[p_type]->isObject(p_localName);
 }
@@ -20,6 +20,7 @@
 #include <GLES/glext.h>
 #include "GLEScontext.h"
 #include "PaletteTexture.h"
+#include "TranslatorIfaces.h"
 #include "etc1.h"
 
 int getCompressedFormats(int* formats);
@@ -28,4 +29,12 @@ void  doCompressedTexImage2D(GLEScontext * ctx, GLenum target, GLint level,
                                           GLsizei height, GLint border, 
                                           GLsizei imageSize, const GLvoid* data, void * funcPtr);
 
+// Replace the levels of a GL_TEXTURE_2D texture that are stored on the host
+// as compressed ETC1 data by decoded GL_RGB ones. This must be called
+// before the host texture is modified, rendered to or used to generate
+// mipmaps. |globalTexName| is the host name of the texture, or 0 for the
+// one currently bound to GL_TEXTURE_2D.
+void decodeEtc1Levels(GLEScontext* ctx, TextureData* texData,
+                      GLuint globalTexName);
+
 #endif
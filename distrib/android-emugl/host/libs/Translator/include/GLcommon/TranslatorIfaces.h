@@ -21,6 +21,9 @@
 #include <GLES/gl.h>
 #include <string.h>
 
+#include <map>
+#include <vector>
+
 extern "C" {
 
 /* This is a generic function pointer type, whose name indicates it must
@@ -33,6 +36,16 @@ typedef struct {
   __translatorMustCastToProperFunctionPointerType address;
 }ExtentionDescriptor;
 
+// A texture level stored on the host as compressed ETC1 data, while the
+// guest sees it as GL_RGB, see passThroughEtc1Image() in TextureUtils.cpp.
+struct Etc1Level {
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned char> data;
+};
+
+typedef std::map<GLint, Etc1Level> Etc1LevelMap;
+
 class TextureData : public ObjectData
 {
 public:
@@ -63,6 +76,7 @@ public:
     void (*eglImageDetach)(unsigned int imageId);
     GLenum target;
     GLuint oldGlobal;
+    Etc1LevelMap etc1Levels;
 };
 
 struct EglImage
@@ -17,6 +17,7 @@
 #define _OBJECT_NAME_MANAGER_H
 
 #include <map>
+#include "emugl/common/dense_name_table.h"
 #include "emugl/common/mutex.h"
 #include "emugl/common/smart_ptr.h"
 
@@ -50,6 +51,7 @@ private:
 typedef emugl::SmartPtr<ObjectData> ObjectDataPtr;
 typedef unsigned long long ObjectLocalName;
 typedef std::map<ObjectLocalName, unsigned int> NamesMap;
+typedef std::multimap<unsigned int, ObjectLocalName> GlobalNamesMap;
 
 //
 // Class NameSpace - this class manages allocations and deletions of objects
@@ -58,6 +60,12 @@ typedef std::map<ObjectLocalName, unsigned int> NamesMap;
 //                   generated as well to be used in the space where all
 //                   contexts are shared.
 //
+//   Small local names (the common case, since they are allocated
+//   sequentially by the guest) are kept in a dense table that can be read
+//   without holding the ShareGroup lock, see isDenseName(). Larger names
+//   are kept in a std::map. A reverse index maps global names back to
+//   local ones.
+//
 //   NOTE: this class does not used by the EGL/GLES layer directly,
 //         the EGL/GLES layer creates objects using the ShareGroup class
 //         interface (see below).
@@ -113,9 +121,23 @@ private:
     //
     void replaceGlobalName(ObjectLocalName p_localName, unsigned int p_globalName);
 
+    //
+    // isDenseName - returns true if getGlobalName() and isObject() can be
+    //               called for p_localName without holding the lock that
+    //               serializes modifications of this namespace.
+    //
+    static bool isDenseName(ObjectLocalName p_localName) {
+        return emugl::DenseNameTable::isDenseKey(p_localName);
+    }
+
+    void setGlobalName(ObjectLocalName p_localName, unsigned int p_globalName);
+    unsigned int removeGlobalName(ObjectLocalName p_localName);
+
 private:
     ObjectLocalName m_nextName;
+    emugl::DenseNameTable m_denseLocalToGlobal;
     NamesMap m_localToGlobalMap;
+    GlobalNamesMap m_globalToLocalMap;
     const NamedObjectType m_type;
     GlobalNameSpace *m_globalNameSpace;
 };
@@ -138,7 +160,9 @@ private:
 //   there will be one inctance of ShareGroup for each user OpenGL context
 //   unless the user context share with another user context. In that case they
 //   both will share the same ShareGroup instance.
-//   calls into that class gets serialized through a lock so it is thread safe.
+//   calls into that class gets serialized through a lock so it is thread safe,
+//   except for name lookups of small local names (getGlobalName/isObject),
+//   which are lock-free since they happen on every bind and draw call.
 //
 class ShareGroup
 {
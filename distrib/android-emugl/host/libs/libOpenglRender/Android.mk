@@ -27,6 +27,7 @@ host_common_SRC_FILES := \
     GLESv2Dispatch.cpp \
     ReadBuffer.cpp \
     RenderContext.cpp \
+    RenderContextPool.cpp \
     RenderControl.cpp \
     RenderServer.cpp \
     RenderThread.cpp \
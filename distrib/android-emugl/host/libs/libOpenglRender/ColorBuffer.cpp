@@ -23,6 +23,7 @@
 #include "TextureDraw.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 namespace {
 
@@ -127,23 +128,33 @@ ColorBuffer* ColorBuffer::create(EGLDisplay p_display,
     }
 
     ColorBuffer *cb = new ColorBuffer(p_display, helper);
-
-    s_gles2.glGenTextures(1, &cb->m_tex);
-    s_gles2.glBindTexture(GL_TEXTURE_2D, cb->m_tex);
+    cb->m_width = p_width;
+    cb->m_height = p_height;
+    cb->m_internalFormat = texInternalFormat;
+    cb->m_hasEglImageTexture2d = has_eglimage_texture_2d;
 
     int nComp = (texInternalFormat == GL_RGB ? 3 : 4);
 
     char* zBuff = static_cast<char*>(::calloc(nComp * p_width * p_height, 1));
+    cb->allocResources(zBuff);
+    ::free(zBuff);
+
+    return cb;
+}
+
+void ColorBuffer::allocResources(const void* pixels) {
+    s_gles2.glGenTextures(1, &m_tex);
+    s_gles2.glBindTexture(GL_TEXTURE_2D, m_tex);
+    s_gles2.glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     s_gles2.glTexImage2D(GL_TEXTURE_2D,
                          0,
-                         texInternalFormat,
-                         p_width,
-                         p_height,
+                         m_internalFormat,
+                         m_width,
+                         m_height,
                          0,
-                         texInternalFormat,
+                         m_internalFormat,
                          GL_UNSIGNED_BYTE,
-                         zBuff);
-    ::free(zBuff);
+                         pixels);
 
     s_gles2.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     s_gles2.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -153,15 +164,15 @@ ColorBuffer* ColorBuffer::create(EGLDisplay p_display,
     //
     // create another texture for that colorbuffer for blit
     //
-    s_gles2.glGenTextures(1, &cb->m_blitTex);
-    s_gles2.glBindTexture(GL_TEXTURE_2D, cb->m_blitTex);
+    s_gles2.glGenTextures(1, &m_blitTex);
+    s_gles2.glBindTexture(GL_TEXTURE_2D, m_blitTex);
     s_gles2.glTexImage2D(GL_TEXTURE_2D,
                          0,
-                         texInternalFormat,
-                         p_width,
-                         p_height,
+                         m_internalFormat,
+                         m_width,
+                         m_height,
                          0,
-                         texInternalFormat,
+                         m_internalFormat,
                          GL_UNSIGNED_BYTE,
                          NULL);
 
@@ -170,26 +181,42 @@ ColorBuffer* ColorBuffer::create(EGLDisplay p_display,
     s_gles2.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     s_gles2.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    cb->m_width = p_width;
-    cb->m_height = p_height;
-    cb->m_internalFormat = texInternalFormat;
-
-    if (has_eglimage_texture_2d) {
-        cb->m_eglImage = s_egl.eglCreateImageKHR(
-                p_display,
+    if (m_hasEglImageTexture2d) {
+        m_eglImage = s_egl.eglCreateImageKHR(
+                m_display,
                 s_egl.eglGetCurrentContext(),
                 EGL_GL_TEXTURE_2D_KHR,
-                (EGLClientBuffer)SafePointerFromUInt(cb->m_tex),
+                (EGLClientBuffer)SafePointerFromUInt(m_tex),
                 NULL);
 
-        cb->m_blitEGLImage = s_egl.eglCreateImageKHR(
-                p_display,
+        m_blitEGLImage = s_egl.eglCreateImageKHR(
+                m_display,
                 s_egl.eglGetCurrentContext(),
                 EGL_GL_TEXTURE_2D_KHR,
-                (EGLClientBuffer)SafePointerFromUInt(cb->m_blitTex),
+                (EGLClientBuffer)SafePointerFromUInt(m_blitTex),
                 NULL);
     }
-    return cb;
+}
+
+void ColorBuffer::freeResources() {
+    if (m_blitEGLImage) {
+        s_egl.eglDestroyImageKHR(m_display, m_blitEGLImage);
+        m_blitEGLImage = NULL;
+    }
+    if (m_eglImage) {
+        s_egl.eglDestroyImageKHR(m_display, m_eglImage);
+        m_eglImage = NULL;
+    }
+
+    if (m_fbo) {
+        s_gles2.glDeleteFramebuffers(1, &m_fbo);
+        m_fbo = 0;
+    }
+
+    GLuint tex[2] = {m_tex, m_blitTex};
+    s_gles2.glDeleteTextures(2, tex);
+    m_tex = 0;
+    m_blitTex = 0;
 }
 
 ColorBuffer::ColorBuffer(EGLDisplay display, Helper* helper) :
@@ -200,24 +227,70 @@ ColorBuffer::ColorBuffer(EGLDisplay display, Helper* helper) :
         m_fbo(0),
         m_internalFormat(0),
         m_display(display),
-        m_helper(helper) {}
+        m_helper(helper),
+        m_hasEglImageTexture2d(false),
+        m_hasEglImageSiblings(false),
+        m_evictedPixels(NULL) {}
 
 ColorBuffer::~ColorBuffer() {
+    if (m_evictedPixels) {
+        ::free(m_evictedPixels);
+        return;
+    }
+
     ScopedHelperContext context(m_helper);
+    freeResources();
+}
 
-    if (m_blitEGLImage) {
-        s_egl.eglDestroyImageKHR(m_display, m_blitEGLImage);
+size_t ColorBuffer::getTextureSize() const {
+    size_t nComp = (m_internalFormat == GL_RGB ? 3 : 4);
+    // Each instance uses two textures, see allocResources().
+    return 2 * nComp * m_width * m_height;
+}
+
+bool ColorBuffer::evict() {
+    if (m_evictedPixels || m_hasEglImageSiblings) {
+        return false;
     }
-    if (m_eglImage) {
-        s_egl.eglDestroyImageKHR(m_display, m_eglImage);
+
+    ScopedHelperContext context(m_helper);
+    if (!context.isOk()) {
+        return false;
     }
 
-    if (m_fbo) {
-        s_gles2.glDeleteFramebuffers(1, &m_fbo);
+    size_t nComp = (m_internalFormat == GL_RGB ? 3 : 4);
+    void* pixels = ::malloc(nComp * m_width * m_height);
+    if (!pixels) {
+        return false;
+    }
+    if (!bindFbo(&m_fbo, m_tex)) {
+        ::free(pixels);
+        return false;
     }
+    s_gles2.glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    s_gles2.glReadPixels(0, 0, m_width, m_height,
+                         m_internalFormat, GL_UNSIGNED_BYTE, pixels);
+    unbindFbo();
 
-    GLuint tex[2] = {m_tex, m_blitTex};
-    s_gles2.glDeleteTextures(2, tex);
+    freeResources();
+    m_evictedPixels = pixels;
+    return true;
+}
+
+bool ColorBuffer::restore() {
+    if (!m_evictedPixels) {
+        return true;
+    }
+
+    ScopedHelperContext context(m_helper);
+    if (!context.isOk()) {
+        return false;
+    }
+
+    allocResources(m_evictedPixels);
+    ::free(m_evictedPixels);
+    m_evictedPixels = NULL;
+    return true;
 }
 
 void ColorBuffer::readPixels(int x,
@@ -318,6 +391,7 @@ bool ColorBuffer::bindToTexture() {
     if (!m_eglImage) {
         return false;
     }
+    m_hasEglImageSiblings = true;
     RenderThreadInfo *tInfo = RenderThreadInfo::get();
     if (!tInfo->currContext.Ptr()) {
         return false;
@@ -335,6 +409,7 @@ bool ColorBuffer::bindToRenderbuffer() {
     if (!m_eglImage) {
         return false;
     }
+    m_hasEglImageSiblings = true;
     RenderThreadInfo *tInfo = RenderThreadInfo::get();
     if (!tInfo->currContext.Ptr()) {
         return false;
@@ -21,6 +21,8 @@
 #include <GLES/gl.h>
 #include "emugl/common/smart_ptr.h"
 
+#include <stddef.h>
+
 class TextureDraw;
 
 // A class used to model a guest color buffer, and used to implement several
@@ -133,11 +135,41 @@ public:
     // |img| must be a buffer large enough (i.e. width * height * 4).
     void readback(unsigned char* img);
 
+    // Return the number of bytes of host GPU memory used by this instance's
+    // textures when it is resident, i.e. not evicted.
+    size_t getTextureSize() const;
+
+    // Return true iff the instance can be evicted, i.e. it has never been
+    // bound to a guest texture or renderbuffer through its EGLImage. Such
+    // siblings would keep referencing the old GPU storage otherwise.
+    bool canEvict() const { return !m_hasEglImageSiblings; }
+
+    // Return true iff the instance's content currently lives in host memory.
+    bool isEvicted() const { return m_evictedPixels != NULL; }
+
+    // Copy the content of this instance to host memory, then release its
+    // GPU textures. Returns true on success, false if the instance cannot
+    // be evicted or on error.
+    bool evict();
+
+    // Re-create the GPU textures of an evicted instance from its host memory
+    // copy. Does nothing if the instance is not evicted. This must be called
+    // before any other operation on an evicted instance. Returns true on
+    // success, false otherwise.
+    bool restore();
+
 private:
     ColorBuffer();  // no default constructor.
 
     explicit ColorBuffer(EGLDisplay display, Helper* helper);
 
+    // Create the textures and EGLImages, with |pixels| as initial content.
+    // Requires a current context.
+    void allocResources(const void* pixels);
+
+    // Destroy the textures, EGLImages and FBO. Requires a current context.
+    void freeResources();
+
 private:
     GLuint m_tex;
     GLuint m_blitTex;
@@ -149,6 +181,9 @@ private:
     GLenum m_internalFormat;
     EGLDisplay m_display;
     Helper* m_helper;
+    bool m_hasEglImageTexture2d;
+    bool m_hasEglImageSiblings;
+    void* m_evictedPixels;
 };
 
 typedef emugl::SmartPtr<ColorBuffer> ColorBufferPtr;
@@ -23,7 +23,10 @@
 #include "RenderThreadInfo.h"
 #include "TimeUtils.h"
 
+#include <set>
+
 #include <stdio.h>
+#include <stdlib.h>
 
 namespace {
 
@@ -151,11 +154,16 @@ static char* getGLES1ExtensionString(EGLDisplay p_dpy)
 
 void FrameBuffer::finalize(){
     m_colorbuffers.clear();
+    m_threadColorBufferBytes.clear();
+    m_colorBufferResidentBytes = 0;
+    m_colorBufferEvictedBytes = 0;
     if (m_useSubWindow) {
         removeSubWindow();
     }
     m_windows.clear();
     m_contexts.clear();
+    delete m_contextPool;
+    m_contextPool = NULL;
     s_egl.eglMakeCurrent(m_eglDisplay, NULL, NULL, NULL);
     s_egl.eglDestroyContext(m_eglDisplay, m_eglContext);
     s_egl.eglDestroyContext(m_eglDisplay, m_pbufContext);
@@ -214,7 +222,8 @@ bool FrameBuffer::initialize(int width, int height, bool useSubWindow)
     //
     // Create EGL context for framebuffer post rendering.
     //
-    GLint surfaceType = (useSubWindow ? EGL_WINDOW_BIT : 0) | EGL_PBUFFER_BIT;
+    GLint surfaceType =
+            (fb->m_useSubWindow ? EGL_WINDOW_BIT : 0) | EGL_PBUFFER_BIT;
     const GLint configAttribs[] = {
         EGL_RED_SIZE, 1,
         EGL_GREEN_SIZE, 1,
@@ -407,6 +416,20 @@ bool FrameBuffer::initialize(int width, int height, bool useSubWindow)
     // release the FB context
     bind.release();
 
+    //
+    // Pre-create host contexts in the background, to reduce the latency
+    // of guest context creation. This is enabled by default in headless
+    // mode, where many instances can run on the same host.
+    //
+    size_t poolSize = fb->m_headless ? 2 : 0;
+    const char* poolSizeEnv = getenv("ANDROID_EMUGL_CONTEXT_POOL_SIZE");
+    if (poolSizeEnv) {
+        poolSize = static_cast<size_t>(strtoul(poolSizeEnv, NULL, 10));
+    }
+    if (poolSize > 0) {
+        fb->m_contextPool = new RenderContextPool(fb->m_eglDisplay, poolSize);
+    }
+
     //
     // Keep the singleton framebuffer pointer
     //
@@ -418,9 +441,16 @@ FrameBuffer::FrameBuffer(int p_width, int p_height, bool useSubWindow) :
     m_width(p_width),
     m_height(p_height),
     m_useSubWindow(useSubWindow),
+    m_headless(false),
     m_configs(NULL),
     m_eglDisplay(EGL_NO_DISPLAY),
+    m_contextPool(NULL),
     m_colorBufferHelper(new ColorBufferHelper(this)),
+    m_colorBufferResidentBytes(0),
+    m_colorBufferEvictedBytes(0),
+    m_colorBufferLimit(0),
+    m_colorBufferUseCounter(0),
+    m_nextAccountingId(0),
     m_eglSurface(EGL_NO_SURFACE),
     m_eglContext(EGL_NO_CONTEXT),
     m_pbufContext(EGL_NO_CONTEXT),
@@ -442,9 +472,21 @@ FrameBuffer::FrameBuffer(int p_width, int p_height, bool useSubWindow) :
     m_glVersion(NULL)
 {
     m_fpsStats = getenv("SHOW_FPS_STATS") != NULL;
+
+    const char* headless = getenv("ANDROID_EMUGL_HEADLESS");
+    if (headless && headless[0] && headless[0] != '0') {
+        m_headless = true;
+        m_useSubWindow = false;
+    }
+
+    const char* limitMb = getenv("ANDROID_EMUGL_COLORBUFFER_LIMIT_MB");
+    if (limitMb) {
+        m_colorBufferLimit = strtoull(limitMb, NULL, 10) * 1024 * 1024;
+    }
 }
 
 FrameBuffer::~FrameBuffer() {
+    delete m_contextPool;
     delete m_textureDraw;
     delete m_configs;
     delete m_colorBufferHelper;
@@ -571,12 +613,152 @@ HandleType FrameBuffer::createColorBuffer(int p_width, int p_height,
             m_colorBufferHelper));
     if (cb.Ptr() != NULL) {
         ret = genHandle();
-        m_colorbuffers[ret].cb = cb;
-        m_colorbuffers[ret].refcount = 1;
+
+        uint32_t ownerId = 0;
+        RenderThreadInfo *tinfo = RenderThreadInfo::get();
+        if (tinfo) {
+            if (!tinfo->m_accountingId) {
+                tinfo->m_accountingId = ++m_nextAccountingId;
+            }
+            ownerId = tinfo->m_accountingId;
+        }
+
+        ColorBufferRef& ref = m_colorbuffers[ret];
+        ref.cb = cb;
+        ref.refcount = 1;
+        ref.ownerId = ownerId;
+        ref.lastUse = ++m_colorBufferUseCounter;
+
+        size_t size = cb->getTextureSize();
+        m_colorBufferResidentBytes += size;
+        m_threadColorBufferBytes[ownerId] += size;
+
+        evictColorBuffers_locked(ret);
     }
     return ret;
 }
 
+void FrameBuffer::eraseColorBuffer_locked(ColorBufferMap::iterator c)
+{
+    const ColorBufferRef& ref = (*c).second;
+    size_t size = ref.cb->getTextureSize();
+    if (ref.cb->isEvicted()) {
+        m_colorBufferEvictedBytes -= size;
+    } else {
+        m_colorBufferResidentBytes -= size;
+    }
+    std::map<uint32_t, uint64_t>::iterator t =
+            m_threadColorBufferBytes.find(ref.ownerId);
+    if (t != m_threadColorBufferBytes.end()) {
+        (*t).second -= size;
+        if (!(*t).second) {
+            m_threadColorBufferBytes.erase(t);
+        }
+    }
+    m_colorbuffers.erase(c);
+}
+
+bool FrameBuffer::touchColorBuffer_locked(ColorBufferMap::iterator c)
+{
+    ColorBufferRef& ref = (*c).second;
+    ref.lastUse = ++m_colorBufferUseCounter;
+    if (!ref.cb->isEvicted()) {
+        return true;
+    }
+    if (!ref.cb->restore()) {
+        ERR("FB: could not restore evicted color buffer %#x\n", (*c).first);
+        return false;
+    }
+    size_t size = ref.cb->getTextureSize();
+    m_colorBufferEvictedBytes -= size;
+    m_colorBufferResidentBytes += size;
+
+    evictColorBuffers_locked((*c).first);
+    return true;
+}
+
+void FrameBuffer::evictColorBuffers_locked(HandleType keep)
+{
+    if (!m_colorBufferLimit ||
+        m_colorBufferResidentBytes <= m_colorBufferLimit) {
+        return;
+    }
+
+    // ColorBuffers attached to a window surface are in active use.
+    std::set<HandleType> attached;
+    for (WindowSurfaceMap::iterator w = m_windows.begin();
+         w != m_windows.end(); ++w) {
+        attached.insert((*w).second.second);
+    }
+
+    while (m_colorBufferResidentBytes > m_colorBufferLimit) {
+        ColorBufferMap::iterator victim = m_colorbuffers.end();
+        for (ColorBufferMap::iterator c = m_colorbuffers.begin();
+             c != m_colorbuffers.end(); ++c) {
+            const ColorBufferRef& ref = (*c).second;
+            if ((*c).first == keep ||
+                (*c).first == m_lastPostedColorBuffer ||
+                ref.cb->isEvicted() || !ref.cb->canEvict() ||
+                attached.count((*c).first)) {
+                continue;
+            }
+            if (victim == m_colorbuffers.end() ||
+                ref.lastUse < (*victim).second.lastUse) {
+                victim = c;
+            }
+        }
+        if (victim == m_colorbuffers.end() ||
+            !(*victim).second.cb->evict()) {
+            break;
+        }
+        size_t size = (*victim).second.cb->getTextureSize();
+        m_colorBufferResidentBytes -= size;
+        m_colorBufferEvictedBytes += size;
+    }
+}
+
+void FrameBuffer::getColorBufferMemoryUsage(uint64_t* residentBytes,
+                                            uint64_t* evictedBytes,
+                                            uint64_t* maxThreadBytes)
+{
+    emugl::Mutex::AutoLock mutex(m_lock);
+    uint64_t maxBytes = 0;
+    for (std::map<uint32_t, uint64_t>::const_iterator t =
+                 m_threadColorBufferBytes.begin();
+         t != m_threadColorBufferBytes.end(); ++t) {
+        if ((*t).second > maxBytes) {
+            maxBytes = (*t).second;
+        }
+    }
+    *residentBytes = m_colorBufferResidentBytes;
+    *evictedBytes = m_colorBufferEvictedBytes;
+    *maxThreadBytes = maxBytes;
+}
+
+int FrameBuffer::getColorBufferThreadMemoryUsage(uint32_t* threadIds,
+                                                 uint64_t* threadBytes,
+                                                 int maxThreads)
+{
+    emugl::Mutex::AutoLock mutex(m_lock);
+    int count = 0;
+    for (std::map<uint32_t, uint64_t>::const_iterator t =
+                 m_threadColorBufferBytes.begin();
+         t != m_threadColorBufferBytes.end(); ++t, ++count) {
+        if (count < maxThreads) {
+            threadIds[count] = (*t).first;
+            threadBytes[count] = (*t).second;
+        }
+    }
+    return count;
+}
+
+void FrameBuffer::setColorBufferMemoryLimit(uint64_t maxBytes)
+{
+    emugl::Mutex::AutoLock mutex(m_lock);
+    m_colorBufferLimit = maxBytes;
+    evictColorBuffers_locked(0);
+}
+
 HandleType FrameBuffer::createRenderContext(int p_config, HandleType p_share,
                                             bool p_isGL2)
 {
@@ -599,8 +781,15 @@ HandleType FrameBuffer::createRenderContext(int p_config, HandleType p_share,
     EGLContext sharedContext =
             share.Ptr() ? share->getEGLContext() : EGL_NO_CONTEXT;
 
-    RenderContextPtr rctx(RenderContext::create(
-        m_eglDisplay, config->getEglConfig(), sharedContext, p_isGL2));
+    RenderContext* context = NULL;
+    if (m_contextPool && sharedContext == EGL_NO_CONTEXT) {
+        context = m_contextPool->take(config->getEglConfig(), p_isGL2);
+    }
+    if (!context) {
+        context = RenderContext::create(
+                m_eglDisplay, config->getEglConfig(), sharedContext, p_isGL2);
+    }
+    RenderContextPtr rctx(context);
     if (rctx.Ptr() != NULL) {
         ret = genHandle();
         m_contexts[ret] = rctx;
@@ -659,7 +848,7 @@ void FrameBuffer::drainWindowSurface()
             if (oldColorBufferHandle) {
                 ColorBufferMap::iterator cit(m_colorbuffers.find(oldColorBufferHandle));
                 if (cit != m_colorbuffers.end()) {
-                    if (--(*cit).second.refcount == 0) { m_colorbuffers.erase(cit); }
+                    if (--(*cit).second.refcount == 0) { eraseColorBuffer_locked(cit); }
                 }
             }
             m_windows.erase(windowHandle);
@@ -713,7 +902,7 @@ void FrameBuffer::closeColorBuffer(HandleType p_colorbuffer)
         return;
     }
     if (--(*c).second.refcount == 0) {
-        m_colorbuffers.erase(c);
+        eraseColorBuffer_locked(c);
     }
 }
 
@@ -752,6 +941,9 @@ bool FrameBuffer::setWindowSurfaceColorBuffer(HandleType p_surface,
         // bad colorbuffer handle
         return false;
     }
+    if (!touchColorBuffer_locked(c)) {
+        return false;
+    }
 
     (*w).second.first->setColorBuffer((*c).second.cb);
     (*w).second.second = p_colorbuffer;
@@ -765,7 +957,7 @@ void FrameBuffer::readColorBuffer(HandleType p_colorbuffer,
     emugl::Mutex::AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c( m_colorbuffers.find(p_colorbuffer) );
-    if (c == m_colorbuffers.end()) {
+    if (c == m_colorbuffers.end() || !touchColorBuffer_locked(c)) {
         // bad colorbuffer handle
         return;
     }
@@ -780,7 +972,7 @@ bool FrameBuffer::updateColorBuffer(HandleType p_colorbuffer,
     emugl::Mutex::AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c( m_colorbuffers.find(p_colorbuffer) );
-    if (c == m_colorbuffers.end()) {
+    if (c == m_colorbuffers.end() || !touchColorBuffer_locked(c)) {
         // bad colorbuffer handle
         return false;
     }
@@ -795,7 +987,7 @@ bool FrameBuffer::bindColorBufferToTexture(HandleType p_colorbuffer)
     emugl::Mutex::AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c( m_colorbuffers.find(p_colorbuffer) );
-    if (c == m_colorbuffers.end()) {
+    if (c == m_colorbuffers.end() || !touchColorBuffer_locked(c)) {
         // bad colorbuffer handle
         return false;
     }
@@ -808,7 +1000,7 @@ bool FrameBuffer::bindColorBufferToRenderbuffer(HandleType p_colorbuffer)
     emugl::Mutex::AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c( m_colorbuffers.find(p_colorbuffer) );
-    if (c == m_colorbuffers.end()) {
+    if (c == m_colorbuffers.end() || !touchColorBuffer_locked(c)) {
         // bad colorbuffer handle
         return false;
     }
@@ -972,7 +1164,7 @@ bool FrameBuffer::post(HandleType p_colorbuffer, bool needLock)
     bool ret = false;
 
     ColorBufferMap::iterator c( m_colorbuffers.find(p_colorbuffer) );
-    if (c == m_colorbuffers.end()) {
+    if (c == m_colorbuffers.end() || !touchColorBuffer_locked(c)) {
         goto EXIT;
     }
 
@@ -20,6 +20,7 @@
 #include "emugl/common/mutex.h"
 #include "FbConfig.h"
 #include "RenderContext.h"
+#include "RenderContextPool.h"
 #include "render_api.h"
 #include "TextureDraw.h"
 #include "WindowSurface.h"
@@ -37,6 +38,8 @@ typedef uint32_t HandleType;
 struct ColorBufferRef {
     ColorBufferPtr cb;
     uint32_t refcount;  // number of client-side references
+    uint32_t ownerId;   // accounting id of the creating RenderThread
+    uint64_t lastUse;   // value of FrameBuffer's use counter on last access
 };
 typedef std::map<HandleType, RenderContextPtr> RenderContextMap;
 typedef std::map<HandleType, std::pair<WindowSurfacePtr, HandleType> > WindowSurfaceMap;
@@ -72,6 +75,13 @@ public:
     // will use setupSubWindow() to let EmuGL display the GPU content in its
     // own sub-windows. If false, this means the caller will use
     // setPostCallback() instead to retrieve the content.
+    //
+    // If the ANDROID_EMUGL_HEADLESS environment variable is defined, the
+    // instance runs in headless mode: the EGL translator uses a host
+    // engine that doesn't need a windowing system, |useSubWindow| is
+    // ignored, and all rendering goes to Pbuffers, with frames only
+    // delivered through setPostCallback(). Headless instances also keep
+    // a pool of pre-created host contexts, see RenderContextPool.
     // Returns true on success, false otherwise.
     static bool initialize(int width, int height, bool useSubWindow);
 
@@ -104,6 +114,9 @@ public:
     // Return the capabilities of the underlying display.
     const FrameBufferCaps &getCaps() const { return m_caps; }
 
+    // Return true iff this instance runs in headless mode.
+    bool isHeadless() const { return m_headless; }
+
     // Return the emulated GPU display width in pixels.
     int getWidth() const { return m_width; }
 
@@ -270,6 +283,34 @@ public:
     // and windows created by this instance.
     TextureDraw* getTextureDraw() const { return m_textureDraw; }
 
+    // Retrieve ColorBuffer memory usage statistics. On return,
+    // |*residentBytes| is the number of bytes of host GPU memory used by
+    // ColorBuffer textures, |*evictedBytes| the number of bytes of
+    // ColorBuffer content currently evicted to host memory, and
+    // |*maxThreadBytes| the total size of the ColorBuffers created by the
+    // RenderThread that created the most.
+    void getColorBufferMemoryUsage(uint64_t* residentBytes,
+                                   uint64_t* evictedBytes,
+                                   uint64_t* maxThreadBytes);
+
+    // Retrieve the total size of the ColorBuffers created by each
+    // RenderThread. Fills |threadIds| and |threadBytes| for at most
+    // |maxThreads| threads, in increasing id order, and returns the number
+    // of threads owning ColorBuffers, which can be larger than |maxThreads|.
+    // Id 0 stands for ColorBuffers created outside of a RenderThread.
+    int getColorBufferThreadMemoryUsage(uint32_t* threadIds,
+                                        uint64_t* threadBytes,
+                                        int maxThreads);
+
+    // Set the maximum number of bytes of host GPU memory that ColorBuffers
+    // can use before the least recently used ones are evicted to host
+    // memory. Only ColorBuffers that are not attached to a window surface,
+    // not currently displayed, and never bound to a guest texture or
+    // renderbuffer can be evicted. They are restored transparently on next
+    // use. 0 means no limit, which is the default unless the
+    // ANDROID_EMUGL_COLORBUFFER_LIMIT_MB environment variable is defined.
+    void setColorBufferMemoryLimit(uint64_t maxBytes);
+
     // Used internally.
     bool bind_locked();
     bool unbind_locked();
@@ -281,6 +322,18 @@ private:
 
     bool bindSubwin_locked();
 
+    // Destroy the ColorBuffer at |c| and update memory accounting.
+    void eraseColorBuffer_locked(ColorBufferMap::iterator c);
+
+    // Restore the ColorBuffer at |c| if it was evicted and mark it as
+    // recently used. Returns false if it could not be restored.
+    bool touchColorBuffer_locked(ColorBufferMap::iterator c);
+
+    // Evict least recently used ColorBuffers until the resident size is
+    // below the configured limit. |keep| is a handle that must not be
+    // evicted. Must be called without a bound context.
+    void evictColorBuffers_locked(HandleType keep);
+
 private:
     static FrameBuffer *s_theFrameBuffer;
     static HandleType s_nextHandle;
@@ -289,16 +342,26 @@ private:
     int m_width;
     int m_height;
     bool m_useSubWindow;
+    bool m_headless;
     emugl::Mutex m_lock;
     FbConfigList* m_configs;
     FBNativeWindowType m_nativeWindow;
     FrameBufferCaps m_caps;
     EGLDisplay m_eglDisplay;
     RenderContextMap m_contexts;
+    RenderContextPool* m_contextPool;
     WindowSurfaceMap m_windows;
     ColorBufferMap m_colorbuffers;
     ColorBuffer::Helper* m_colorBufferHelper;
 
+    // ColorBuffer memory accounting, see getColorBufferMemoryUsage().
+    uint64_t m_colorBufferResidentBytes;
+    uint64_t m_colorBufferEvictedBytes;
+    uint64_t m_colorBufferLimit;
+    uint64_t m_colorBufferUseCounter;
+    uint32_t m_nextAccountingId;
+    std::map<uint32_t, uint64_t> m_threadColorBufferBytes;
+
     EGLSurface m_eglSurface;
     EGLContext m_eglContext;
     EGLSurface m_pbufSurface;
@@ -0,0 +1,130 @@
+/*
+* Copyright (C) 2015 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "RenderContextPool.h"
+
+#include "EGLDispatch.h"
+
+#include "emugl/common/thread.h"
+
+class RenderContextPoolThread : public emugl::Thread {
+public:
+    explicit RenderContextPoolThread(RenderContextPool* pool) :
+            Thread(), mPool(pool) {}
+
+    virtual intptr_t main() {
+        mPool->refillLoop();
+        // Release the per-thread state of the EGL library.
+        s_egl.eglReleaseThread();
+        return 0;
+    }
+
+private:
+    RenderContextPool* mPool;
+};
+
+RenderContextPool::RenderContextPool(EGLDisplay display, size_t targetSize) :
+        mDisplay(display),
+        mTargetSize(targetSize),
+        mLock(),
+        mCondition(),
+        mContexts(),
+        mRefillNeeded(false),
+        mExiting(false),
+        mThread(NULL) {
+    mThread = new RenderContextPoolThread(this);
+    if (!mThread->start()) {
+        delete mThread;
+        mThread = NULL;
+    }
+}
+
+RenderContextPool::~RenderContextPool() {
+    if (mThread) {
+        mLock.lock();
+        mExiting = true;
+        mCondition.signal();
+        mLock.unlock();
+        mThread->wait(NULL);
+        delete mThread;
+    }
+    for (ContextListMap::iterator it = mContexts.begin();
+         it != mContexts.end(); ++it) {
+        ContextList& list = it->second;
+        for (size_t n = 0; n < list.size(); ++n) {
+            delete list[n];
+        }
+    }
+}
+
+RenderContext* RenderContextPool::take(EGLConfig config, bool isGl2) {
+    if (!mThread) {
+        return NULL;
+    }
+    Key key;
+    key.config = config;
+    key.isGl2 = isGl2;
+
+    emugl::Mutex::AutoLock lock(mLock);
+    // NOTE: This creates an empty list for new keys, which is how the
+    // refill thread knows what to create.
+    ContextList& list = mContexts[key];
+    RenderContext* result = NULL;
+    if (!list.empty()) {
+        result = list.back();
+        list.pop_back();
+    }
+    mRefillNeeded = true;
+    mCondition.signal();
+    return result;
+}
+
+void RenderContextPool::refillLoop() {
+    mLock.lock();
+    for (;;) {
+        while (!mRefillNeeded && !mExiting) {
+            mCondition.wait(&mLock);
+        }
+        if (mExiting) {
+            break;
+        }
+        mRefillNeeded = false;
+
+        // Find one key that needs a new context, then create it without
+        // holding the lock, since this can be slow.
+        bool refilled = true;
+        while (refilled && !mExiting) {
+            refilled = false;
+            for (ContextListMap::iterator it = mContexts.begin();
+                 it != mContexts.end(); ++it) {
+                if (it->second.size() >= mTargetSize) {
+                    continue;
+                }
+                Key key = it->first;
+                mLock.unlock();
+                RenderContext* context = RenderContext::create(
+                        mDisplay, key.config, EGL_NO_CONTEXT, key.isGl2);
+                mLock.lock();
+                if (context) {
+                    // NOTE: |it| may have been invalidated while unlocked.
+                    mContexts[key].push_back(context);
+                    refilled = true;
+                }
+                break;
+            }
+        }
+    }
+    mLock.unlock();
+}
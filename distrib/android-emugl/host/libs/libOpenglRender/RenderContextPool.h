@@ -0,0 +1,87 @@
+/*
+* Copyright (C) 2015 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef _LIBRENDER_RENDER_CONTEXT_POOL_H
+#define _LIBRENDER_RENDER_CONTEXT_POOL_H
+
+#include "RenderContext.h"
+
+#include "emugl/common/condition_variable.h"
+#include "emugl/common/mutex.h"
+
+#include <EGL/egl.h>
+
+#include <map>
+#include <vector>
+
+#include <stddef.h>
+
+class RenderContextPoolThread;
+
+// A class used to keep a small stock of pre-created, never-bound host
+// contexts, so that guest eglCreateContext() calls from new RenderThreads
+// don't have to wait for the host driver to create one.
+//
+// Only contexts that don't share with another one are pooled. A background
+// thread refills the pool for each (config, version) pair that was
+// requested at least once through take().
+class RenderContextPool {
+public:
+    // Create a new instance. |display| is the host EGLDisplay, and
+    // |targetSize| is the number of contexts to keep ready for each
+    // (config, version) pair.
+    RenderContextPool(EGLDisplay display, size_t targetSize);
+
+    // Destructor. Stops the refill thread and destroys all pooled contexts.
+    ~RenderContextPool();
+
+    // Return a new RenderContext for |config| and |isGl2|, taken from the
+    // pool, or NULL if none is ready, in which case the caller should
+    // create one itself. In both cases, the pool will be refilled
+    // asynchronously for this pair.
+    RenderContext* take(EGLConfig config, bool isGl2);
+
+private:
+    friend class RenderContextPoolThread;
+
+    struct Key {
+        EGLConfig config;
+        bool isGl2;
+
+        bool operator<(const Key& other) const {
+            if (config != other.config) {
+                return config < other.config;
+            }
+            return isGl2 < other.isGl2;
+        }
+    };
+
+    typedef std::vector<RenderContext*> ContextList;
+    typedef std::map<Key, ContextList> ContextListMap;
+
+    // Main loop of the refill thread.
+    void refillLoop();
+
+    EGLDisplay mDisplay;
+    size_t mTargetSize;
+    emugl::Mutex mLock;
+    emugl::ConditionVariable mCondition;
+    ContextListMap mContexts;
+    bool mRefillNeeded;
+    bool mExiting;
+    RenderContextPoolThread* mThread;
+};
+
+#endif  // _LIBRENDER_RENDER_CONTEXT_POOL_H
@@ -30,7 +30,7 @@ public:
 
 static ::emugl::LazyInstance<ThreadInfoStore> s_tls = LAZY_INSTANCE_INIT;
 
-RenderThreadInfo::RenderThreadInfo() {
+RenderThreadInfo::RenderThreadInfo() : m_accountingId(0) {
     s_tls->set(this);
 }
 
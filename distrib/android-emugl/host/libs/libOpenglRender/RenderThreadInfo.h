@@ -55,6 +55,10 @@ struct RenderThreadInfo {
     ThreadContextSet                m_contextSet;
     // all the window surfaces that are created by this render thread
     WindowSurfaceSet                m_windowSet;
+
+    // Identifier used by FrameBuffer to account for the resources created
+    // by this render thread. 0 until the thread creates its first resource.
+    uint32_t                        m_accountingId;
 };
 
 #endif
@@ -15,6 +15,7 @@
 */
 #include "render_api.h"
 
+#include "FrameBuffer.h"
 #include "IOStream.h"
 #include "RenderServer.h"
 #include "RenderWindow.h"
@@ -147,6 +148,40 @@ RENDER_APICALL void RENDER_APIENTRY getHardwareStrings(
     *vendor = *renderer = *version = NULL;
 }
 
+RENDER_APICALL void RENDER_APIENTRY getColorBufferMemoryUsage(
+        uint64_t* residentBytes,
+        uint64_t* evictedBytes,
+        uint64_t* maxThreadBytes) {
+    FrameBuffer* fb = FrameBuffer::getFB();
+    if (!fb) {
+        *residentBytes = *evictedBytes = *maxThreadBytes = 0;
+        return;
+    }
+    fb->getColorBufferMemoryUsage(residentBytes, evictedBytes, maxThreadBytes);
+}
+
+RENDER_APICALL int RENDER_APIENTRY getColorBufferThreadMemoryUsage(
+        uint32_t* threadIds,
+        uint64_t* threadBytes,
+        int maxThreads) {
+    FrameBuffer* fb = FrameBuffer::getFB();
+    if (!fb) {
+        return 0;
+    }
+    return fb->getColorBufferThreadMemoryUsage(threadIds, threadBytes,
+                                               maxThreads);
+}
+
+RENDER_APICALL void RENDER_APIENTRY setColorBufferMemoryLimit(
+        uint64_t maxBytes) {
+    FrameBuffer* fb = FrameBuffer::getFB();
+    if (!fb) {
+        ERR("Calling setColorBufferMemoryLimit() before starting renderer!");
+        return;
+    }
+    fb->setColorBufferMemoryLimit(maxBytes);
+}
+
 RENDER_APICALL int RENDER_APIENTRY stopOpenGLRenderer(void)
 {
     bool ret = false;
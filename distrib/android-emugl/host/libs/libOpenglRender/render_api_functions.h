@@ -21,6 +21,9 @@ typedef void (*OnPostFn)(void* context, int width, int height, int ydir,
   X(void, setOpenGLDisplayRotation, (float zRot)) \
   X(void, repaintOpenGLDisplay, ()) \
   X(int, stopOpenGLRenderer, ()) \
+  X(void, getColorBufferMemoryUsage, (uint64_t* residentBytes, uint64_t* evictedBytes, uint64_t* maxThreadBytes)) \
+  X(int, getColorBufferThreadMemoryUsage, (uint32_t* threadIds, uint64_t* threadBytes, int maxThreads)) \
+  X(void, setColorBufferMemoryLimit, (uint64_t maxBytes)) \
 
 
 #endif  // RENDER_API_FUNCTIONS_H
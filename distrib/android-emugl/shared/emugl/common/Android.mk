@@ -6,6 +6,7 @@ LOCAL_PATH := $(call my-dir)
 ### emugl_common host library ###########################################
 
 commonSources := \
+        dense_name_table.cpp \
         id_to_object_map.cpp \
         lazy_instance.cpp \
         message_channel.cpp \
@@ -48,6 +49,7 @@ $(call emugl-end-module)
 
 host_commonSources := \
     condition_variable_unittest.cpp \
+    dense_name_table_unittest.cpp \
     id_to_object_map_unittest.cpp \
     lazy_instance_unittest.cpp \
     pod_vector_unittest.cpp \
@@ -0,0 +1,105 @@
+// Copyright (C) 2015 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "emugl/common/dense_name_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace emugl {
+
+// Ensure that the zero-initialization of a page is visible to other
+// threads before the page pointer itself.
+static inline void releaseBarrier() {
+#if defined(__i386__) || defined(__x86_64__)
+    // x86 never reorders stores with other stores, so a compiler barrier
+    // is enough.
+    __asm__ __volatile__ ("" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+const DenseNameTable::KeyType DenseNameTable::kMaxKey;
+
+DenseNameTable::DenseNameTable() : mCount(0U) {
+    for (size_t n = 0; n < kMaxPages; ++n) {
+        mPages[n] = NULL;
+    }
+}
+
+DenseNameTable::~DenseNameTable() {
+    for (size_t n = 0; n < kMaxPages; ++n) {
+        ::free(mPages[n]);
+    }
+}
+
+bool DenseNameTable::set(KeyType key, ValueType value) {
+    if (!isDenseKey(key)) {
+        return false;
+    }
+    if (!value) {
+        remove(key);
+        return true;
+    }
+    size_t pageIndex = static_cast<size_t>(key >> kPageBits);
+    ValueType* page = mPages[pageIndex];
+    if (!page) {
+        page = static_cast<ValueType*>(
+                ::calloc(kPageSize, sizeof(ValueType)));
+        releaseBarrier();
+        mPages[pageIndex] = page;
+    }
+    ValueType* slot = &page[key & (kPageSize - 1)];
+    if (!*slot) {
+        mCount++;
+    }
+    *static_cast<volatile ValueType*>(slot) = value;
+    return true;
+}
+
+DenseNameTable::ValueType DenseNameTable::remove(KeyType key) {
+    if (!isDenseKey(key)) {
+        return 0;
+    }
+    ValueType* page = mPages[key >> kPageBits];
+    if (!page) {
+        return 0;
+    }
+    ValueType* slot = &page[key & (kPageSize - 1)];
+    ValueType oldValue = *slot;
+    if (oldValue) {
+        *static_cast<volatile ValueType*>(slot) = 0;
+        mCount--;
+    }
+    return oldValue;
+}
+
+DenseNameTable::KeyType DenseNameTable::nextKey(KeyType from) const {
+    while (from < kMaxKey) {
+        const ValueType* page = mPages[from >> kPageBits];
+        if (!page) {
+            // Skip to the start of the next page.
+            from = (from | (kPageSize - 1)) + 1;
+            continue;
+        }
+        if (page[from & (kPageSize - 1)]) {
+            return from;
+        }
+        from++;
+    }
+    return kMaxKey;
+}
+
+}  // namespace emugl
@@ -0,0 +1,122 @@
+// Copyright (C) 2015 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EMUGL_COMMON_DENSE_NAME_TABLE_H
+#define EMUGL_COMMON_DENSE_NAME_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace emugl {
+
+// A table that maps small non-zero integer keys (e.g. GL object names
+// allocated by a guest) to non-zero 32-bit values, using a two-level
+// array indexed directly by the key.
+//
+// The table is designed for read-mostly workloads where lookups happen
+// on every GL call, while insertions and deletions are rare:
+//
+// - Calls to set() and remove() must be serialized by the caller
+//   (typically with an emugl::Mutex).
+//
+// - Calls to get() and contains() can happen concurrently with a writer
+//   without taking any lock. A concurrent reader sees either the old or
+//   the new value for a given key.
+//
+// Only keys lower than kMaxKey can be stored; use isDenseKey() to check
+// and fall back to another container for larger ones. A value of 0 means
+// 'no entry'.
+class DenseNameTable {
+public:
+    typedef uint64_t KeyType;
+    typedef unsigned ValueType;
+
+    enum {
+        kPageBits = 10,
+        kPageSize = 1 << kPageBits,
+        kMaxPages = 256,
+    };
+
+    static const KeyType kMaxKey = (KeyType)kPageSize * kMaxPages;
+
+    // Return true iff |key| can be stored in a DenseNameTable.
+    static inline bool isDenseKey(KeyType key) {
+        return key < kMaxKey;
+    }
+
+    DenseNameTable();
+
+    ~DenseNameTable();
+
+    // Return the number of entries in the table.
+    size_t size() const { return mCount; }
+
+    // Return the value associated with |key|, or 0 if there is none, or
+    // if |key| is not a dense key. Safe to call without a lock.
+    inline ValueType get(KeyType key) const {
+        if (!isDenseKey(key)) {
+            return 0;
+        }
+        const ValueType* page = loadPage(key >> kPageBits);
+        if (!page) {
+            return 0;
+        }
+        return *static_cast<const volatile ValueType*>(
+                &page[key & (kPageSize - 1)]);
+    }
+
+    // Return true iff |key| has a non-zero value in the table.
+    inline bool contains(KeyType key) const {
+        return get(key) != 0;
+    }
+
+    // Associate |value| with |key|. Using 0 as |value| is equivalent to
+    // calling remove(). Return false if |key| is not a dense key.
+    // Must be serialized with other writers.
+    bool set(KeyType key, ValueType value);
+
+    // Remove the entry for |key|, and return its old value, or 0 if
+    // there was none. Must be serialized with other writers.
+    ValueType remove(KeyType key);
+
+    // Return the smallest key that is >= |from| and has a value in the
+    // table, or kMaxKey if there is none. Used to iterate over all
+    // entries, e.g.:
+    //
+    //    for (KeyType k = table.nextKey(0); k < DenseNameTable::kMaxKey;
+    //         k = table.nextKey(k + 1)) {
+    //        ... table.get(k) ...
+    //    }
+    KeyType nextKey(KeyType from) const;
+
+private:
+    // Load page pointer |index| with acquire semantics, so that a reader
+    // never sees a page before its zero-initialization is visible.
+    inline const ValueType* loadPage(size_t index) const {
+        const ValueType* page = mPages[index];
+        __asm__ __volatile__ ("" : : : "memory");
+        return page;
+    }
+
+    ValueType* volatile mPages[kMaxPages];
+    size_t mCount;
+
+    // Disallow copy and assignment.
+    DenseNameTable(const DenseNameTable&);
+    DenseNameTable& operator=(const DenseNameTable&);
+};
+
+}  // namespace emugl
+
+#endif  // EMUGL_COMMON_DENSE_NAME_TABLE_H
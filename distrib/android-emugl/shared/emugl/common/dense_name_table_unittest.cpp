@@ -0,0 +1,156 @@
+// Copyright (C) 2015 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "emugl/common/dense_name_table.h"
+
+#include "emugl/common/mutex.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include <time.h>
+
+namespace emugl {
+
+typedef DenseNameTable::KeyType KeyType;
+
+TEST(DenseNameTable, Empty) {
+    DenseNameTable table;
+    EXPECT_EQ(0U, table.size());
+    EXPECT_EQ(0U, table.get(0));
+    EXPECT_EQ(0U, table.get(1));
+    EXPECT_FALSE(table.contains(1));
+    EXPECT_EQ(DenseNameTable::kMaxKey, table.nextKey(0));
+}
+
+TEST(DenseNameTable, SetGetRemove) {
+    DenseNameTable table;
+    const KeyType kCount = 5000;
+    for (KeyType n = 1; n < kCount; ++n) {
+        EXPECT_TRUE(table.set(n, static_cast<unsigned>(n * 3))) << n;
+    }
+    EXPECT_EQ(static_cast<size_t>(kCount - 1), table.size());
+
+    for (KeyType n = 1; n < kCount; ++n) {
+        EXPECT_EQ(static_cast<unsigned>(n * 3), table.get(n)) << n;
+    }
+
+    for (KeyType n = 1; n < kCount; n += 2) {
+        EXPECT_EQ(static_cast<unsigned>(n * 3), table.remove(n)) << n;
+        EXPECT_EQ(0U, table.remove(n)) << n;
+    }
+    EXPECT_EQ(static_cast<size_t>((kCount - 1) / 2), table.size());
+
+    for (KeyType n = 1; n < kCount; ++n) {
+        unsigned expected = (n & 1) ? 0U : static_cast<unsigned>(n * 3);
+        EXPECT_EQ(expected, table.get(n)) << n;
+    }
+}
+
+TEST(DenseNameTable, SetZeroRemoves) {
+    DenseNameTable table;
+    EXPECT_TRUE(table.set(42, 7));
+    EXPECT_EQ(1U, table.size());
+    EXPECT_TRUE(table.set(42, 0));
+    EXPECT_EQ(0U, table.size());
+    EXPECT_FALSE(table.contains(42));
+}
+
+TEST(DenseNameTable, ReplaceKeepsSize) {
+    DenseNameTable table;
+    EXPECT_TRUE(table.set(10, 1));
+    EXPECT_TRUE(table.set(10, 2));
+    EXPECT_EQ(1U, table.size());
+    EXPECT_EQ(2U, table.get(10));
+}
+
+TEST(DenseNameTable, RejectsLargeKeys) {
+    DenseNameTable table;
+    const KeyType kBig = DenseNameTable::kMaxKey;
+    EXPECT_FALSE(DenseNameTable::isDenseKey(kBig));
+    EXPECT_TRUE(DenseNameTable::isDenseKey(kBig - 1));
+    EXPECT_FALSE(table.set(kBig, 1));
+    EXPECT_EQ(0U, table.get(kBig));
+    EXPECT_EQ(0U, table.remove(kBig));
+    EXPECT_TRUE(table.set(kBig - 1, 1));
+    EXPECT_EQ(1U, table.get(kBig - 1));
+}
+
+TEST(DenseNameTable, NextKey) {
+    DenseNameTable table;
+    static const KeyType kKeys[] = {
+        1, 2, 1023, 1024, 1025, 70000, DenseNameTable::kMaxKey - 1,
+    };
+    const size_t kKeysLen = sizeof(kKeys) / sizeof(kKeys[0]);
+    for (size_t n = 0; n < kKeysLen; ++n) {
+        table.set(kKeys[n], 1);
+    }
+    size_t count = 0;
+    for (KeyType k = table.nextKey(0); k < DenseNameTable::kMaxKey;
+         k = table.nextKey(k + 1)) {
+        ASSERT_LT(count, kKeysLen);
+        EXPECT_EQ(kKeys[count], k);
+        count++;
+    }
+    EXPECT_EQ(kKeysLen, count);
+}
+
+// Microbenchmark that simulates the name lookups performed by a bind-heavy
+// GL call sequence (bind texture / bind buffer / draw, repeated), comparing
+// the previous std::map + mutex scheme with a lock-free DenseNameTable.
+// Disabled by default, run with --gtest_also_run_disabled_tests.
+TEST(DenseNameTable, DISABLED_BindHeavyBenchmark) {
+    const unsigned kNames = 512;
+    const unsigned kIterations = 20000;
+
+    std::map<KeyType, unsigned> map;
+    Mutex lock;
+    DenseNameTable table;
+    for (unsigned n = 1; n <= kNames; ++n) {
+        map[n] = n + 1000;
+        table.set(n, n + 1000);
+    }
+
+    unsigned sum1 = 0;
+    clock_t start = clock();
+    for (unsigned i = 0; i < kIterations; ++i) {
+        for (unsigned n = 1; n <= kNames; ++n) {
+            Mutex::AutoLock autoLock(lock);
+            std::map<KeyType, unsigned>::const_iterator it = map.find(n);
+            if (it != map.end()) {
+                sum1 += it->second;
+            }
+        }
+    }
+    clock_t mapTime = clock() - start;
+
+    unsigned sum2 = 0;
+    start = clock();
+    for (unsigned i = 0; i < kIterations; ++i) {
+        for (unsigned n = 1; n <= kNames; ++n) {
+            sum2 += table.get(n);
+        }
+    }
+    clock_t tableTime = clock() - start;
+
+    EXPECT_EQ(sum1, sum2);
+    RecordProperty("lookups", static_cast<int>(kNames * kIterations));
+    RecordProperty("mapMutexUs",
+                   static_cast<int>(mapTime * 1000000.0 / CLOCKS_PER_SEC));
+    RecordProperty("denseTableUs",
+                   static_cast<int>(tableTime * 1000000.0 / CLOCKS_PER_SEC));
+}
+
+}  // namespace emugl
@@ -1260,6 +1260,9 @@ void qemu_ram_remap(ram_addr_t addr, ram_addr_t length)
                             length, addr);
                     exit(1);
                 }
+                if (offset == 0 && length == block->length) {
+                    block->flags &= ~RAM_FILE_MAPPED_MASK;
+                }
                 memory_try_enable_merging(vaddr, length);
                 qemu_ram_setup_dump(vaddr, length);
             }
@@ -1267,6 +1270,57 @@ void qemu_ram_remap(ram_addr_t addr, ram_addr_t length)
         }
     }
 }
+
+/* Replace the content of the RAM block that starts at |addr| with a
+ * private, copy-on-write mapping of |fd| at |file_offset|, so that its
+ * pages are only read from the file when the guest touches them.
+ * Return 0 on success, or a negative errno value on failure. The block
+ * content is unchanged if it cannot be mapped this way, but is reset to
+ * zero if mmap() itself fails. Use qemu_ram_remap() on the whole block to
+ * go back to anonymous memory.
+ */
+int qemu_ram_map_file(ram_addr_t addr, int fd, off_t file_offset)
+{
+    RAMBlock *block;
+    uintptr_t page_mask = getpagesize() - 1;
+    void *area;
+
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        if (block->offset == addr) {
+            break;
+        }
+    }
+    if (!block) {
+        return -ENOENT;
+    }
+
+    /* Hypervisors that don't track host mapping changes keep using the
+     * previous pages. */
+    if ((block->flags & RAM_PREALLOC_MASK) || block->fd >= 0 ||
+        xen_enabled() || (kvm_enabled() && !kvm_has_sync_mmu())) {
+        return -ENOTSUP;
+    }
+#ifdef CONFIG_HAX
+    if (hax_enabled()) {
+        return -ENOTSUP;
+    }
+#endif
+    if (((uintptr_t)block->host | block->length | file_offset) & page_mask) {
+        return -EINVAL;
+    }
+
+    area = mmap(block->host, block->length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, file_offset);
+    if (area != block->host) {
+        int ret = -errno;
+        /* A failed MAP_FIXED may have removed the previous mapping. */
+        qemu_ram_remap(block->offset, block->length);
+        return ret;
+    }
+    block->flags |= RAM_FILE_MAPPED_MASK;
+    qemu_ram_setup_dump(block->host, block->length);
+    return 0;
+}
 #endif /* !_WIN32 */
 
 /* Return a host pointer to ram allocated with qemu_ram_alloc.
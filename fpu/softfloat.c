@@ -42,6 +42,10 @@ these four paragraphs for those parts of this code that are retained.
 
 #include "fpu/softfloat.h"
 
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
 /*----------------------------------------------------------------------------
 | Primitive arithmetic functions, including multi-word arithmetic, and
 | division and square root approximations.  (Can be specialized to target if
@@ -74,6 +78,102 @@ void set_floatx80_rounding_precision(int val STATUS_PARAM)
     STATUS(floatx80_rounding_precision) = val;
 }
 
+/*----------------------------------------------------------------------------
+| Host FPU fast path.  When the inputs of an addition, subtraction,
+| multiplication, division or square root are zero or normal numbers, the
+| rounding mode is round-to-nearest-even and the inexact flag is already
+| raised, the host FPU computes the same result as this file, and raises
+| no other flag unless the result overflows or is tiny.  These results are
+| checked for, and computed again in software.  Guests rarely clear the
+| inexact flag, so this covers most operations.
+|
+| This requires the host to evaluate `float' and `double' operations in
+| their own precision, which isn't the case with x87 math.
+*----------------------------------------------------------------------------*/
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define SOFTFLOAT_HOST_FPU 1
+#endif
+
+static flag use_host_fpu = 1;
+
+void softfloat_set_use_host_fpu(flag val)
+{
+    use_host_fpu = val;
+}
+
+#ifdef SOFTFLOAT_HOST_FPU
+INLINE flag float32_is_zero_or_normal(float32 a)
+{
+    uint32_t exp = (float32_val(a) >> 23) & 0xFF;
+
+    return (exp != 0 && exp != 0xFF) || (float32_val(a) << 1) == 0;
+}
+
+INLINE flag float64_is_zero_or_normal(float64 a)
+{
+    uint64_t exp = (float64_val(a) >> 52) & 0x7FF;
+
+    return (exp != 0 && exp != 0x7FF) || (float64_val(a) << 1) == 0;
+}
+
+INLINE flag host_fpu_usable(float_status *status)
+{
+    return use_host_fpu &&
+           STATUS(float_rounding_mode) == float_round_nearest_even &&
+           (STATUS(float_exception_flags) & float_flag_inexact);
+}
+
+INLINE float float32_to_host(float32 a)
+{
+    uint32_t v = float32_val(a);
+    float f;
+
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+INLINE float32 float32_from_host(float f)
+{
+    uint32_t v;
+
+    memcpy(&v, &f, sizeof(v));
+    return make_float32(v);
+}
+
+INLINE double float64_to_host(float64 a)
+{
+    uint64_t v = float64_val(a);
+    double d;
+
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+INLINE float64 float64_from_host(double d)
+{
+    uint64_t v;
+
+    memcpy(&v, &d, sizeof(v));
+    return make_float64(v);
+}
+
+/* Returns 1 if `r' can be returned as is: it must be normal, or a zero
+   that is exact because one of the inputs is zero. */
+INLINE flag float32_host_result_ok(float r, flag zero_input)
+{
+    float m = fabsf(r);
+
+    return (m > FLT_MIN && m <= FLT_MAX) || (m == 0 && zero_input);
+}
+
+INLINE flag float64_host_result_ok(double r, flag zero_input)
+{
+    double m = fabs(r);
+
+    return (m > DBL_MIN && m <= DBL_MAX) || (m == 0 && zero_input);
+}
+#endif
+
 /*----------------------------------------------------------------------------
 | Returns the fraction bits of the half-precision floating-point value `a'.
 *----------------------------------------------------------------------------*/
@@ -1867,6 +1967,15 @@ static float32 subFloat32Sigs( float32 a, float32 b, flag zSign STATUS_PARAM)
 float32 float32_add( float32 a, float32 b STATUS_PARAM )
 {
     flag aSign, bSign;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float r = float32_to_host(a) + float32_to_host(b);
+        if (float32_host_result_ok(r, float32_is_zero(a) && float32_is_zero(b))) {
+            return float32_from_host(r);
+        }
+    }
+#endif
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -1890,6 +1999,15 @@ float32 float32_add( float32 a, float32 b STATUS_PARAM )
 float32 float32_sub( float32 a, float32 b STATUS_PARAM )
 {
     flag aSign, bSign;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float r = float32_to_host(a) - float32_to_host(b);
+        if (float32_host_result_ok(r, float32_is_zero(a) && float32_is_zero(b))) {
+            return float32_from_host(r);
+        }
+    }
+#endif
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -1918,6 +2036,15 @@ float32 float32_mul( float32 a, float32 b STATUS_PARAM )
     uint64_t zSig64;
     uint32_t zSig;
 
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float r = float32_to_host(a) * float32_to_host(b);
+        if (float32_host_result_ok(r, float32_is_zero(a) || float32_is_zero(b))) {
+            return float32_from_host(r);
+        }
+    }
+#endif
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -1978,6 +2105,16 @@ float32 float32_div( float32 a, float32 b STATUS_PARAM )
     flag aSign, bSign, zSign;
     int_fast16_t aExp, bExp, zExp;
     uint32_t aSig, bSig, zSig;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float32_is_zero_or_normal(a) &&
+        float32_is_zero_or_normal(b) && !float32_is_zero(b)) {
+        float r = float32_to_host(a) / float32_to_host(b);
+        if (float32_host_result_ok(r, float32_is_zero(a))) {
+            return float32_from_host(r);
+        }
+    }
+#endif
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -2351,6 +2488,15 @@ float32 float32_sqrt( float32 a STATUS_PARAM )
     int_fast16_t aExp, zExp;
     uint32_t aSig, zSig;
     uint64_t rem, term;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float32_is_zero_or_normal(a) && !extractFloat32Sign(a)) {
+        float r = sqrtf(float32_to_host(a));
+        if (float32_host_result_ok(r, float32_is_zero(a))) {
+            return float32_from_host(r);
+        }
+    }
+#endif
     a = float32_squash_input_denormal(a STATUS_VAR);
 
     aSig = extractFloat32Frac( a );
@@ -3430,6 +3576,15 @@ static float64 subFloat64Sigs( float64 a, float64 b, flag zSign STATUS_PARAM )
 float64 float64_add( float64 a, float64 b STATUS_PARAM )
 {
     flag aSign, bSign;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        double r = float64_to_host(a) + float64_to_host(b);
+        if (float64_host_result_ok(r, float64_is_zero(a) && float64_is_zero(b))) {
+            return float64_from_host(r);
+        }
+    }
+#endif
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3453,6 +3608,15 @@ float64 float64_add( float64 a, float64 b STATUS_PARAM )
 float64 float64_sub( float64 a, float64 b STATUS_PARAM )
 {
     flag aSign, bSign;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        double r = float64_to_host(a) - float64_to_host(b);
+        if (float64_host_result_ok(r, float64_is_zero(a) && float64_is_zero(b))) {
+            return float64_from_host(r);
+        }
+    }
+#endif
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3479,6 +3643,15 @@ float64 float64_mul( float64 a, float64 b STATUS_PARAM )
     int_fast16_t aExp, bExp, zExp;
     uint64_t aSig, bSig, zSig0, zSig1;
 
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        double r = float64_to_host(a) * float64_to_host(b);
+        if (float64_host_result_ok(r, float64_is_zero(a) || float64_is_zero(b))) {
+            return float64_from_host(r);
+        }
+    }
+#endif
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3541,6 +3714,16 @@ float64 float64_div( float64 a, float64 b STATUS_PARAM )
     uint64_t aSig, bSig, zSig;
     uint64_t rem0, rem1;
     uint64_t term0, term1;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float64_is_zero_or_normal(a) &&
+        float64_is_zero_or_normal(b) && !float64_is_zero(b)) {
+        double r = float64_to_host(a) / float64_to_host(b);
+        if (float64_host_result_ok(r, float64_is_zero(a))) {
+            return float64_from_host(r);
+        }
+    }
+#endif
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3924,6 +4107,15 @@ float64 float64_sqrt( float64 a STATUS_PARAM )
     int_fast16_t aExp, zExp;
     uint64_t aSig, zSig, doubleZSig;
     uint64_t rem0, rem1, term0, term1;
+#ifdef SOFTFLOAT_HOST_FPU
+    if (host_fpu_usable(status) &&
+        float64_is_zero_or_normal(a) && !extractFloat64Sign(a)) {
+        double r = sqrt(float64_to_host(a));
+        if (float64_host_result_ok(r, float64_is_zero(a))) {
+            return float64_from_host(r);
+        }
+    }
+#endif
     a = float64_squash_input_denormal(a STATUS_VAR);
 
     aSig = extractFloat64Frac( a );
@@ -0,0 +1,199 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Checks that the host FPU fast path of softfloat returns the same results
+// and raises the same flags as the software implementation.
+
+extern "C" {
+#include "fpu/softfloat.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+const int kIterations = 200000;
+
+// A small deterministic pseudo-random generator.
+class Random {
+public:
+    Random() : mState(0x853c49e6748fea9bULL) {}
+
+    uint64_t next() {
+        mState = mState * 6364136223846793005ULL + 1442695040888963407ULL;
+        return mState ^ (mState >> 29);
+    }
+
+private:
+    uint64_t mState;
+};
+
+// Returns a random value with an exponent biased towards the limits of the
+// normal range, where the fast path must fall back to software, and some
+// zeroes, denormals, infinities and NaNs.
+uint32_t randomFloat32(Random* rand) {
+    uint64_t r = rand->next();
+    uint32_t sign = (r & 1) << 31;
+    uint32_t frac = (r >> 8) & 0x7fffff;
+    uint32_t exp;
+    switch ((r >> 1) & 7) {
+    case 0: exp = 0; break;
+    case 1: exp = 0xff; break;
+    case 2: exp = 1 + ((r >> 40) & 15); break;
+    case 3: exp = 0xfe - ((r >> 40) & 15); break;
+    case 4: return sign;
+    default: exp = 1 + (r >> 40) % 0xfe; break;
+    }
+    return sign | (exp << 23) | frac;
+}
+
+uint64_t randomFloat64(Random* rand) {
+    uint64_t r = rand->next();
+    uint64_t sign = (r & 1) << 63;
+    uint64_t frac = rand->next() & 0xfffffffffffffULL;
+    uint64_t exp;
+    switch ((r >> 1) & 7) {
+    case 0: exp = 0; break;
+    case 1: exp = 0x7ff; break;
+    case 2: exp = 1 + ((r >> 40) & 31); break;
+    case 3: exp = 0x7fe - ((r >> 40) & 31); break;
+    case 4: return sign;
+    default: exp = 1 + (r >> 40) % 0x7fe; break;
+    }
+    return sign | (exp << 52) | frac;
+}
+
+// The configurations used by the ARM VFP and NEON helpers.
+void initStatus(float_status* status, int variant) {
+    memset(status, 0, sizeof(*status));
+    set_float_rounding_mode(float_round_nearest_even, status);
+    set_float_detect_tininess(float_tininess_before_rounding, status);
+    if (variant) {
+        set_flush_to_zero(1, status);
+        set_flush_inputs_to_zero(1, status);
+        set_default_nan_mode(1, status);
+    }
+    // The fast path is only taken once the inexact flag is raised.
+    set_float_exception_flags(float_flag_inexact, status);
+}
+
+enum Op { kAdd, kSub, kMul, kDiv, kSqrt, kNumOps };
+
+float32 doFloat32Op(int op, float32 a, float32 b, float_status* status) {
+    switch (op) {
+    case kAdd: return float32_add(a, b, status);
+    case kSub: return float32_sub(a, b, status);
+    case kMul: return float32_mul(a, b, status);
+    case kDiv: return float32_div(a, b, status);
+    default: return float32_sqrt(a, status);
+    }
+}
+
+float64 doFloat64Op(int op, float64 a, float64 b, float_status* status) {
+    switch (op) {
+    case kAdd: return float64_add(a, b, status);
+    case kSub: return float64_sub(a, b, status);
+    case kMul: return float64_mul(a, b, status);
+    case kDiv: return float64_div(a, b, status);
+    default: return float64_sqrt(a, status);
+    }
+}
+
+class SoftFloatHostFpu : public ::testing::Test {
+protected:
+    virtual void TearDown() {
+        softfloat_set_use_host_fpu(1);
+    }
+};
+
+}  // namespace
+
+TEST_F(SoftFloatHostFpu, Float32) {
+    Random rand;
+    for (int n = 0; n < kIterations; ++n) {
+        float32 a = make_float32(randomFloat32(&rand));
+        float32 b = make_float32(randomFloat32(&rand));
+        for (int op = 0; op < kNumOps; ++op) {
+            for (int variant = 0; variant < 2; ++variant) {
+                float_status soft, host;
+                initStatus(&soft, variant);
+                initStatus(&host, variant);
+
+                softfloat_set_use_host_fpu(0);
+                float32 expected = doFloat32Op(op, a, b, &soft);
+                softfloat_set_use_host_fpu(1);
+                float32 result = doFloat32Op(op, a, b, &host);
+
+                ASSERT_EQ(float32_val(expected), float32_val(result))
+                        << "op " << op << " variant " << variant << " a "
+                        << std::hex << float32_val(a) << " b "
+                        << float32_val(b);
+                ASSERT_EQ(get_float_exception_flags(&soft),
+                          get_float_exception_flags(&host))
+                        << "op " << op << " variant " << variant << " a "
+                        << std::hex << float32_val(a) << " b "
+                        << float32_val(b);
+            }
+        }
+    }
+}
+
+TEST_F(SoftFloatHostFpu, Float64) {
+    Random rand;
+    for (int n = 0; n < kIterations; ++n) {
+        float64 a = make_float64(randomFloat64(&rand));
+        float64 b = make_float64(randomFloat64(&rand));
+        for (int op = 0; op < kNumOps; ++op) {
+            for (int variant = 0; variant < 2; ++variant) {
+                float_status soft, host;
+                initStatus(&soft, variant);
+                initStatus(&host, variant);
+
+                softfloat_set_use_host_fpu(0);
+                float64 expected = doFloat64Op(op, a, b, &soft);
+                softfloat_set_use_host_fpu(1);
+                float64 result = doFloat64Op(op, a, b, &host);
+
+                ASSERT_EQ(float64_val(expected), float64_val(result))
+                        << "op " << op << " variant " << variant << " a "
+                        << std::hex << float64_val(a) << " b "
+                        << float64_val(b);
+                ASSERT_EQ(get_float_exception_flags(&soft),
+                          get_float_exception_flags(&host))
+                        << "op " << op << " variant " << variant << " a "
+                        << std::hex << float64_val(a) << " b "
+                        << float64_val(b);
+            }
+        }
+    }
+}
+
+TEST_F(SoftFloatHostFpu, NoInexactFlag) {
+    // Without the inexact flag, results must still be identical, since
+    // the software implementation is used.
+    float_status soft, host;
+    initStatus(&soft, 0);
+    initStatus(&host, 0);
+    set_float_exception_flags(0, &soft);
+    set_float_exception_flags(0, &host);
+
+    softfloat_set_use_host_fpu(0);
+    float32 expected = float32_div(float32_one, make_float32(0x40400000),
+                                   &soft);
+    softfloat_set_use_host_fpu(1);
+    float32 result = float32_div(float32_one, make_float32(0x40400000),
+                                 &host);
+    EXPECT_EQ(float32_val(expected), float32_val(result));
+    EXPECT_EQ(float_flag_inexact, get_float_exception_flags(&host));
+}
@@ -198,6 +198,8 @@ static void android_mips_init_(ram_addr_t ram_size,
                 smc_device->irq_count = 1;
                 goldfish_add_device_no_io(smc_device);
                 smc91c111_init(&nd_table[i], smc_device->base, goldfish_pic[smc_device->irq]);
+            } else if (strcmp(nd_table[i].model, "goldfish") == 0) {
+                goldfish_net_init(&nd_table[i], i);
             } else {
                 fprintf(stderr, "qemu: Unsupported NIC: %s\n", nd_table[0].model);
                 exit (1);
@@ -217,6 +219,10 @@ static void android_mips_init_(ram_addr_t ram_size,
     }
     goldfish_battery_init(android_hw->hw_battery);
 
+    if (goldfish_balloon) {
+        goldfish_balloon_init();
+    }
+
     goldfish_add_device_no_io(&event0_device);
     events_dev_init(event0_device.base, goldfish_pic[event0_device.irq]);
 
@@ -0,0 +1,315 @@
+/* Copyright (C) 2015 The Android Open Source Project
+**
+** This software is licensed under the terms of the GNU General Public
+** License version 2, as published by the Free Software Foundation, and
+** may be copied, distributed, and modified under those terms.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+*/
+
+/* Goldfish memory balloon device.
+ *
+ * Lets the guest give pages of its RAM back to the host, either because
+ * the host asked for them by raising the balloon target, or because they
+ * are free in the guest (free page reporting). The host releases these
+ * pages with madvise(MADV_DONTNEED), so an emulator only keeps the memory
+ * that its guest actually uses.
+ *
+ * See docs/GOLDFISH-VIRTUAL-HARDWARE.TXT for the guest-visible interface.
+ */
+
+#include "cpu.h"
+#include "migration/qemu-file.h"
+#include "hw/android/goldfish/device.h"
+#include "hw/hw.h"
+#include "exec/hax.h"
+#include "exec/ram_addr.h"
+#include "sysemu/balloon.h"
+#include "sysemu/kvm.h"
+
+enum {
+    /* interrupt status, reading it clears it and lowers the IRQ */
+    BALLOON_INT_STATUS      = 0x00,
+    /* set this to enable IRQs */
+    BALLOON_INT_ENABLE      = 0x04,
+    /* number of pages the host wants in the balloon, read-only */
+    BALLOON_TARGET_PAGES    = 0x08,
+    /* number of pages currently in the balloon, written by the guest */
+    BALLOON_ACTUAL_PAGES    = 0x0c,
+    /* guest-physical address of an array of 32-bit page frame numbers */
+    BALLOON_PFN_ARRAY_LOW   = 0x10,
+    BALLOON_PFN_ARRAY_HIGH  = 0x14,
+    /* number of entries in the array */
+    BALLOON_PFN_COUNT       = 0x18,
+    /* process the array, see BALLOON_CMD_XXX below */
+    BALLOON_COMMAND         = 0x1c,
+
+    BALLOON_INT_TARGET      = 1U << 0,
+    BALLOON_INT_MASK        = BALLOON_INT_TARGET,
+
+    /* the pages were added to the balloon, release them */
+    BALLOON_CMD_INFLATE     = 1,
+    /* the pages were removed from the balloon */
+    BALLOON_CMD_DEFLATE     = 2,
+    /* the pages are free in the guest, release them */
+    BALLOON_CMD_REPORT_FREE = 3,
+};
+
+/* Size of a balloon page, independent from the guest and host page sizes */
+#define BALLOON_PAGE_SHIFT  12
+#define BALLOON_PAGE_SIZE   (1 << BALLOON_PAGE_SHIFT)
+
+/* Maximum number of entries processed by a single command */
+#define BALLOON_MAX_PFNS    4096
+
+struct goldfish_balloon_state {
+    struct goldfish_device dev;
+    uint32_t int_status;
+    uint32_t int_enable;
+    uint32_t target_pages;
+    uint32_t actual_pages;
+    uint32_t pfn_array_low;
+    uint32_t pfn_array_high;
+    uint32_t pfn_count;
+
+    // the fields below are statistics, and are not saved to / restored
+    // from snapshots.
+    uint64_t released_pages;
+};
+
+/* update this each time you update the goldfish_balloon_state struct */
+#define  BALLOON_STATE_SAVE_VERSION  1
+
+#define  QFIELD_STRUCT  struct goldfish_balloon_state
+QFIELD_BEGIN(goldfish_balloon_fields)
+    QFIELD_INT32(int_status),
+    QFIELD_INT32(int_enable),
+    QFIELD_INT32(target_pages),
+    QFIELD_INT32(actual_pages),
+    QFIELD_INT32(pfn_array_low),
+    QFIELD_INT32(pfn_array_high),
+    QFIELD_INT32(pfn_count),
+QFIELD_END
+
+static void goldfish_balloon_save(QEMUFile* f, void* opaque)
+{
+    struct goldfish_balloon_state* s = opaque;
+
+    qemu_put_struct(f, goldfish_balloon_fields, s);
+}
+
+static int goldfish_balloon_load(QEMUFile* f, void* opaque, int version_id)
+{
+    struct goldfish_balloon_state* s = opaque;
+
+    if (version_id != BALLOON_STATE_SAVE_VERSION)
+        return -1;
+
+    return qemu_get_struct(f, goldfish_balloon_fields, s);
+}
+
+/* Return 1 if released pages are really given back to the host. This
+ * isn't the case with hypervisors that keep their own reference to
+ * guest RAM, or when host pages are larger than balloon pages. */
+static int goldfish_balloon_can_release(void)
+{
+    if (hax_enabled())
+        return 0;
+    if (kvm_enabled() && !kvm_has_sync_mmu())
+        return 0;
+    return getpagesize() <= BALLOON_PAGE_SIZE;
+}
+
+/* Release the guest RAM page at |addr|, whose content is not needed
+ * anymore. Its content is undefined the next time the guest uses it:
+ * anonymous RAM reads back as zeroes, but RAM mapped from a snapshot RAM
+ * file reads back as the content saved in that file. The guest doesn't
+ * rely on either, since it only reuses the page after a deflate. */
+static void goldfish_balloon_release_page(struct goldfish_balloon_state* s,
+                                          hwaddr addr)
+{
+    hwaddr len = BALLOON_PAGE_SIZE;
+    ram_addr_t ram_addr;
+    void* host;
+
+    host = cpu_physical_memory_map(addr, &len, 0);
+    if (!host)
+        return;
+    /* Ignore pages that are not RAM, which are mapped to a bounce
+     * buffer. */
+    if (len == BALLOON_PAGE_SIZE &&
+        qemu_ram_addr_from_host(host, &ram_addr) == 0 &&
+        qemu_madvise(host, len, QEMU_MADV_DONTNEED) == 0) {
+        s->released_pages++;
+    }
+    cpu_physical_memory_unmap(host, len, 0, 0);
+}
+
+static void goldfish_balloon_do_command(struct goldfish_balloon_state* s,
+                                        uint32_t cmd)
+{
+    uint32_t pfns[256];
+    hwaddr array = ((uint64_t)s->pfn_array_high << 32) | s->pfn_array_low;
+    uint32_t count = s->pfn_count;
+    uint32_t n, i;
+
+    switch (cmd) {
+    case BALLOON_CMD_INFLATE:
+    case BALLOON_CMD_REPORT_FREE:
+        break;
+    case BALLOON_CMD_DEFLATE:
+        /* Released pages are faulted back in by the host on access. */
+        return;
+    default:
+        cpu_abort(cpu_single_env,
+                  "goldfish_balloon: Bad command %x\n", cmd);
+        return;
+    }
+
+    if (!goldfish_balloon_can_release())
+        return;
+
+    if (count > BALLOON_MAX_PFNS)
+        count = BALLOON_MAX_PFNS;
+    while (count > 0) {
+        n = count < ARRAY_SIZE(pfns) ? count : ARRAY_SIZE(pfns);
+        cpu_physical_memory_read(array, (uint8_t*)pfns, n * sizeof(pfns[0]));
+        for (i = 0; i < n; i++) {
+            goldfish_balloon_release_page(
+                    s, (hwaddr)le32_to_cpu(pfns[i]) << BALLOON_PAGE_SHIFT);
+        }
+        array += n * sizeof(pfns[0]);
+        count -= n;
+    }
+}
+
+static uint32_t goldfish_balloon_read(void* opaque, hwaddr offset)
+{
+    struct goldfish_balloon_state* s = opaque;
+    uint32_t ret;
+
+    switch (offset) {
+    case BALLOON_INT_STATUS:
+        ret = s->int_status & s->int_enable;
+        if (ret) {
+            goldfish_device_set_irq(&s->dev, 0, 0);
+            s->int_status = 0;
+        }
+        return ret;
+    case BALLOON_INT_ENABLE:
+        return s->int_enable;
+    case BALLOON_TARGET_PAGES:
+        return s->target_pages;
+    case BALLOON_ACTUAL_PAGES:
+        return s->actual_pages;
+    case BALLOON_PFN_ARRAY_LOW:
+        return s->pfn_array_low;
+    case BALLOON_PFN_ARRAY_HIGH:
+        return s->pfn_array_high;
+    case BALLOON_PFN_COUNT:
+        return s->pfn_count;
+    default:
+        cpu_abort(cpu_single_env,
+                  "goldfish_balloon_read: Bad offset %" HWADDR_PRIx "\n",
+                  offset);
+        return 0;
+    }
+}
+
+static void goldfish_balloon_write(void* opaque, hwaddr offset, uint32_t val)
+{
+    struct goldfish_balloon_state* s = opaque;
+
+    switch (offset) {
+    case BALLOON_INT_ENABLE:
+        s->int_enable = val & BALLOON_INT_MASK;
+        goldfish_device_set_irq(&s->dev, 0,
+                                (s->int_status & s->int_enable) != 0);
+        break;
+    case BALLOON_ACTUAL_PAGES:
+        s->actual_pages = val;
+        break;
+    case BALLOON_PFN_ARRAY_LOW:
+        s->pfn_array_low = val;
+        break;
+    case BALLOON_PFN_ARRAY_HIGH:
+        s->pfn_array_high = val;
+        break;
+    case BALLOON_PFN_COUNT:
+        s->pfn_count = val;
+        break;
+    case BALLOON_COMMAND:
+        goldfish_balloon_do_command(s, val);
+        break;
+    default:
+        cpu_abort(cpu_single_env,
+                  "goldfish_balloon_write: Bad offset %" HWADDR_PRIx "\n",
+                  offset);
+    }
+}
+
+static CPUReadMemoryFunc* goldfish_balloon_readfn[] = {
+    goldfish_balloon_read,
+    goldfish_balloon_read,
+    goldfish_balloon_read
+};
+
+static CPUWriteMemoryFunc* goldfish_balloon_writefn[] = {
+    goldfish_balloon_write,
+    goldfish_balloon_write,
+    goldfish_balloon_write
+};
+
+/* Balloon handler, see qemu_balloon(). |target| is the amount of RAM, in
+ * bytes, that the guest should keep, or 0 to only query it. Return the
+ * amount of RAM the guest currently keeps. */
+static ram_addr_t goldfish_balloon_event(void* opaque, ram_addr_t target)
+{
+    struct goldfish_balloon_state* s = opaque;
+
+    if (target > 0) {
+        if (target > ram_size)
+            target = ram_size;
+        s->target_pages = (ram_size - target) >> BALLOON_PAGE_SHIFT;
+        s->int_status |= BALLOON_INT_TARGET;
+        goldfish_device_set_irq(&s->dev, 0,
+                                (s->int_status & s->int_enable) != 0);
+    }
+    return ram_size - ((ram_addr_t)s->actual_pages << BALLOON_PAGE_SHIFT);
+}
+
+static struct goldfish_balloon_state* balloon_state;
+
+void goldfish_balloon_init(void)
+{
+    struct goldfish_balloon_state* s;
+
+    s = (struct goldfish_balloon_state*)g_malloc0(sizeof(*s));
+    s->dev.name = "goldfish_balloon";
+    s->dev.base = 0;    // will be allocated dynamically
+    s->dev.size = 0x1000;
+    s->dev.irq_count = 1;
+
+    balloon_state = s;
+
+    goldfish_device_add(&s->dev, goldfish_balloon_readfn,
+                        goldfish_balloon_writefn, s);
+
+    qemu_add_balloon_handler(goldfish_balloon_event, s);
+
+    register_savevm(NULL,
+                    "goldfish_balloon",
+                    0,
+                    BALLOON_STATE_SAVE_VERSION,
+                    goldfish_balloon_save,
+                    goldfish_balloon_load,
+                    s);
+}
+
+uint64_t goldfish_balloon_get_released_pages(void)
+{
+    return balloon_state ? balloon_state->released_pages : 0;
+}
@@ -21,9 +21,18 @@
 #include "hw/hw.h"
 #include "hw/irq.h"
 #include "migration/qemu-file.h"
+#include "qemu/timer.h"
 #include "ui/console.h"
 
-#define MAX_EVENTS 256*4
+/* Initial and maximum number of events in the queue. The queue grows
+ * as needed, so that fast injection of multi-touch gestures through the
+ * console doesn't lose events, but is bounded in case the guest never
+ * reads them. */
+#define MIN_EVENTS  256
+#define MAX_EVENTS  65536
+
+/* Number of events written to guest memory by a single BUFFER_READ */
+#define MAX_BATCH_EVENTS  1024
 
 enum {
     REG_READ        = 0x00,
@@ -31,6 +40,16 @@ enum {
     REG_LEN         = 0x04,
     REG_DATA        = 0x08,
 
+    /* Batched delivery, see docs/GOLDFISH-VIRTUAL-HARDWARE.TXT. These are
+     * above the largest page, so older devices read them as 0. */
+    REG_FEATURES    = 0x800,
+    REG_BUFFER_LOW  = 0x804,
+    REG_BUFFER_HIGH = 0x808,
+    REG_BUFFER_SIZE = 0x80c,
+    REG_BUFFER_READ = 0x810,
+
+    FEATURE_BATCH   = 1U << 0,
+
     PAGE_NAME       = 0x00000,
     PAGE_EVBITS     = 0x10000,
     PAGE_ABSDATA    = 0x20000 | EV_ABS,
@@ -51,6 +70,25 @@ enum {
  *       which events can be sent by the emulated hardware.
  */
 
+typedef struct
+{
+    uint32_t type;
+    uint32_t code;
+    int32_t  value;
+    /* QEMU_CLOCK_VIRTUAL time at which the event was queued, in ns */
+    int64_t  time;
+} QueuedEvent;
+
+/* An event, as written to guest memory by BUFFER_READ */
+typedef struct
+{
+    uint32_t sec;
+    uint32_t usec;
+    uint16_t type;
+    uint16_t code;
+    int32_t  value;
+} BatchEvent;
+
 typedef struct
 {
     uint32_t base;
@@ -58,11 +96,21 @@ typedef struct
     int pending;
     int page;
 
-    unsigned events[MAX_EVENTS];
+    /* circular queue of |count| events starting at |first|, with a
+     * power-of-two |capacity|. |read_pos| is the number of values of the
+     * first event already read through REG_READ. */
+    QueuedEvent *events;
+    unsigned capacity;
     unsigned first;
-    unsigned last;
+    unsigned count;
+    unsigned read_pos;
     unsigned state;
 
+    /* guest buffer used by REG_BUFFER_READ */
+    uint32_t buffer_low;
+    uint32_t buffer_high;
+    uint32_t buffer_size;
+
     const char *name;
 
     struct {
@@ -89,7 +137,7 @@ typedef struct ABSEntry {
 /* modify this each time you change the events_device structure. you
  * will also need to upadte events_state_load and events_state_save
  */
-#define  EVENTS_STATE_SAVE_VERSION  2
+#define  EVENTS_STATE_SAVE_VERSION  3
 
 #undef  QFIELD_STRUCT
 #define QFIELD_STRUCT  events_state
@@ -97,42 +145,98 @@ typedef struct ABSEntry {
 QFIELD_BEGIN(events_state_fields)
     QFIELD_INT32(pending),
     QFIELD_INT32(page),
-    QFIELD_BUFFER(events),
-    QFIELD_INT32(first),
-    QFIELD_INT32(last),
+    QFIELD_INT32(read_pos),
     QFIELD_INT32(state),
+    QFIELD_INT32(buffer_low),
+    QFIELD_INT32(buffer_high),
+    QFIELD_INT32(buffer_size),
 QFIELD_END
 
+static QueuedEvent *queue_at(events_state *s, unsigned n)
+{
+    return &s->events[(s->first + n) & (s->capacity - 1)];
+}
+
+/* Make room for at least |count| events, return 0 on failure. */
+static int events_reserve(events_state *s, unsigned count)
+{
+    QueuedEvent *events;
+    unsigned capacity, n;
+
+    if (count <= s->capacity)
+        return 1;
+    if (count > MAX_EVENTS)
+        return 0;
+
+    capacity = s->capacity ? s->capacity : MIN_EVENTS;
+    while (capacity < count)
+        capacity *= 2;
+
+    events = g_new(QueuedEvent, capacity);
+    for (n = 0; n < s->count; n++)
+        events[n] = *queue_at(s, n);
+    g_free(s->events);
+    s->events = events;
+    s->capacity = capacity;
+    s->first = 0;
+    return 1;
+}
+
 static void  events_state_save(QEMUFile*  f, void*  opaque)
 {
     events_state*  s = opaque;
+    unsigned n;
 
     qemu_put_struct(f, events_state_fields, s);
+
+    qemu_put_be32(f, s->count);
+    for (n = 0; n < s->count; n++) {
+        QueuedEvent *ev = queue_at(s, n);
+        qemu_put_be32(f, ev->type);
+        qemu_put_be32(f, ev->code);
+        qemu_put_be32(f, ev->value);
+        qemu_put_be64(f, ev->time);
+    }
 }
 
 static int  events_state_load(QEMUFile*  f, void* opaque, int  version_id)
 {
     events_state*  s = opaque;
+    unsigned count, n;
+    int ret;
 
     if (version_id != EVENTS_STATE_SAVE_VERSION)
         return -1;
 
-    return qemu_get_struct(f, events_state_fields, s);
+    ret = qemu_get_struct(f, events_state_fields, s);
+    if (ret != 0)
+        return ret;
+
+    count = qemu_get_be32(f);
+    if (!events_reserve(s, count))
+        return -EINVAL;
+    s->first = 0;
+    s->count = count;
+    for (n = 0; n < count; n++) {
+        QueuedEvent *ev = &s->events[n];
+        ev->type = qemu_get_be32(f);
+        ev->code = qemu_get_be32(f);
+        ev->value = qemu_get_be32(f);
+        ev->time = qemu_get_be64(f);
+    }
+    return 0;
 }
 
 static void enqueue_event(events_state *s, unsigned int type, unsigned int code, int value)
 {
-    int  enqueued = s->last - s->first;
-
-    if (enqueued < 0)
-        enqueued += MAX_EVENTS;
+    QueuedEvent *ev;
 
-    if (enqueued + 3 > MAX_EVENTS) {
+    if (!events_reserve(s, s->count + 1)) {
         fprintf(stderr, "##KBD: Full queue, lose event\n");
         return;
     }
 
-    if(s->first == s->last) {
+    if (s->count == 0) {
 	if (s->state == STATE_LIVE)
 	  qemu_irq_raise(s->irq);
 	else {
@@ -142,27 +246,36 @@ static void enqueue_event(events_state *s, unsigned int type, unsigned int code,
 
     //fprintf(stderr, "##KBD: type=%d code=%d value=%d\n", type, code, value);
 
-    s->events[s->last] = type;
-    s->last = (s->last + 1) & (MAX_EVENTS-1);
-    s->events[s->last] = code;
-    s->last = (s->last + 1) & (MAX_EVENTS-1);
-    s->events[s->last] = value;
-    s->last = (s->last + 1) & (MAX_EVENTS-1);
+    ev = queue_at(s, s->count);
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+    ev->time = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    s->count++;
 }
 
 static unsigned dequeue_event(events_state *s)
 {
+    QueuedEvent *ev;
     unsigned n;
 
-    if(s->first == s->last) {
+    if (s->count == 0) {
         return 0;
     }
 
-    n = s->events[s->first];
-
-    s->first = (s->first + 1) & (MAX_EVENTS - 1);
+    ev = queue_at(s, 0);
+    switch (s->read_pos++) {
+    case 0:  n = ev->type; break;
+    case 1:  n = ev->code; break;
+    default: n = ev->value; break;
+    }
+    if (s->read_pos == 3) {
+        s->read_pos = 0;
+        s->first = (s->first + 1) & (s->capacity - 1);
+        s->count--;
+    }
 
-    if(s->first == s->last) {
+    if (s->count == 0) {
         qemu_irq_lower(s->irq);
     }
 #ifdef TARGET_I386
@@ -176,8 +289,7 @@ static unsigned dequeue_event(events_state *s)
      * queue, the goldfish event device will re-assert the IRQ so that
      * the driver can be notified to fetch the event again.
      */
-    else if (((s->first + 2) & (MAX_EVENTS - 1)) < s->last ||
-               (s->first & (MAX_EVENTS - 1)) > s->last) { /* if there still is an event */
+    else if (s->count * 3 - s->read_pos > 2) { /* if there still is an event */
         qemu_irq_lower(s->irq);
         qemu_irq_raise(s->irq);
     }
@@ -185,6 +297,54 @@ static unsigned dequeue_event(events_state *s)
     return n;
 }
 
+/* Write as many queued events as possible to the guest buffer, and return
+ * their number. A partially read event is sent again from the start. */
+static uint32_t dequeue_batch(events_state *s)
+{
+    BatchEvent batch[64];
+    hwaddr addr = ((uint64_t)s->buffer_high << 32) | s->buffer_low;
+    uint32_t max = s->buffer_size / sizeof(BatchEvent);
+    uint32_t done = 0;
+
+    if (max > MAX_BATCH_EVENTS)
+        max = MAX_BATCH_EVENTS;
+
+    s->read_pos = 0;
+    while (done < max && s->count > 0) {
+        unsigned n = 0;
+
+        while (n < ARRAY_SIZE(batch) && done + n < max && s->count > 0) {
+            QueuedEvent *ev = queue_at(s, 0);
+            int64_t us = ev->time / 1000;
+
+            batch[n].sec = cpu_to_le32((uint32_t)(us / 1000000));
+            batch[n].usec = cpu_to_le32((uint32_t)(us % 1000000));
+            batch[n].type = cpu_to_le16(ev->type);
+            batch[n].code = cpu_to_le16(ev->code);
+            batch[n].value = cpu_to_le32(ev->value);
+            s->first = (s->first + 1) & (s->capacity - 1);
+            s->count--;
+            n++;
+        }
+        cpu_physical_memory_write(addr, (const uint8_t*)batch,
+                                  n * sizeof(batch[0]));
+        addr += n * sizeof(batch[0]);
+        done += n;
+    }
+
+    if (s->count == 0) {
+        qemu_irq_lower(s->irq);
+    }
+#ifdef TARGET_I386
+    /* See dequeue_event() */
+    else {
+        qemu_irq_lower(s->irq);
+        qemu_irq_raise(s->irq);
+    }
+#endif
+    return done;
+}
+
 static int get_page_len(events_state *s)
 {
     int page = s->page;
@@ -236,6 +396,16 @@ static uint32_t events_read(void *x, hwaddr off)
         return dequeue_event(s);
     else if (offset == REG_LEN)
         return get_page_len(s);
+    else if (offset == REG_FEATURES)
+        return FEATURE_BATCH;
+    else if (offset == REG_BUFFER_LOW)
+        return s->buffer_low;
+    else if (offset == REG_BUFFER_HIGH)
+        return s->buffer_high;
+    else if (offset == REG_BUFFER_SIZE)
+        return s->buffer_size;
+    else if (offset == REG_BUFFER_READ)
+        return dequeue_batch(s);
     else if (offset >= REG_DATA)
         return get_page_data(s, offset - REG_DATA);
     return 0; // this shouldn't happen, if the driver does the right thing
@@ -247,6 +417,12 @@ static void events_write(void *x, hwaddr off, uint32_t val)
     int offset = off; // - s->base;
     if (offset == REG_SET_PAGE)
         s->page = val;
+    else if (offset == REG_BUFFER_LOW)
+        s->buffer_low = val;
+    else if (offset == REG_BUFFER_HIGH)
+        s->buffer_high = val;
+    else if (offset == REG_BUFFER_SIZE)
+        s->buffer_size = val;
 }
 
 static CPUReadMemoryFunc *events_readfn[] = {
@@ -529,7 +705,8 @@ void events_dev_init(uint32_t base, qemu_irq irq)
     s->irq = irq;
 
     s->first = 0;
-    s->last = 0;
+    s->count = 0;
+    events_reserve(s, MIN_EVENTS);
     s->state = STATE_INIT;
     s->name = g_strdup(config->hw_keyboard_charmap);
 
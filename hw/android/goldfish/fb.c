@@ -612,6 +612,7 @@ static void goldfish_fb_write(void *opaque, hwaddr offset,
                 //printf("FB_SET_BASE: need resize (rotation=%d)\n", s->rotation );
                 dpy_resize(s->ds);
             }
+            dpy_kick_refresh(s->ds);
             } break;
         case FB_SET_ROTATION:
             //printf( "FB_SET_ROTATION %d\n", val);
@@ -620,6 +621,7 @@ static void goldfish_fb_write(void *opaque, hwaddr offset,
         case FB_SET_BLANK:
             s->blank = val;
             s->need_update = 1;
+            dpy_kick_refresh(s->ds);
             break;
         default:
             cpu_abort(cpu_single_env,
@@ -66,6 +66,11 @@ typedef struct {
     uint32_t   erase_size;   /* size of the data buffer mentioned above */
     uint64_t   max_size;     /* Capacity limit for the image. The actual underlying
                               * file may be smaller. */
+    int        init_fd;      /* Initial image that holds the content of erase
+                              * blocks not written yet, or -1. */
+    uint64_t   init_size;    /* size of the initial image */
+    uint8_t*   init_map;     /* one bit per erase block of the initial image, set
+                              * once the block is copied to |fd| */
 } nand_dev;
 
 nand_threshold    android_nand_write_threshold;
@@ -214,6 +219,83 @@ static int  do_ftruncate(int  fd, size_t  size)
     return ret;
 }
 
+/* Copy-on-write of the initial image.
+ *
+ * When a device is initialized from an 'initfile' into a temporary file,
+ * the initial image is not copied. Erase blocks are read from it until the
+ * guest writes to them, at which point they are copied to the temporary
+ * file. Clean blocks of a system image thus remain shared through the host
+ * page cache between all emulators that use the same image, and startup
+ * doesn't need to copy the whole image.
+ */
+
+/* Return 1 if the erase block that contains |addr| is still read from the
+ * initial image, 0 if it is read from |dev->fd|. */
+static int  nand_dev_block_is_init(nand_dev *dev, uint64_t addr)
+{
+    uint64_t block = addr / dev->erase_size;
+
+    if (dev->init_fd < 0 || addr >= dev->init_size)
+        return 0;
+    return !(dev->init_map[block >> 3] & (1 << (block & 7)));
+}
+
+/* Read |len| bytes at |addr| into |buf|, where the range doesn't cross an
+ * erase block boundary. Bytes past the end of the image read as 0xff.
+ * Return the number of bytes read from the image. */
+static size_t  nand_dev_read_block(nand_dev *dev, uint8_t *buf, uint64_t addr,
+                                   size_t len)
+{
+    int fd = nand_dev_block_is_init(dev, addr) ? dev->init_fd : dev->fd;
+    int ret = 0;
+
+    if (do_lseek(fd, addr, SEEK_SET) != -1) {
+        ret = do_read(fd, buf, len);
+        if (ret < 0)
+            ret = 0;
+    }
+    if (ret < len)
+        memset(buf + ret, 0xff, len - ret);
+    return ret;
+}
+
+/* Copy the erase blocks of the initial image that intersect the range
+ * [addr..addr+len) to |dev->fd| before they are modified. Uses |dev->data|
+ * as a temporary buffer. Return 0 on success, -1 on error. */
+static int  nand_dev_unshare(nand_dev *dev, uint64_t addr, uint64_t len)
+{
+    uint64_t start = addr - addr % dev->erase_size;
+    uint64_t end = addr + len;
+
+    for (addr = start; addr < end; addr += dev->erase_size) {
+        uint64_t block = addr / dev->erase_size;
+        size_t read_len;
+
+        if (!nand_dev_block_is_init(dev, addr))
+            continue;
+        read_len = nand_dev_read_block(dev, dev->data, addr, dev->erase_size);
+        if (do_lseek(dev->fd, addr, SEEK_SET) == -1 ||
+            do_write(dev->fd, dev->data, read_len) != read_len) {
+            XLOG("%s, write failed: %s\n", __FUNCTION__, strerror(errno));
+            return -1;
+        }
+        dev->init_map[block >> 3] |= 1 << (block & 7);
+    }
+    return 0;
+}
+
+/* Stop using the initial image, e.g. once |dev->fd| was overwritten with
+ * the full content of the device. */
+static void  nand_dev_drop_init(nand_dev *dev)
+{
+    if (dev->init_fd >= 0) {
+        close(dev->init_fd);
+        dev->init_fd = -1;
+        free(dev->init_map);
+        dev->init_map = NULL;
+    }
+}
+
 #define NAND_DEV_SAVE_DISK_BUF_SIZE 2048
 
 
@@ -243,17 +325,16 @@ static void  nand_dev_save_disk_state(QEMUFile *f, nand_dev *dev)
     const uint64_t total_size = lseek_ret;
     qemu_put_be64(f, total_size);
 
-    /* copy all data from the stream to the stored image */
-    lseek_ret = do_lseek(dev->fd, 0, SEEK_SET);
-    if (lseek_ret == -1) {
-        qemu_file_set_error(f, -errno);
-        XLOG("%s seek failed: %s\n", __FUNCTION__, strerror(errno));
-        return;
-    }
-    do {
-        ret = do_read(dev->fd, buffer, buf_size);
-        if (ret < 0) {
-            qemu_file_set_error(f, -errno);
+    /* copy all data from the stored image to the stream */
+    while (total_copied < total_size && total_copied < dev->max_size) {
+        ret = buf_size;
+        if (total_size - total_copied < ret)
+            ret = total_size - total_copied;
+        /* don't cross erase blocks, which can come from different files */
+        if (dev->erase_size - total_copied % dev->erase_size < ret)
+            ret = dev->erase_size - total_copied % dev->erase_size;
+        if (nand_dev_read_block(dev, buffer, total_copied, ret) != ret) {
+            qemu_file_set_error(f, -EIO);
             XLOG("%s read failed: %s\n", __FUNCTION__, strerror(errno));
             return;
         }
@@ -261,7 +342,6 @@ static void  nand_dev_save_disk_state(QEMUFile *f, nand_dev *dev)
 
         total_copied += ret;
     }
-    while (ret == buf_size && total_copied < dev->max_size);
 
     /* TODO Maybe check that we've written total_size bytes */
 }
@@ -332,6 +412,8 @@ static int  nand_dev_load_disk_state(QEMUFile *f, nand_dev *dev)
         return -EIO;
     }
 
+    /* |dev->fd| now holds the full content of the device. */
+    nand_dev_drop_init(dev);
     return 0;
 }
 
@@ -388,25 +470,19 @@ static int   nand_dev_controller_state_load(QEMUFile *f, void  *opaque, int  ver
 static uint32_t nand_dev_read_file(nand_dev *dev, target_ulong data, uint64_t addr, uint32_t total_len)
 {
     uint32_t len = total_len;
-    size_t read_len = dev->erase_size;
-    int eof = 0;
+    size_t read_len;
 
     NAND_UPDATE_READ_THRESHOLD(total_len);
 
-    do_lseek(dev->fd, addr, SEEK_SET);
     while(len > 0) {
-        if(read_len < dev->erase_size) {
-            memset(dev->data, 0xff, dev->erase_size);
-            read_len = dev->erase_size;
-            eof = 1;
-        }
+        /* don't cross erase blocks, which can come from different files */
+        read_len = dev->erase_size - addr % dev->erase_size;
         if(len < read_len)
             read_len = len;
-        if(!eof) {
-            read_len = do_read(dev->fd, dev->data, read_len);
-        }
+        nand_dev_read_block(dev, dev->data, addr, read_len);
         safe_memory_rw_debug(current_cpu, data, dev->data, read_len, 1);
         data += read_len;
+        addr += read_len;
         len -= read_len;
     }
     return total_len;
@@ -420,6 +496,8 @@ static uint32_t nand_dev_write_file(nand_dev *dev, target_ulong data, uint64_t a
 
     NAND_UPDATE_WRITE_THRESHOLD(total_len);
 
+    if (nand_dev_unshare(dev, addr, total_len) < 0)
+        return 0;
     do_lseek(dev->fd, addr, SEEK_SET);
     while(len > 0) {
         if(len < write_len)
@@ -442,6 +520,8 @@ static uint32_t nand_dev_erase_file(nand_dev *dev, uint64_t addr, uint32_t total
     size_t write_len = dev->erase_size;
     int ret;
 
+    if (nand_dev_unshare(dev, addr, total_len) < 0)
+        return 0;
     do_lseek(dev->fd, addr, SEEK_SET);
     memset(dev->data, 0xff, dev->erase_size);
     while(len > 0) {
@@ -728,6 +808,7 @@ void nand_add_dev(const char *arg)
     char *rwfilename = NULL;
     int initfd = -1;
     int rwfd = -1;
+    int rw_is_temp = 0;
     int read_only = 0;
     int pad;
     ssize_t read_size;
@@ -837,6 +918,7 @@ void nand_add_dev(const char *arg)
             exit(1);
         }
         rwfilename = (char*) tempfile_path(tmp);
+        rw_is_temp = 1;
         if (VERBOSE_CHECK(init))
             dprint( "mapping '%.*s' NAND image to %s", devname_len, devname, rwfilename);
     }
@@ -901,7 +983,25 @@ void nand_add_dev(const char *arg)
 #ifdef TARGET_I386
     dev->flags |= NAND_DEV_FLAG_BATCH_CAP;
 #endif
-
+    dev->init_fd = -1;
+    dev->init_size = 0;
+    dev->init_map = NULL;
+
+    if (initfd >= 0 && rw_is_temp) {
+        /* Nothing else uses the temporary file, so the initial image can
+         * be copied lazily, see nand_dev_unshare(). */
+        dev->init_size = do_lseek(initfd, 0, SEEK_END);
+        dev->init_map = calloc(1, (MAX(dev_size, dev->init_size) /
+                                   dev->erase_size + 8) / 8);
+        if (dev->init_map == NULL)
+            goto out_of_memory;
+        if (do_ftruncate(rwfd, dev->init_size) < 0) {
+            XLOG("could not resize file %s, %s\n", rwfilename, strerror(errno));
+            exit(1);
+        }
+        dev->init_fd = initfd;
+        initfd = -1;
+    }
     if (initfd >= 0) {
         do {
             read_size = do_read(initfd, dev->data, dev->erase_size);
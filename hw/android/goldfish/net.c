@@ -0,0 +1,649 @@
+/* Copyright (C) 2015 The Android Open Source Project
+**
+** This software is licensed under the terms of the GNU General Public
+** License version 2, as published by the Free Software Foundation, and
+** may be copied, distributed, and modified under those terms.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+*/
+
+/* Goldfish paravirtual network device.
+ *
+ * Unlike the smc91c111 / ne2000 NICs, which move each packet through
+ * I/O registers, this device exchanges frames through two descriptor rings
+ * in guest memory, so a single doorbell write can transmit many frames,
+ * and received frames are written directly into guest buffers.
+ *
+ * See docs/GOLDFISH-VIRTUAL-HARDWARE.TXT for the guest-visible interface.
+ */
+
+#include "cpu.h"
+#include "migration/qemu-file.h"
+#include "hw/android/goldfish/device.h"
+#include "hw/hw.h"
+#include "net/net.h"
+#include "qemu/timer.h"
+
+#include <string.h>
+
+enum {
+    /* interrupt status, reading it clears it and lowers the IRQ */
+    NET_INT_STATUS      = 0x00,
+    /* set this to enable IRQs */
+    NET_INT_ENABLE      = 0x04,
+    /* MAC address, read-only */
+    NET_MAC_LOW         = 0x08,
+    NET_MAC_HIGH        = 0x0c,
+    /* device control, see NET_CTRL_XXX below */
+    NET_CONTROL         = 0x10,
+    /* supported features, read-only, see NET_FEATURE_XXX below */
+    NET_FEATURES        = 0x14,
+
+    /* transmit ring: guest-physical address, number of descriptors,
+     * producer index (written by the guest) and consumer index (written
+     * by the device). */
+    NET_TX_RING_LOW     = 0x18,
+    NET_TX_RING_HIGH    = 0x1c,
+    NET_TX_RING_SIZE    = 0x20,
+    NET_TX_HEAD         = 0x24,
+    NET_TX_TAIL         = 0x28,
+
+    /* receive ring, same layout as the transmit one */
+    NET_RX_RING_LOW     = 0x2c,
+    NET_RX_RING_HIGH    = 0x30,
+    NET_RX_RING_SIZE    = 0x34,
+    NET_RX_HEAD         = 0x38,
+    NET_RX_TAIL         = 0x3c,
+
+    /* interrupt coalescing parameters */
+    NET_IRQ_DELAY_US    = 0x40,
+    NET_IRQ_FRAMES      = 0x44,
+
+    NET_INT_RX          = 1U << 0,
+    NET_INT_TX          = 1U << 1,
+    NET_INT_ERROR       = 1U << 2,  /* a producer index was rejected */
+    NET_INT_MASK        = NET_INT_RX | NET_INT_TX | NET_INT_ERROR,
+
+    NET_CTRL_RX_ENABLE  = 1U << 0,
+    NET_CTRL_TX_ENABLE  = 1U << 1,
+    NET_CTRL_RESET      = 1U << 31,
+
+    NET_FEATURE_TX_CSUM = 1U << 0,
+    NET_FEATURE_RX_CSUM = 1U << 1,
+    NET_FEATURE_SG      = 1U << 2,
+    NET_FEATURES_ALL    = NET_FEATURE_TX_CSUM |
+                          NET_FEATURE_RX_CSUM |
+                          NET_FEATURE_SG,
+
+    /* descriptor flags */
+    NET_DESC_MORE       = 1U << 0,  /* frame continues in next descriptor */
+    NET_DESC_CSUM       = 1U << 1,  /* TX: compute TCP/UDP checksum */
+    NET_DESC_CSUM_OK    = 1U << 2,  /* RX: checksum already verified */
+    NET_DESC_ERROR      = 1U << 30, /* TX: frame was dropped */
+    NET_DESC_DONE       = 1U << 31, /* set by the device when done */
+};
+
+/* Each descriptor is 16 bytes, in little-endian order:
+ *
+ *   0x00  uint64_t  address   guest-physical buffer address
+ *   0x08  uint32_t  length    TX: fragment size
+ *                             RX: buffer size in, bytes written out
+ *   0x0c  uint32_t  flags     NET_DESC_XXX
+ */
+#define NET_DESC_SIZE       16
+#define NET_DESC_LENGTH     8
+#define NET_DESC_FLAGS      12
+
+/* maximum number of descriptors in a ring, must be a power of 2 */
+#define NET_MAX_RING_SIZE   4096
+
+/* maximum number of fragments in a single transmitted frame */
+#define NET_MAX_FRAGS       32
+
+/* maximum size of a single frame */
+#define NET_MAX_FRAME_SIZE  65536
+
+struct goldfish_net_ring {
+    uint64_t address;
+    uint32_t size;
+    uint32_t head;   /* producer index, free-running */
+    uint32_t tail;   /* consumer index, free-running */
+};
+
+struct goldfish_net_state {
+    struct goldfish_device dev;
+    VLANClientState* vc;
+    uint8_t macaddr[6];
+
+    uint32_t int_status;
+    uint32_t int_enable;
+    uint32_t control;
+
+    struct goldfish_net_ring tx;
+    struct goldfish_net_ring rx;
+
+    /* interrupt coalescing: an IRQ is raised once |irq_frames| frames
+     * were completed, or |irq_delay_us| after the first completion,
+     * whichever comes first. A delay of 0 disables coalescing. */
+    uint32_t irq_delay_us;
+    uint32_t irq_frames;
+    uint32_t pending_frames;
+    QEMUTimer* irq_timer;
+
+    /* the fields below are not saved to snapshots */
+    uint8_t* frame_buf;
+};
+
+/* update this each time you update the goldfish_net_state struct */
+#define  NET_STATE_SAVE_VERSION  1
+
+static void goldfish_net_ring_save(QEMUFile* f, struct goldfish_net_ring* r)
+{
+    qemu_put_be64(f, r->address);
+    qemu_put_be32(f, r->size);
+    qemu_put_be32(f, r->head);
+    qemu_put_be32(f, r->tail);
+}
+
+static void goldfish_net_ring_load(QEMUFile* f, struct goldfish_net_ring* r)
+{
+    r->address = qemu_get_be64(f);
+    r->size = qemu_get_be32(f);
+    r->head = qemu_get_be32(f);
+    r->tail = qemu_get_be32(f);
+    /* see goldfish_net_set_head() */
+    if (r->head - r->tail > r->size)
+        r->head = r->tail;
+}
+
+static void goldfish_net_save(QEMUFile* f, void* opaque)
+{
+    struct goldfish_net_state* s = opaque;
+
+    qemu_put_be32(f, s->int_status);
+    qemu_put_be32(f, s->int_enable);
+    qemu_put_be32(f, s->control);
+    goldfish_net_ring_save(f, &s->tx);
+    goldfish_net_ring_save(f, &s->rx);
+    qemu_put_be32(f, s->irq_delay_us);
+    qemu_put_be32(f, s->irq_frames);
+    qemu_put_be32(f, s->pending_frames);
+    timer_put(f, s->irq_timer);
+}
+
+static int goldfish_net_load(QEMUFile* f, void* opaque, int version_id)
+{
+    struct goldfish_net_state* s = opaque;
+
+    if (version_id != NET_STATE_SAVE_VERSION)
+        return -1;
+
+    s->int_status = qemu_get_be32(f);
+    s->int_enable = qemu_get_be32(f);
+    s->control = qemu_get_be32(f);
+    goldfish_net_ring_load(f, &s->tx);
+    goldfish_net_ring_load(f, &s->rx);
+    s->irq_delay_us = qemu_get_be32(f);
+    s->irq_frames = qemu_get_be32(f);
+    s->pending_frames = qemu_get_be32(f);
+    timer_get(f, s->irq_timer);
+
+    goldfish_device_set_irq(&s->dev, 0,
+                            (s->int_status & s->int_enable) != 0);
+    return 0;
+}
+
+static hwaddr goldfish_net_desc_addr(struct goldfish_net_ring* r,
+                                     uint32_t index)
+{
+    return r->address + (hwaddr)(index & (r->size - 1)) * NET_DESC_SIZE;
+}
+
+static int goldfish_net_ring_valid(struct goldfish_net_ring* r)
+{
+    return r->address != 0 && r->size != 0;
+}
+
+/* Set the producer index of |r| written by the guest. The ring can't hold
+ * more than |size| pending descriptors, so a larger head is rejected and
+ * reported with NET_INT_ERROR, instead of letting the device walk billions
+ * of descriptors. Returns 0 on success, -1 otherwise. */
+static int goldfish_net_set_head(struct goldfish_net_state* s,
+                                 struct goldfish_net_ring* r,
+                                 uint32_t head)
+{
+    if (head - r->tail > r->size) {
+        s->int_status |= NET_INT_ERROR;
+        goldfish_device_set_irq(&s->dev, 0,
+                                (s->int_status & s->int_enable) != 0);
+        return -1;
+    }
+    r->head = head;
+    return 0;
+}
+
+static void goldfish_net_raise_irq(struct goldfish_net_state* s)
+{
+    s->pending_frames = 0;
+    timer_del(s->irq_timer);
+    goldfish_device_set_irq(&s->dev, 0,
+                            (s->int_status & s->int_enable) != 0);
+}
+
+static void goldfish_net_irq_timer(void* opaque)
+{
+    goldfish_net_raise_irq(opaque);
+}
+
+/* Record that |frames| frames were completed, with interrupt status bit
+ * |flag|, then raise the IRQ now or later depending on coalescing. */
+static void goldfish_net_complete(struct goldfish_net_state* s,
+                                  uint32_t flag,
+                                  uint32_t frames)
+{
+    if (frames == 0)
+        return;
+
+    s->int_status |= flag;
+    s->pending_frames += frames;
+
+    if (s->irq_delay_us == 0 ||
+        (s->irq_frames != 0 && s->pending_frames >= s->irq_frames)) {
+        goldfish_net_raise_irq(s);
+    } else if (!timer_pending(s->irq_timer)) {
+        timer_mod(s->irq_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                  (int64_t)s->irq_delay_us * 1000);
+    }
+}
+
+/* Returns true if the |len| bytes at |frame| are an IPv4 TCP or UDP frame
+ * whose headers fit in it, so that net_checksum_calculate(), which trusts
+ * the guest-written lengths, doesn't read past its end. */
+static bool goldfish_net_can_checksum(const uint8_t* frame, int len)
+{
+    int ihl, ip_len, l4_len;
+
+    if (len < 14 + 20 || frame[12] != 0x08 || frame[13] != 0x00)
+        return false;
+    if ((frame[14] & 0xf0) != 0x40)
+        return false;
+    ihl = (frame[14] & 0x0f) * 4;
+    ip_len = (frame[16] << 8) | frame[17];
+    if (ihl < 20 || ip_len < ihl || 14 + ip_len > len)
+        return false;
+    switch (frame[23]) {
+    case 6:  l4_len = 20; break;  /* TCP */
+    case 17: l4_len = 8;  break;  /* UDP */
+    default:
+        return false;
+    }
+    return 14 + ihl + l4_len <= 14 + ip_len;
+}
+
+/* Send one frame made of |count| descriptors starting at |first|.
+ * Returns 0 on success, or -1 if the frame was dropped. */
+static int goldfish_net_send_frame(struct goldfish_net_state* s,
+                                   uint32_t first,
+                                   int count,
+                                   uint32_t flags)
+{
+    struct iovec iov[NET_MAX_FRAGS];
+    hwaddr addr[NET_MAX_FRAGS];
+    uint32_t len[NET_MAX_FRAGS];
+    int mapped = 0;
+    int total = 0;
+    int n;
+
+    for (n = 0; n < count; n++) {
+        hwaddr desc = goldfish_net_desc_addr(&s->tx, first + n);
+
+        addr[n] = ldq_le_phys(desc);
+        len[n] = ldl_le_phys(desc + NET_DESC_LENGTH);
+        if (len[n] > NET_MAX_FRAME_SIZE - total)
+            return -1;
+        total += len[n];
+    }
+
+    if (!(flags & NET_DESC_CSUM)) {
+        /* Try to send directly from guest memory, this only fails if
+         * one of the fragments is not in RAM. */
+        for (; mapped < count; mapped++) {
+            hwaddr plen = len[mapped];
+
+            iov[mapped].iov_base = cpu_physical_memory_map(addr[mapped],
+                                                           &plen, 0);
+            iov[mapped].iov_len = len[mapped];
+            if (!iov[mapped].iov_base)
+                break;
+            if (plen != len[mapped]) {
+                cpu_physical_memory_unmap(iov[mapped].iov_base, plen, 0, 0);
+                break;
+            }
+        }
+        if (mapped == count)
+            qemu_sendv_packet(s->vc, iov, count);
+        for (n = 0; n < mapped; n++)
+            cpu_physical_memory_unmap(iov[n].iov_base, len[n], 0, len[n]);
+        if (mapped == count)
+            return 0;
+    }
+
+    /* Copy the frame into a linear buffer, then checksum it if needed */
+    total = 0;
+    for (n = 0; n < count; n++) {
+        cpu_physical_memory_read(addr[n], s->frame_buf + total, len[n]);
+        total += len[n];
+    }
+    /* frames that don't have a valid TCP or UDP header are sent as is */
+    if ((flags & NET_DESC_CSUM) &&
+        goldfish_net_can_checksum(s->frame_buf, total)) {
+        net_checksum_calculate(s->frame_buf, total);
+    }
+    qemu_send_packet(s->vc, s->frame_buf, total);
+    return 0;
+}
+
+/* Process all pending descriptors of the transmit ring */
+static void goldfish_net_tx(struct goldfish_net_state* s)
+{
+    uint32_t frames = 0;
+
+    if (!(s->control & NET_CTRL_TX_ENABLE) || !goldfish_net_ring_valid(&s->tx))
+        return;
+
+    while (s->tx.tail != s->tx.head) {
+        uint32_t first = s->tx.tail;
+        uint32_t avail = s->tx.head - first;
+        uint32_t flags = 0;
+        uint32_t desc_flags;
+        uint32_t count = 0;
+        uint32_t done = NET_DESC_DONE;
+        uint32_t n;
+
+        /* find the end of the frame */
+        do {
+            if (count == avail) {
+                /* incomplete frame, wait for the guest to queue the rest */
+                goto exit;
+            }
+            desc_flags = ldl_le_phys(
+                    goldfish_net_desc_addr(&s->tx, first + count) +
+                    NET_DESC_FLAGS);
+            flags |= desc_flags;
+            count++;
+        } while (desc_flags & NET_DESC_MORE);
+
+        if (count > NET_MAX_FRAGS ||
+            goldfish_net_send_frame(s, first, count, flags) < 0) {
+            done |= NET_DESC_ERROR;
+        }
+
+        /* hand the descriptors back to the guest */
+        for (n = 0; n < count; n++) {
+            hwaddr desc = goldfish_net_desc_addr(&s->tx, first + n) +
+                          NET_DESC_FLAGS;
+            stl_le_phys(desc, ldl_le_phys(desc) | done);
+        }
+        s->tx.tail = first + count;
+        frames++;
+    }
+exit:
+    goldfish_net_complete(s, NET_INT_TX, frames);
+}
+
+static int goldfish_net_can_receive(VLANClientState* vc)
+{
+    struct goldfish_net_state* s = vc->opaque;
+
+    return (s->control & NET_CTRL_RX_ENABLE) &&
+           goldfish_net_ring_valid(&s->rx) &&
+           s->rx.tail != s->rx.head;
+}
+
+static ssize_t goldfish_net_receive(VLANClientState* vc,
+                                    const uint8_t* buf,
+                                    size_t size)
+{
+    struct goldfish_net_state* s = vc->opaque;
+    uint32_t index = s->rx.tail;
+    size_t offset = 0;
+    size_t capacity = 0;
+
+    if (!goldfish_net_can_receive(vc))
+        return -1;
+
+    /* Check that the posted buffers are large enough first, since a frame
+     * can't be partially received. */
+    while (capacity < size) {
+        if (index == s->rx.head) {
+            return -1;  /* drop it */
+        }
+        capacity += ldl_le_phys(goldfish_net_desc_addr(&s->rx, index) +
+                                NET_DESC_LENGTH);
+        index++;
+    }
+
+    index = s->rx.tail;
+    while (offset < size) {
+        hwaddr desc = goldfish_net_desc_addr(&s->rx, index);
+        size_t len = ldl_le_phys(desc + NET_DESC_LENGTH);
+        uint32_t flags = NET_DESC_DONE | NET_DESC_CSUM_OK;
+
+        if (len > size - offset)
+            len = size - offset;
+        cpu_physical_memory_write(ldq_le_phys(desc), buf + offset, len);
+        offset += len;
+        if (offset < size)
+            flags |= NET_DESC_MORE;
+        stl_le_phys(desc + NET_DESC_LENGTH, len);
+        stl_le_phys(desc + NET_DESC_FLAGS, flags);
+        index++;
+    }
+    s->rx.tail = index;
+
+    goldfish_net_complete(s, NET_INT_RX, 1);
+    return size;
+}
+
+static void goldfish_net_reset(struct goldfish_net_state* s)
+{
+    s->int_status = 0;
+    s->int_enable = 0;
+    s->control = 0;
+    memset(&s->tx, 0, sizeof(s->tx));
+    memset(&s->rx, 0, sizeof(s->rx));
+    s->irq_delay_us = 0;
+    s->irq_frames = 0;
+    s->pending_frames = 0;
+    timer_del(s->irq_timer);
+    goldfish_device_set_irq(&s->dev, 0, 0);
+}
+
+static uint32_t goldfish_net_read(void* opaque, hwaddr offset)
+{
+    struct goldfish_net_state* s = opaque;
+    uint32_t ret;
+
+    switch (offset) {
+    case NET_INT_STATUS:
+        ret = s->int_status & s->int_enable;
+        if (ret) {
+            goldfish_device_set_irq(&s->dev, 0, 0);
+            s->int_status = 0;
+        }
+        return ret;
+    case NET_INT_ENABLE:
+        return s->int_enable;
+    case NET_MAC_LOW:
+        return s->macaddr[0] | (s->macaddr[1] << 8) |
+               (s->macaddr[2] << 16) | ((uint32_t)s->macaddr[3] << 24);
+    case NET_MAC_HIGH:
+        return s->macaddr[4] | (s->macaddr[5] << 8);
+    case NET_CONTROL:
+        return s->control;
+    case NET_FEATURES:
+        return NET_FEATURES_ALL;
+    case NET_TX_RING_LOW:
+        return (uint32_t)s->tx.address;
+    case NET_TX_RING_HIGH:
+        return (uint32_t)(s->tx.address >> 32);
+    case NET_TX_RING_SIZE:
+        return s->tx.size;
+    case NET_TX_HEAD:
+        return s->tx.head;
+    case NET_TX_TAIL:
+        return s->tx.tail;
+    case NET_RX_RING_LOW:
+        return (uint32_t)s->rx.address;
+    case NET_RX_RING_HIGH:
+        return (uint32_t)(s->rx.address >> 32);
+    case NET_RX_RING_SIZE:
+        return s->rx.size;
+    case NET_RX_HEAD:
+        return s->rx.head;
+    case NET_RX_TAIL:
+        return s->rx.tail;
+    case NET_IRQ_DELAY_US:
+        return s->irq_delay_us;
+    case NET_IRQ_FRAMES:
+        return s->irq_frames;
+    default:
+        cpu_abort(cpu_single_env,
+                  "goldfish_net_read: Bad offset %" HWADDR_PRIx "\n",
+                  offset);
+        return 0;
+    }
+}
+
+static uint32_t goldfish_net_ring_size(uint32_t val)
+{
+    /* must be a power of 2 */
+    if (val > NET_MAX_RING_SIZE || (val & (val - 1)) != 0)
+        return 0;
+    return val;
+}
+
+static void goldfish_net_write(void* opaque, hwaddr offset, uint32_t val)
+{
+    struct goldfish_net_state* s = opaque;
+
+    switch (offset) {
+    case NET_INT_ENABLE:
+        s->int_enable = val & NET_INT_MASK;
+        goldfish_device_set_irq(&s->dev, 0,
+                                (s->int_status & s->int_enable) != 0);
+        break;
+    case NET_CONTROL:
+        if (val & NET_CTRL_RESET) {
+            goldfish_net_reset(s);
+            break;
+        }
+        s->control = val;
+        goldfish_net_tx(s);
+        if (goldfish_net_can_receive(s->vc))
+            qemu_flush_queued_packets(s->vc);
+        break;
+    case NET_TX_RING_LOW:
+        uint64_set_low(&s->tx.address, val);
+        break;
+    case NET_TX_RING_HIGH:
+        uint64_set_high(&s->tx.address, val);
+        break;
+    case NET_TX_RING_SIZE:
+        s->tx.size = goldfish_net_ring_size(val);
+        s->tx.head = s->tx.tail = 0;
+        break;
+    case NET_TX_HEAD:
+        /* doorbell */
+        if (goldfish_net_set_head(s, &s->tx, val) == 0)
+            goldfish_net_tx(s);
+        break;
+    case NET_RX_RING_LOW:
+        uint64_set_low(&s->rx.address, val);
+        break;
+    case NET_RX_RING_HIGH:
+        uint64_set_high(&s->rx.address, val);
+        break;
+    case NET_RX_RING_SIZE:
+        s->rx.size = goldfish_net_ring_size(val);
+        s->rx.head = s->rx.tail = 0;
+        break;
+    case NET_RX_HEAD:
+        /* new receive buffers were posted */
+        if (goldfish_net_set_head(s, &s->rx, val) == 0 &&
+            goldfish_net_can_receive(s->vc))
+            qemu_flush_queued_packets(s->vc);
+        break;
+    case NET_IRQ_DELAY_US:
+        s->irq_delay_us = val;
+        break;
+    case NET_IRQ_FRAMES:
+        s->irq_frames = val;
+        break;
+    default:
+        cpu_abort(cpu_single_env,
+                  "goldfish_net_write: Bad offset %" HWADDR_PRIx "\n",
+                  offset);
+    }
+}
+
+static CPUReadMemoryFunc *goldfish_net_readfn[] = {
+    goldfish_net_read,
+    goldfish_net_read,
+    goldfish_net_read
+};
+
+static CPUWriteMemoryFunc *goldfish_net_writefn[] = {
+    goldfish_net_write,
+    goldfish_net_write,
+    goldfish_net_write
+};
+
+static void goldfish_net_cleanup(VLANClientState* vc)
+{
+    struct goldfish_net_state* s = vc->opaque;
+
+    timer_del(s->irq_timer);
+    timer_free(s->irq_timer);
+    g_free(s->frame_buf);
+    s->vc = NULL;
+}
+
+void goldfish_net_init(NICInfo* nd, int id)
+{
+    struct goldfish_net_state* s;
+
+    s = (struct goldfish_net_state*)g_malloc0(sizeof(*s));
+    s->dev.name = "goldfish_net";
+    s->dev.id = id;
+    s->dev.base = 0;    // will be allocated dynamically
+    s->dev.size = 0x1000;
+    s->dev.irq_count = 1;
+
+    memcpy(s->macaddr, nd->macaddr, sizeof(s->macaddr));
+    s->irq_timer = timer_new(QEMU_CLOCK_VIRTUAL, SCALE_NS,
+                             goldfish_net_irq_timer, s);
+    s->frame_buf = g_malloc(NET_MAX_FRAME_SIZE);
+
+    goldfish_device_add(&s->dev, goldfish_net_readfn, goldfish_net_writefn, s);
+
+    s->vc = qemu_new_vlan_client(nd->vlan, nd->model, nd->name,
+                                 goldfish_net_can_receive,
+                                 goldfish_net_receive,
+                                 NULL,
+                                 goldfish_net_cleanup,
+                                 s);
+    qemu_format_nic_info_str(s->vc, s->macaddr);
+
+    register_savevm(NULL,
+                    "goldfish_net",
+                    id,
+                    NET_STATE_SAVE_VERSION,
+                    goldfish_net_save,
+                    goldfish_net_load,
+                    s);
+}
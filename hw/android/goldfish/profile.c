@@ -12,7 +12,10 @@
 
 #include "hw/android/goldfish/profile.h"
 #include "exec/code-profile.h"
+#include "exec/hax.h"
 #include "cpu.h"
+#include "qemu/timer.h"
+#include "sysemu/kvm.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -177,8 +180,11 @@ static void add_range_count(BinaryProfile *profile, target_ulong start,
   profile->range = r;
 }
 
-static const MmapData *get_mmap_data(target_ulong pc, int pid) {
-  const MmapData *data = mmaps[pid];
+static const MmapData *get_mmap_data(target_ulong pc, unsigned pid) {
+  const MmapData *data;
+  if (pid >= ARRAY_SIZE(mmaps))
+    return NULL;
+  data = mmaps[pid];
   while (data) {
     if (pc >= data->start && pc < data->end) {
       return data;
@@ -188,6 +194,14 @@ static const MmapData *get_mmap_data(target_ulong pc, int pid) {
   return NULL;
 }
 
+const char *profile_get_binary(target_ulong pc, target_ulong *offset) {
+  const MmapData *data = get_mmap_data(pc, get_current_pid());
+  if (data == NULL)
+    return NULL;
+  *offset = pc - data->start + data->offset;
+  return data->name;
+}
+
 void record_mmap(target_ulong vstart, target_ulong vend, target_ulong offset,
                  const char *path, unsigned pid) {
   MmapData *data = (MmapData *)malloc(sizeof(MmapData));
@@ -257,3 +271,181 @@ void profile_bb_helper(target_ulong pc, uint32_t size) {
     prev_pc = pc + size;
   }
 }
+
+/* Sampling profiler for -guest-profile.
+ *
+ * Unlike profile_bb_helper(), this doesn't instrument translated code. A
+ * timer on the virtual clock reads the PC of the emulated CPU, which is
+ * where cpu_exec() returned to the main loop because a host timer expired.
+ * Samples are aggregated per (binary, file offset) using the mmap data
+ * reported by the trace device, or per PC for the kernel and unknown code,
+ * and written as a pprof CPU profile: each binary gets its own region of a
+ * synthetic address space, described in the memory map at the end of the
+ * file, so that pprof can symbolize the samples with the guest binaries.
+ */
+
+#define GUEST_PROFILE_PERIOD_MS   10
+/* write the profile every minute, in case the emulator is killed */
+#define GUEST_PROFILE_DUMP_TICKS  6000
+
+typedef struct GuestSample {
+  uint64_t addr;    /* 0 for an empty slot */
+  uint64_t count;
+} GuestSample;
+
+typedef struct GuestBinary {
+  char *name;
+  uint64_t size;    /* largest sampled file offset + 1 */
+} GuestBinary;
+
+static const char *guest_profile_file;
+static QEMUTimer *guest_profile_timer;
+static GuestSample *guest_samples;
+static size_t guest_samples_capacity;
+static size_t guest_samples_count;
+static GuestBinary *guest_binaries;
+static int guest_binaries_count;
+static uint64_t guest_profile_ticks;
+
+/* Binaries are numbered from 1, their samples are at (index << 40). */
+#define GUEST_BINARY_SHIFT 40
+
+static int get_guest_binary(const char *name) {
+  int i;
+  for (i = 0; i < guest_binaries_count; i++) {
+    if (!strcmp(guest_binaries[i].name, name))
+      return i + 1;
+  }
+  guest_binaries = (GuestBinary *)realloc(
+      guest_binaries, (guest_binaries_count + 1) * sizeof(GuestBinary));
+  guest_binaries[i].name = strdup(name);
+  guest_binaries[i].size = 0;
+  guest_binaries_count++;
+  return i + 1;
+}
+
+static void add_guest_sample_to(GuestSample *table, size_t capacity,
+                                uint64_t addr, uint64_t count) {
+  size_t i = (size_t)((addr * 0x9e3779b97f4a7c15ULL) >> 32) & (capacity - 1);
+  while (table[i].addr != 0 && table[i].addr != addr)
+    i = (i + 1) & (capacity - 1);
+  if (table[i].addr == 0) {
+    table[i].addr = addr;
+    guest_samples_count++;
+  }
+  table[i].count += count;
+}
+
+static void add_guest_sample(uint64_t addr) {
+  /* keep the open-addressing table at most half full */
+  if (2 * (guest_samples_count + 1) > guest_samples_capacity) {
+    size_t old_capacity = guest_samples_capacity;
+    GuestSample *old = guest_samples;
+    size_t i;
+
+    guest_samples_capacity = old_capacity ? 2 * old_capacity : 4096;
+    guest_samples = (GuestSample *)calloc(guest_samples_capacity,
+                                          sizeof(GuestSample));
+    guest_samples_count = 0;
+    for (i = 0; i < old_capacity; i++) {
+      if (old[i].addr != 0)
+        add_guest_sample_to(guest_samples, guest_samples_capacity,
+                            old[i].addr, old[i].count);
+    }
+    free(old);
+  }
+  add_guest_sample_to(guest_samples, guest_samples_capacity, addr, 1);
+}
+
+static void guest_profile_dump(void) {
+  uint64_t words[5];
+  size_t i;
+  int n;
+  FILE *f;
+
+  if (guest_profile_file == NULL)
+    return;
+  f = fopen(guest_profile_file, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "guest-profile: cannot write %s\n", guest_profile_file);
+    return;
+  }
+  /* header: header words, version, sampling period in us, padding */
+  words[0] = 0;
+  words[1] = 3;
+  words[2] = 0;
+  words[3] = GUEST_PROFILE_PERIOD_MS * 1000;
+  words[4] = 0;
+  fwrite(words, sizeof(words[0]), 5, f);
+  /* records: count, stack depth, pc */
+  for (i = 0; i < guest_samples_capacity; i++) {
+    if (guest_samples[i].addr == 0)
+      continue;
+    words[0] = guest_samples[i].count;
+    words[1] = 1;
+    words[2] = guest_samples[i].addr;
+    fwrite(words, sizeof(words[0]), 3, f);
+  }
+  /* trailer */
+  words[0] = 0;
+  words[1] = 1;
+  words[2] = 0;
+  fwrite(words, sizeof(words[0]), 3, f);
+  /* memory map, in the format of /proc/<pid>/maps */
+  for (n = 0; n < guest_binaries_count; n++) {
+    uint64_t start = (uint64_t)(n + 1) << GUEST_BINARY_SHIFT;
+    fprintf(f, "%llx-%llx r-xp 00000000 00:00 0 %s\n",
+            (unsigned long long)start,
+            (unsigned long long)(start + guest_binaries[n].size),
+            guest_binaries[n].name);
+  }
+  fclose(f);
+}
+
+static void guest_profile_tick(void *opaque) {
+  CPUState *cpu;
+
+  CPU_FOREACH(cpu) {
+    CPUArchState *env = cpu->env_ptr;
+    target_ulong pc, cs_base;
+    const MmapData *data;
+    uint64_t addr;
+    int flags;
+
+    /* don't sample idle CPUs */
+    if (cpu->halted)
+      continue;
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+    data = get_mmap_data(pc, get_current_pid());
+    if (data != NULL) {
+      int index = get_guest_binary(data->name);
+      uint64_t offset = pc - data->start + data->offset;
+      if (offset >= guest_binaries[index - 1].size)
+        guest_binaries[index - 1].size = offset + 1;
+      addr = ((uint64_t)index << GUEST_BINARY_SHIFT) + offset;
+    } else {
+      addr = pc;
+    }
+    if (addr != 0)
+      add_guest_sample(addr);
+  }
+
+  if (++guest_profile_ticks % GUEST_PROFILE_DUMP_TICKS == 0)
+    guest_profile_dump();
+  timer_mod(guest_profile_timer,
+            qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + GUEST_PROFILE_PERIOD_MS);
+}
+
+void guest_profile_start(const char *filename) {
+  if (hax_enabled() || kvm_enabled()) {
+    fprintf(stderr, "guest-profile: only supported without hardware "
+            "acceleration, ignored\n");
+    return;
+  }
+  guest_profile_file = filename;
+  guest_profile_timer = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+                                     guest_profile_tick, NULL);
+  timer_mod(guest_profile_timer,
+            qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + GUEST_PROFILE_PERIOD_MS);
+  atexit(guest_profile_dump);
+}
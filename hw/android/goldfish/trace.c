@@ -20,6 +20,7 @@
 #include "sysemu/sysemu.h"
 #include "exec/softmmu_exec.h"
 #include "exec/code-profile.h"
+#include "exec/exec-all.h"
 
 /* Set to 1 to debug tracing */
 #define DEBUG   0
@@ -307,11 +308,18 @@ static CPUWriteMemoryFunc *trace_dev_writefn[] = {
 /* initialize the trace device */
 void trace_dev_init()
 {
-    if (code_profile_dirname == NULL)
+    trace_dev_state *s;
+
+    if (code_profile_dirname == NULL && guest_profile_filename == NULL &&
+        !tcg_perf_map)
       return;
 
-    code_profile_record_func = profile_bb_helper;
-    trace_dev_state *s;
+    code_profile_binary_func = profile_get_binary;
+
+    if (code_profile_dirname != NULL)
+      code_profile_record_func = profile_bb_helper;
+    if (guest_profile_filename != NULL)
+      guest_profile_start(guest_profile_filename);
 
     s = (trace_dev_state *)g_malloc0(sizeof(trace_dev_state));
     s->dev.name = "qemu_trace";
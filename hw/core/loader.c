@@ -47,8 +47,14 @@
 #include "disas/disas.h"
 #include "sysemu/sysemu.h"
 #include "uboot_image.h"
+#include "exec/ram_addr.h"
+#include "android/utils/mapfile.h"
+#include "android/utils/parallel.h"
 
 #include <zlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 /* return the size or -1 if error */
 int get_image_size(const char *filename)
@@ -125,12 +131,88 @@ int read_targphys(int fd, hwaddr dst_addr, size_t nbytes)
     return dst_addr - dst_begin;
 }
 
+/* Size of the image chunks copied by each thread in copy_targphys() */
+#define COPY_TARGPHYS_CHUNK_SIZE  (4 * 1024 * 1024)
+
+typedef struct {
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t size;
+} CopyTargphysJob;
+
+static void copy_targphys_chunk(void *opaque, int index)
+{
+    CopyTargphysJob *job = opaque;
+    size_t offset = (size_t)index * COPY_TARGPHYS_CHUNK_SIZE;
+    size_t len = job->size - offset;
+
+    if (len > COPY_TARGPHYS_CHUNK_SIZE)
+        len = COPY_TARGPHYS_CHUNK_SIZE;
+    memcpy(job->dst + offset, job->src + offset, len);
+}
+
+/* Copy |nbytes| from |src| to guest memory at |dst_addr|. Contiguous
+ * guest RAM is copied directly, by several threads, so that the page
+ * faults of a file mapping at |src| are served in parallel. Other pages,
+ * e.g. ROM, are copied one at a time. */
+static void copy_targphys(hwaddr dst_addr, const uint8_t *src, size_t nbytes)
+{
+    while (nbytes) {
+        hwaddr len = nbytes;
+        ram_addr_t ram_addr;
+        void *host;
+
+        host = cpu_physical_memory_map(dst_addr, &len, 1);
+        if (host && qemu_ram_addr_from_host(host, &ram_addr) == 0) {
+            CopyTargphysJob job = { host, src, len };
+
+            android_parallel_run(
+                    (len + COPY_TARGPHYS_CHUNK_SIZE - 1) /
+                            COPY_TARGPHYS_CHUNK_SIZE,
+                    copy_targphys_chunk, &job);
+            cpu_physical_memory_unmap(host, len, 1, len);
+        } else {
+            if (host)
+                cpu_physical_memory_unmap(host, len, 0, 0);
+            len = TARGET_PAGE_SIZE - (dst_addr & ~TARGET_PAGE_MASK);
+            if (len > nbytes)
+                len = nbytes;
+            cpu_physical_memory_write_rom(dst_addr, src, len);
+        }
+        dst_addr += len;
+        src += len;
+        nbytes -= len;
+    }
+}
+
 /* return the size or -1 if error */
 int load_image_targphys(const char *filename,
 			hwaddr addr, int max_sz)
 {
+    MapFile *mf;
+    void *base, *data;
+    size_t mapped_size;
     FILE *f;
     size_t got;
+    int size;
+
+    /* Map the image instead of reading it through a bounce buffer, so
+     * that it is read from the page cache straight into guest RAM. */
+    size = get_image_size(filename);
+    if (size > max_sz)
+        size = max_sz;
+    if (size > 0) {
+        mf = mapfile_open(filename, O_RDONLY | O_BINARY, 0);
+        if (mapfile_is_valid(mf)) {
+            base = mapfile_map(mf, 0, size, PROT_READ, &data, &mapped_size);
+            mapfile_close(mf);
+            if (base) {
+                copy_targphys(addr, data, size);
+                mapfile_unmap(base, mapped_size);
+                return size;
+            }
+        }
+    }
 
     f = fopen(filename, "rb");
     if (!f) return -1;
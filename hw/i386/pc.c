@@ -1040,6 +1040,10 @@ static void pc_init1(ram_addr_t ram_size,
 
     goldfish_battery_init(android_hw->hw_battery);
 
+    if (goldfish_balloon) {
+        goldfish_balloon_init();
+    }
+
 #ifdef CONFIG_NAND
     goldfish_add_device_no_io(&nand_device);
     nand_dev_init(nand_device.base);
@@ -1149,7 +1153,9 @@ static void pc_init1(ram_addr_t ram_size,
     for(i = 0; i < nb_nics; i++) {
         NICInfo *nd = &nd_table[i];
 
-        if (!pci_enabled || (nd->model && strcmp(nd->model, "ne2k_isa") == 0))
+        if (nd->model && strcmp(nd->model, "goldfish") == 0)
+            goldfish_net_init(nd, i);
+        else if (!pci_enabled || (nd->model && strcmp(nd->model, "ne2k_isa") == 0))
             pc_init_ne2k_isa(nd, i8259);
         else
             pci_nic_init(pci_bus, nd, -1, "ne2k_pci");
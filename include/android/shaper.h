@@ -25,6 +25,13 @@ NetShaper   netshaper_create  ( int                do_copy,
 
 void        netshaper_set_rate(NetShaper  shaper, double  rate );
 
+/* set the packet loss and reordering probabilities, in percents, and the
+ * maximum random delay added to each packet, in milliseconds */
+void        netshaper_set_profile( NetShaper  shaper,
+                                   double     loss_percent,
+                                   int        jitter_ms,
+                                   double     reorder_percent );
+
 void        netshaper_send( NetShaper  shaper, void* data, size_t  size );
 
 void        netshaper_send_aux( NetShaper  shaper, void* data, size_t  size, void*  opaque );
@@ -30,4 +30,18 @@ extern CodeProfileRecordFunc code_profile_record_func;
 // A string to indicate where profile will be stored. Profiling will
 // be turned off if its value is NULL.
 extern const char *code_profile_dirname;
+
+// Function type used to find the guest binary that contains |pc| in
+// the current guest process. Returns its path and sets |*offset| to the
+// file offset of |pc|, or returns NULL if it is not known.
+typedef const char *(*CodeProfileBinaryFunc)(target_ulong pc,
+                                             target_ulong *offset);
+
+// Set when the guest reports its mappings through the qemu_trace
+// device, used to label translated code in the host perf map.
+extern CodeProfileBinaryFunc code_profile_binary_func;
+
+// The file where the sampling profile of the guest is written, see
+// -guest-profile. Sampling is disabled if NULL.
+extern const char *guest_profile_filename;
 #endif
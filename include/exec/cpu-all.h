@@ -462,6 +462,9 @@ extern ram_addr_t ram_size;
 /* RAM is pre-allocated and passed into qemu_ram_alloc_from_ptr */
 #define RAM_PREALLOC_MASK   (1 << 0)
 
+/* RAM is a private mapping of a snapshot RAM file, see qemu_ram_map_file */
+#define RAM_FILE_MAPPED_MASK   (1 << 1)
+
 typedef struct RAMBlock {
     uint8_t *host;
     ram_addr_t offset;
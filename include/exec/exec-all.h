@@ -91,6 +91,17 @@ void QEMU_NORETURN cpu_io_recompile(CPUArchState *env, uintptr_t retaddr);
 TranslationBlock *tb_gen_code(CPUArchState *env, 
                               target_ulong pc, target_ulong cs_base, int flags,
                               int cflags);
+TranslationBlock *tb_gen_trace(CPUArchState *env, TranslationBlock *tb);
+int tb_get_exec_count(tb_page_addr_t phys_pc, target_ulong pc,
+                      target_ulong cs_base, uint64_t flags);
+
+/* Number of executions after which a block is retranslated as a hot
+   trace, or 0 when traces are disabled (see -tcg-traces). */
+#define TCG_TRACE_THRESHOLD 1000
+extern int tcg_trace_threshold;
+
+/* Set to write /tmp/perf-<pid>.map for host profilers (see -perf-map). */
+extern int tcg_perf_map;
 void cpu_exec_init(CPUArchState *env);
 void QEMU_NORETURN cpu_loop_exit(CPUArchState *env1);
 int page_unprotect(target_ulong address, uintptr_t pc, void *puc);
@@ -154,9 +165,11 @@ struct TranslationBlock {
     uint64_t flags; /* flags defining in which context the code was generated */
     uint16_t size;      /* size of target code for this block (1 <=
                            size <= TARGET_PAGE_SIZE) */
-    uint16_t cflags;    /* compile flags */
+    uint32_t cflags;    /* compile flags */
 #define CF_COUNT_MASK  0x7fff
 #define CF_LAST_IO     0x8000 /* Last insn may be an IO access.  */
+#define CF_HOT_COUNT   0x10000 /* Count executions in exec_count.  */
+#define CF_TRACE       0x20000 /* Hot trace, see tb_gen_trace().  */
 
     uint8_t *tc_ptr;    /* pointer to the translated code */
     /* next matching tb for physical address. */
@@ -181,6 +194,13 @@ struct TranslationBlock {
     struct TranslationBlock *jmp_next[2];
     struct TranslationBlock *jmp_first;
     uint32_t icount;
+
+    /* CF_HOT_COUNT blocks: executions left before the block is
+       retranslated as a trace. */
+    int32_t exec_count;
+    /* CF_TRACE blocks: the conditional branches that the trace follows,
+       2 bits per branch, so that retranslation is deterministic. */
+    uint32_t trace_path;
 };
 
 #include "exec/spinlock.h"
@@ -198,6 +218,11 @@ struct TBContext {
     /* statistics */
     int tb_flush_count;
     int tb_phys_invalidate_count;
+    /* indirect branches resolved by helper_lookup_tb_ptr() */
+    uint64_t tb_lookup_hit_count;
+    uint64_t tb_lookup_miss_count;
+    /* blocks retranslated by tb_gen_trace() */
+    int tb_trace_count;
 
     int tb_invalidated_flag;
 };
@@ -349,6 +374,13 @@ extern uintptr_t tci_tb_ptr;
 void phys_mem_set_alloc(void *(*alloc)(size_t));
 
 TranslationBlock *tb_find_pc(uintptr_t pc_ptr);
+#endif
+
+/* Called from generated code after an indirect branch, see
+   tcg_gen_goto_ptr(). */
+void *helper_lookup_tb_ptr(CPUArchState *env);
+
+#if !defined(CONFIG_USER_ONLY)
 
 uint64_t io_mem_read(int index, hwaddr addr, unsigned size);
 void io_mem_write(int index, hwaddr addr, uint64_t value, unsigned size);
@@ -36,6 +36,22 @@ static inline void gen_icount_start(void)
     tcg_temp_free_i32(count);
 }
 
+/* Count the executions of a CF_HOT_COUNT block, and leave it through the
+   exit request path when it becomes hot, so that cpu_exec() replaces it
+   with a trace. Must follow gen_icount_start(). */
+static inline void gen_hot_count_start(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_const_ptr(&tb->exec_count);
+    TCGv_i32 count = tcg_temp_new_i32();
+
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_subi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+    tcg_gen_brcondi_i32(TCG_COND_LE, count, 0, exitreq_label);
+    tcg_temp_free_i32(count);
+    tcg_temp_free_ptr(ptr);
+}
+
 static void gen_icount_end(TranslationBlock *tb, int num_insns)
 {
     gen_set_label(exitreq_label);
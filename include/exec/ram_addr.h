@@ -38,6 +38,9 @@ void *qemu_safe_ram_ptr(ram_addr_t addr);
 int qemu_ram_addr_from_host(void *ptr, ram_addr_t *ram_addr);
 void qemu_ram_free(ram_addr_t addr);
 void qemu_ram_remap(ram_addr_t addr, ram_addr_t length);
+#ifndef _WIN32
+int qemu_ram_map_file(ram_addr_t addr, int fd, off_t file_offset);
+#endif
 ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr);
 
 static inline int cpu_physical_memory_get_dirty(ram_addr_t start,
@@ -182,6 +182,9 @@ typedef struct float_status {
 
 void set_float_rounding_mode(int val STATUS_PARAM);
 void set_float_exception_flags(int val STATUS_PARAM);
+/* Enables or disables the host FPU fast path, which is enabled by default.
+   Results and flags are identical either way. */
+void softfloat_set_use_host_fpu(flag val);
 INLINE void set_float_detect_tininess(int val STATUS_PARAM)
 {
     STATUS(float_detect_tininess) = val;
@@ -26,4 +26,12 @@ void record_mmap(target_ulong vstart, target_ulong vend,
 void release_mmap(unsigned pid);
 
 void profile_bb_helper(target_ulong pc, uint32_t size);
+
+// Return the path of the binary mapped at |pc| in the current process,
+// and its file offset in |*offset|, or NULL if unknown.
+const char *profile_get_binary(target_ulong pc, target_ulong *offset);
+
+// Start sampling the guest CPUs, and write the profile to |filename|
+// periodically and on exit. See -guest-profile.
+void guest_profile_start(const char *filename);
 #endif
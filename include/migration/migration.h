@@ -109,4 +109,12 @@ uint64_t ram_bytes_total(void);
 int ram_save_live(QEMUFile *f, int stage, void *opaque);
 int ram_load(QEMUFile *f, void *opaque, int version_id);
 
+/* Directory where 'savevm' stores guest RAM as raw files that 'loadvm'
+ * maps on demand, instead of in the VM state. NULL to disable. */
+extern const char *snapshot_ram_dir;
+
+/* Set the name of the snapshot that the next ram_save_live() call saves,
+ * used to name its RAM file. NULL to save RAM in the VM state. */
+void ram_set_snapshot_name(const char *name);
+
 #endif
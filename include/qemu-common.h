@@ -496,6 +496,7 @@ can_use_buffer_find_nonzero_offset(const void *buf, size_t len)
             && ((uintptr_t) buf) % sizeof(VECTYPE) == 0);
 }
 size_t buffer_find_nonzero_offset(const void *buf, size_t len);
+bool buffer_is_uniform(const void *buf, size_t len);
 
 /*
  * helper to parse debug environment variables
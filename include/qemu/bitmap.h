@@ -36,6 +36,7 @@
  * bitmap_full(src, nbits)			Are all bits set in *src?
  * bitmap_set(dst, pos, nbits)			Set specified bit area
  * bitmap_clear(dst, pos, nbits)		Clear specified bit area
+ * bitmap_count_one_range(src, pos, nbits)	Number of bits set in area
  * bitmap_find_next_zero_area(buf, len, pos, n, mask)	Find bit free area
  */
 
@@ -214,6 +215,7 @@ static inline int bitmap_intersects(const unsigned long *src1,
 
 void bitmap_set(unsigned long *map, long i, long len);
 void bitmap_clear(unsigned long *map, long start, long nr);
+long bitmap_count_one_range(const unsigned long *map, long start, long nr);
 unsigned long bitmap_find_next_zero_area(unsigned long *map,
                                          unsigned long size,
                                          unsigned long start,
@@ -59,7 +59,8 @@ struct QEMUTimer {
     QEMUTimerList *timer_list;
     QEMUTimerCB *cb;
     void *opaque;
-    QEMUTimer *next;
+    uint64_t sequence;          /* insertion order, breaks expire_time ties */
+    int heap_index;             /* position in timer_list's heap, if pending */
     int scale;
 };
 
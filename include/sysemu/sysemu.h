@@ -20,6 +20,8 @@ extern const char *bios_name;
 
 extern const char* savevm_on_exit;
 extern int no_shutdown;
+extern int tickless_idle;
+extern int goldfish_balloon;
 extern int vm_running;
 extern int vm_can_run(void);
 extern int qemu_debug_requested(void);
@@ -52,6 +54,13 @@ int init_timer_alarm(void);
 int qemu_timer_alarm_pending(void);
 void quit_timers(void);
 
+/* Return the time in milliseconds since qemu_init_main_loop(), and the
+ * number of main loop iterations and host alarm timer expirations since
+ * then. */
+void qemu_get_wakeup_stats(int64_t *elapsed_ms,
+                           uint64_t *main_loop_wakeups,
+                           uint64_t *alarm_wakeups);
+
 int64_t qemu_icount;
 int64_t qemu_icount_bias;
 int icount_time_shift;
@@ -24,6 +24,9 @@ extern int multitouch_enabled;
 #define GUI_REFRESH_INTERVAL 30
 #endif
 
+/* in ms, maximum refresh interval of an unchanged display in tickless mode */
+#define GUI_IDLE_REFRESH_INTERVAL 250
+
 typedef int QEMUDisplayCloseCallback(void *opaque);
 void qemu_set_display_close_handler(QEMUDisplayCloseCallback *cb, void *opaque);
 int qemu_run_display_close_handler(void);
@@ -211,6 +214,8 @@ struct DisplayState {
     struct DisplaySurface *surface;
     void *opaque;
     struct QEMUTimer *gui_timer;
+    uint64_t refresh_interval;  /* current gui_timer interval, in ms */
+    int damaged;                /* set by dpy_update() and dpy_resize() */
 
     struct DisplayAllocator* allocator;
     struct DisplayChangeListener* listeners;
@@ -227,6 +232,10 @@ void vga_fill_rect (DisplayState *ds, int posx, int posy,
     int width, int height, uint32_t color);
 void register_displaystate(DisplayState *ds);
 DisplayState *get_displaystate(void);
+
+/* In tickless mode, refresh the display as soon as possible. Display
+ * devices call this when the guest posts a new frame. */
+void dpy_kick_refresh(DisplayState *ds);
 DisplaySurface* qemu_create_displaysurface_from(int width, int height, int bpp,
                                                 int linesize, uint8_t *data);
 void qemu_alloc_display(DisplaySurface *surface, int width, int height,
@@ -284,6 +293,7 @@ void unregister_displayupdatelistener(DisplayState *ds, DisplayUpdateListener *d
 static inline void dpy_update(DisplayState *s, int x, int y, int w, int h)
 {
     struct DisplayChangeListener *dcl = s->listeners;
+    s->damaged = 1;
     while (dcl != NULL) {
         dcl->dpy_update(s, x, y, w, h);
         dcl = dcl->next;
@@ -314,6 +324,7 @@ static inline void dpy_updatecaption(DisplayState *s)
 static inline void dpy_resize(DisplayState *s)
 {
     struct DisplayChangeListener *dcl = s->listeners;
+    s->damaged = 1;
     while (dcl != NULL) {
         dcl->dpy_resize(s);
         dcl = dcl->next;
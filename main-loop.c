@@ -31,7 +31,9 @@
 #include "monitor/monitor.h"
 #include "net/net.h"
 #include "qemu-common.h"
+#include "qemu/atomic.h"
 #include "qemu/sockets.h"
+#include "qemu/thread.h"
 #include "qemu/timer.h"
 #include "slirp-android/libslirp.h"
 #include "sysemu/cpus.h"
@@ -39,6 +41,7 @@
 
 #ifdef __linux__
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #endif
 
 #ifdef _WIN32
@@ -57,6 +60,11 @@ int64_t qemu_icount_bias;
 static QEMUTimer *icount_rt_timer;
 static QEMUTimer *icount_vm_timer;
 
+/* Wakeup statistics, see qemu_get_wakeup_stats() */
+static int64_t wakeup_stats_start_ms;
+static uint64_t main_loop_wakeups;
+static volatile uint64_t alarm_wakeups;
+
 #ifndef _WIN32
 static int io_thread_fd = -1;
 
@@ -121,6 +129,7 @@ static int qemu_main_loop_event_init(void)
 
 int qemu_init_main_loop(void)
 {
+    wakeup_stats_start_ms = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
     return qemu_main_loop_event_init();
 }
 
@@ -259,12 +268,22 @@ void os_host_main_loop_wait(int *timeout)
 
 static void qemu_run_alarm_timer(void);  // forward
 
+void qemu_get_wakeup_stats(int64_t *elapsed_ms,
+                           uint64_t *main_loop_count,
+                           uint64_t *alarm_count)
+{
+    *elapsed_ms = qemu_clock_get_ms(QEMU_CLOCK_REALTIME) - wakeup_stats_start_ms;
+    *main_loop_count = main_loop_wakeups;
+    *alarm_count = alarm_wakeups;
+}
+
 void main_loop_wait(int timeout)
 {
     fd_set rfds, wfds, xfds;
     int ret, nfds;
     struct timeval tv;
 
+    main_loop_wakeups++;
     qemu_bh_update_timeout(&timeout);
 
     os_host_main_loop_wait(&timeout);
@@ -456,10 +475,14 @@ struct qemu_alarm_timer {
 #if defined(__linux__)
     int fd;
     timer_t timer;
+    QemuThread thread;
+    QemuThread main_thread;
+    int exiting;
 #elif defined(_WIN32)
     HANDLE timer;
 #endif
-    char expired;
+    /* set from a signal handler or another thread, use atomic ops */
+    int expired;
 };
 
 static struct qemu_alarm_timer *alarm_timer;
@@ -478,8 +501,7 @@ static void qemu_rearm_alarm_timer(struct qemu_alarm_timer *t)
 
 static void qemu_run_alarm_timer(void) {
     /* rearm timer, if not periodic */
-    if (alarm_timer->expired) {
-        alarm_timer->expired = 0;
+    if (atomic_xchg(&alarm_timer->expired, 0)) {
         qemu_rearm_alarm_timer(alarm_timer);
     }
 }
@@ -504,6 +526,10 @@ static void unix_stop_timer(struct qemu_alarm_timer *t);
 
 #ifdef __linux__
 
+static int timerfd_start_timer(struct qemu_alarm_timer *t);
+static void timerfd_stop_timer(struct qemu_alarm_timer *t);
+static void timerfd_rearm_timer(struct qemu_alarm_timer *t);
+
 static int dynticks_start_timer(struct qemu_alarm_timer *t);
 static void dynticks_stop_timer(struct qemu_alarm_timer *t);
 static void dynticks_rearm_timer(struct qemu_alarm_timer *t);
@@ -519,6 +545,14 @@ int64_t qemu_icount_round(int64_t count)
 
 static struct qemu_alarm_timer alarm_timers[] = {
 #ifndef _WIN32
+#ifdef __linux__
+    /* 'timerfd' is armed from the main thread without a POSIX timer, and
+     * a helper thread blocking on it sends SIGALRM to the main thread with
+     * pthread_kill() on expiration, so it doesn't suffer from the issue
+     * described below for 'dynticks'. */
+    {"timerfd", timerfd_start_timer,
+     timerfd_stop_timer, timerfd_rearm_timer},
+#endif
     {"unix", unix_start_timer, unix_stop_timer, NULL},
 #ifdef __linux__
     /* on Linux, the 'dynticks' clock sometimes doesn't work
@@ -603,14 +637,13 @@ next:
 
 // This variable is used to notify the qemu_timer_alarm_pending() caller
 // (really tcg_cpu_exec()) that an alarm has expired. It is set in the
-// timer callback, which can be a signal handler on non-Windows platforms.
-static volatile sig_atomic_t timer_alarm_pending = 1;
+// timer callback, which can be a signal handler on non-Windows platforms,
+// so it is only accessed with atomic operations.
+static int timer_alarm_pending = 1;
 
 int qemu_timer_alarm_pending(void)
 {
-    int ret = timer_alarm_pending;
-    timer_alarm_pending = 0;
-    return ret;
+    return atomic_xchg(&timer_alarm_pending, 0);
 }
 
 #if defined(__linux__) || defined(_WIN32)
@@ -645,14 +678,16 @@ static void host_alarm_handler(int host_signum)
     if (!t)
         return;
 
+    alarm_wakeups++;
+
     // It's not possible to call qemu_next_alarm_deadline() to know
     // if a timer has really expired, in the case of non-dynamic alarms,
     // so just signal and let the main loop thread do the checks instead.
-    timer_alarm_pending = 1;
+    atomic_set(&timer_alarm_pending, 1);
 
     // Ensure a dynamic alarm will be properly rescheduled.
     if (alarm_has_dynticks(t))
-        t->expired = 1;
+        atomic_set(&t->expired, 1);
 
     // This forces a cpu_exit() call that will end the current CPU
     // execution ASAP.
@@ -661,6 +696,102 @@ static void host_alarm_handler(int host_signum)
 
 #if defined(__linux__)
 
+/* The 'timerfd' alarm uses a Linux timerfd, armed to the nearest timer
+ * deadline, and a helper thread blocking on it. On expiration, the thread
+ * sends SIGALRM to the main thread, whose handler kicks the current CPU
+ * out of its execution loop: current_cpu is thread-local, so this can't
+ * be done from the helper thread. Unlike the POSIX timer used by
+ * 'dynticks', the timerfd is rearmed without a signal-unsafe system call
+ * per expiration, and uses the monotonic clock. */
+static void *timerfd_alarm_thread(void *opaque)
+{
+    struct qemu_alarm_timer *t = opaque;
+    uint64_t expirations;
+    ssize_t len;
+
+    for (;;) {
+        len = read(t->fd, &expirations, sizeof(expirations));
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len != sizeof(expirations) || atomic_read(&t->exiting))
+            break;
+
+        pthread_kill(t->main_thread.thread, SIGALRM);
+    }
+    return NULL;
+}
+
+static int timerfd_start_timer(struct qemu_alarm_timer *t)
+{
+    struct sigaction act;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    sigfillset(&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    act.sa_handler = host_alarm_handler;
+    sigaction(SIGALRM, &act, NULL);
+
+    t->fd = fd;
+    atomic_set(&t->exiting, 0);
+    qemu_thread_get_self(&t->main_thread);
+    qemu_thread_create(&t->thread, timerfd_alarm_thread, t,
+                       QEMU_THREAD_JOINABLE);
+    return 0;
+}
+
+static void timerfd_stop_timer(struct qemu_alarm_timer *t)
+{
+    struct itimerspec timeout;
+
+    /* Force an immediate expiration to wake up the helper thread. */
+    atomic_set(&t->exiting, 1);
+    memset(&timeout, 0, sizeof(timeout));
+    timeout.it_value.tv_nsec = 1;
+    timerfd_settime(t->fd, 0, &timeout, NULL);
+    qemu_thread_join(&t->thread);
+    close(t->fd);
+    t->fd = -1;
+}
+
+static void timerfd_rearm_timer(struct qemu_alarm_timer *t)
+{
+    struct itimerspec timeout;
+    int64_t nearest_delta_ns;
+    int64_t current_ns;
+
+    assert(alarm_has_dynticks(t));
+    if (!qemu_clock_has_timers(QEMU_CLOCK_REALTIME) &&
+        !qemu_clock_has_timers(QEMU_CLOCK_VIRTUAL) &&
+        !qemu_clock_has_timers(QEMU_CLOCK_HOST))
+        return;
+
+    nearest_delta_ns = qemu_next_alarm_deadline();
+    if (nearest_delta_ns < MIN_TIMER_REARM_NS)
+        nearest_delta_ns = MIN_TIMER_REARM_NS;
+
+    /* check whether a timer is already running */
+    if (timerfd_gettime(t->fd, &timeout)) {
+        perror("timerfd_gettime");
+        fprintf(stderr, "Internal timer error: aborting\n");
+        exit(1);
+    }
+    current_ns = timeout.it_value.tv_sec * 1000000000LL + timeout.it_value.tv_nsec;
+    if (current_ns && current_ns <= nearest_delta_ns)
+        return;
+
+    timeout.it_interval.tv_sec = 0;
+    timeout.it_interval.tv_nsec = 0; /* 0 for one-shot timer */
+    timeout.it_value.tv_sec =  nearest_delta_ns / 1000000000;
+    timeout.it_value.tv_nsec = nearest_delta_ns % 1000000000;
+    if (timerfd_settime(t->fd, 0 /* RELATIVE */, &timeout, NULL)) {
+        perror("timerfd_settime");
+        fprintf(stderr, "Internal timer error: aborting\n");
+        exit(1);
+    }
+}
+
 static int dynticks_start_timer(struct qemu_alarm_timer *t)
 {
     struct sigevent ev;
@@ -795,11 +926,12 @@ static void CALLBACK mm_alarm_handler(UINT uTimerID, UINT uMsg,
     if (!t) {
         return;
     }
+    alarm_wakeups++;
     // We can actually call qemu_next_alarm_deadline() here since this
     // doesn't run in a signal handler, but a different thread.
     if (alarm_has_dynticks(t) || qemu_next_alarm_deadline() <= 0) {
-        t->expired = 1;
-        timer_alarm_pending = 1;
+        atomic_set(&t->expired, 1);
+        atomic_set(&timer_alarm_pending, 1);
         qemu_notify_event();
     }
 }
@@ -970,7 +1102,7 @@ int init_timer_alarm(void)
 
     /* first event is at time 0 */
     alarm_timer = t;
-    timer_alarm_pending = 1;
+    atomic_set(&timer_alarm_pending, 1);
     qemu_add_vm_change_state_handler(alarm_timer_on_change_state_rearm, t);
 
     return 0;
@@ -990,9 +1122,12 @@ int qemu_calculate_timeout(void)
 {
     int timeout;
 
-    if (!vm_running)
+    /* In tickless mode, a stopped virtual device still waits for the
+     * next timer deadline, instead of relying on the alarm timer to
+     * interrupt a fixed timeout. */
+    if (!vm_running && !tickless_idle)
         timeout = 5000;
-    else if (tcg_has_work())
+    else if (vm_running && tcg_has_work())
         timeout = 0;
     else {
 #ifdef WIN32
@@ -683,6 +683,9 @@ double   qemu_net_upload_speed   = 0.;
 double   qemu_net_download_speed = 0.;
 int      qemu_net_min_latency = 0;
 int      qemu_net_max_latency = 0;
+double   qemu_net_loss_percent = 0.;
+int      qemu_net_jitter_ms = 0;
+double   qemu_net_reorder_percent = 0.;
 int      qemu_net_disable = 0;
 
 int
@@ -747,6 +750,10 @@ slirp_init_shapers( void )
     netdelay_set_latency( slirp_delay_in, qemu_net_min_latency, qemu_net_max_latency );
     netshaper_set_rate( slirp_shaper_out, qemu_net_download_speed );
     netshaper_set_rate( slirp_shaper_in,  qemu_net_upload_speed  );
+    netshaper_set_profile( slirp_shaper_out, qemu_net_loss_percent,
+                           qemu_net_jitter_ms, qemu_net_reorder_percent );
+    netshaper_set_profile( slirp_shaper_in, qemu_net_loss_percent,
+                           qemu_net_jitter_ms, qemu_net_reorder_percent );
 }
 
 #endif /* CONFIG_ANDROID */
@@ -2688,3 +2695,55 @@ android_parse_network_latency(const char*  delay)
     }
     return 0;
 }
+
+
+int
+android_parse_network_profile(const char*  profile)
+{
+    int  n;
+    char*  end;
+    double  loss, reorder = 0.;
+    long  jitter = 0;
+
+    if (profile == NULL || profile[0] == 0)
+        profile = DEFAULT_NETPROFILE;
+
+    for (n = 0; android_netprofiles[n].name != NULL; n++) {
+        if ( !strcmp( android_netprofiles[n].name, profile ) ) {
+            qemu_net_loss_percent    = android_netprofiles[n].loss_percent;
+            qemu_net_jitter_ms       = android_netprofiles[n].jitter_ms;
+            qemu_net_reorder_percent = android_netprofiles[n].reorder_percent;
+            return 0;
+        }
+    }
+
+    /* is this <loss>[:<jitter>[:<reorder>]] ? the current values are only
+     * changed if the whole string is valid. the negated comparisons also
+     * reject NaN. */
+    loss = strtod(profile, &end);
+    if (end == profile || !(loss >= 0. && loss <= 100.)) {
+        return -1;
+    }
+    if (*end == ':') {
+        profile = (const char*)end+1;
+        jitter = strtol(profile, &end, 10);
+        if (end == profile || jitter < 0 || jitter > INT_MAX) {
+            return -1;
+        }
+        if (*end == ':') {
+            profile = (const char*)end+1;
+            reorder = strtod(profile, &end);
+            if (end == profile || !(reorder >= 0. && reorder <= 100.)) {
+                return -1;
+            }
+        }
+    }
+    if (*end != 0) {
+        return -1;
+    }
+
+    qemu_net_loss_percent    = loss;
+    qemu_net_jitter_ms       = (int)jitter;
+    qemu_net_reorder_percent = reorder;
+    return 0;
+}
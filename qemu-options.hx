@@ -92,6 +92,7 @@ DEF("drive", HAS_ARG, QEMU_OPTION_drive,
     "-drive [file=file][,if=type][,bus=n][,unit=m][,media=d][,index=i]\n"
     "       [,cyls=c,heads=h,secs=s[,trans=t]][,snapshot=on|off]\n"
     "       [,cache=writethrough|writeback|none][,format=f][,serial=s]\n"
+    "       [,aio=threads|native]\n"
     "                use 'file' as a drive image\n")
 STEXI
 @item -drive @var{option}[,@var{option}[,@var{option}[,...]]]
@@ -120,6 +121,10 @@ These options have the same definition as they have in @option{-hdachs}.
 @var{snapshot} is "on" or "off" and allows to enable snapshot for given drive (see @option{-snapshot}).
 @item cache=@var{cache}
 @var{cache} is "none", "writeback", or "writethrough" and controls how the host cache is used to access block data.
+@item aio=@var{aio}
+@var{aio} is "threads", or "native" and selects between pthread based disk I/O and native Linux AIO.
+Native AIO is only used with @option{cache=none}, and requests are batched
+into a single submission to the host kernel.
 @item format=@var{format}
 Specify which disk @var{format} will be used rather than detecting
 the format.  Can be used to specifiy format=raw to avoid interpreting
@@ -1688,6 +1693,11 @@ DEF("code-profile", HAS_ARG, QEMU_OPTION_code_profile, \
     "which can be used to drive feedback directed optimizations. " \
     "More details can be found from https://gcc.gnu.org/wiki/AutoFDO.\n")
 
+DEF("guest-profile", HAS_ARG, QEMU_OPTION_guest_profile, \
+    "-guest-profile file\n" \
+    "Sample the guest every 10 ms and write a pprof CPU profile to file\n" \
+    "(ARM only).\n")
+
 #ifdef CONFIG_ANDROID
 DEF("savevm-on-exit", HAS_ARG, QEMU_OPTION_savevm_on_exit, \
     "savevm-on-exit [tag|id]\n" \
@@ -1788,4 +1798,19 @@ DEF("snapshot-no-time-update", 0, QEMU_OPTION_snapshot_no_time_update, \
 DEF("list-webcam", 0, QEMU_OPTION_list_webcam, \
     "-list-webcam List web cameras available for emulation\n")
 
+DEF("tickless", 0, QEMU_OPTION_tickless, \
+    "-tickless reduce host wakeups when the emulated system is idle\n")
+
+DEF("snapshot-ram-dir", HAS_ARG, QEMU_OPTION_snapshot_ram_dir, \
+    "-snapshot-ram-dir <dir> store snapshot RAM as files in <dir>, loaded on demand\n")
+
+DEF("goldfish-balloon", 0, QEMU_OPTION_goldfish_balloon, \
+    "-goldfish-balloon add a memory balloon device, see 'avd balloon'\n")
+
+DEF("tcg-traces", 0, QEMU_OPTION_tcg_traces, \
+    "-tcg-traces retranslate hot code as traces that span several blocks\n")
+
+DEF("perf-map", 0, QEMU_OPTION_perf_map, \
+    "-perf-map label translated code in /tmp/perf-<pid>.map for Linux perf\n")
+
 #endif /* ANDROID */
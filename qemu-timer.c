@@ -64,12 +64,19 @@ QEMUClock qemu_clocks[QEMU_CLOCK_MAX];
  * used by different AioContexts / threads. Each clock also has
  * a list of the QEMUTimerLists associated with it, in order that
  * reenabling the clock can call all the notifiers.
+ *
+ * The active timers are kept in a binary min-heap ordered by expiration
+ * time, then insertion order, so that adding, modifying or removing a
+ * timer is O(log n) and the next deadline is always active_timers[0].
  */
 
 struct QEMUTimerList {
     QEMUClock *clock;
     QemuMutex active_timers_lock;
-    QEMUTimer *active_timers;
+    QEMUTimer **active_timers;
+    int active_count;
+    int active_capacity;
+    uint64_t next_sequence;
     QLIST_ENTRY(QEMUTimerList) list;
     QEMUTimerListNotifyCB *notify_cb;
     void *notify_opaque;
@@ -96,6 +103,103 @@ static bool timer_expired_ns(QEMUTimer *timer_head, int64_t current_time)
     return timer_head && (timer_head->expire_time <= current_time);
 }
 
+/* Return the earliest active timer of |timer_list|, or NULL.
+ * Must be called with active_timers_lock held. */
+static inline QEMUTimer *timerlist_head(QEMUTimerList *timer_list)
+{
+    return timer_list->active_count ? timer_list->active_timers[0] : NULL;
+}
+
+static inline bool timer_heap_before(const QEMUTimer *a, const QEMUTimer *b)
+{
+    if (a->expire_time != b->expire_time) {
+        return a->expire_time < b->expire_time;
+    }
+    return a->sequence < b->sequence;
+}
+
+static inline void timer_heap_set(QEMUTimerList *timer_list, int index,
+                                  QEMUTimer *ts)
+{
+    timer_list->active_timers[index] = ts;
+    ts->heap_index = index;
+}
+
+static void timer_heap_sift_up(QEMUTimerList *timer_list, int index)
+{
+    QEMUTimer *ts = timer_list->active_timers[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        QEMUTimer *p = timer_list->active_timers[parent];
+        if (!timer_heap_before(ts, p)) {
+            break;
+        }
+        timer_heap_set(timer_list, index, p);
+        index = parent;
+    }
+    timer_heap_set(timer_list, index, ts);
+}
+
+static void timer_heap_sift_down(QEMUTimerList *timer_list, int index)
+{
+    QEMUTimer *ts = timer_list->active_timers[index];
+    int count = timer_list->active_count;
+
+    for (;;) {
+        int child = 2 * index + 1;
+        QEMUTimer *c;
+        if (child >= count) {
+            break;
+        }
+        c = timer_list->active_timers[child];
+        if (child + 1 < count &&
+            timer_heap_before(timer_list->active_timers[child + 1], c)) {
+            child++;
+            c = timer_list->active_timers[child];
+        }
+        if (!timer_heap_before(c, ts)) {
+            break;
+        }
+        timer_heap_set(timer_list, index, c);
+        index = child;
+    }
+    timer_heap_set(timer_list, index, ts);
+}
+
+static void timer_heap_insert(QEMUTimerList *timer_list, QEMUTimer *ts)
+{
+    if (timer_list->active_count == timer_list->active_capacity) {
+        int capacity = timer_list->active_capacity ?
+                timer_list->active_capacity * 2 : 16;
+        timer_list->active_timers = g_renew(QEMUTimer *,
+                                            timer_list->active_timers,
+                                            capacity);
+        timer_list->active_capacity = capacity;
+    }
+    ts->sequence = timer_list->next_sequence++;
+    timer_heap_set(timer_list, timer_list->active_count++, ts);
+    timer_heap_sift_up(timer_list, ts->heap_index);
+}
+
+static void timer_heap_remove(QEMUTimerList *timer_list, QEMUTimer *ts)
+{
+    int index = ts->heap_index;
+    QEMUTimer *last = timer_list->active_timers[--timer_list->active_count];
+
+    ts->heap_index = -1;
+    if (last == ts) {
+        return;
+    }
+    timer_heap_set(timer_list, index, last);
+    if (index > 0 &&
+        timer_heap_before(last, timer_list->active_timers[(index - 1) / 2])) {
+        timer_heap_sift_up(timer_list, index);
+    } else {
+        timer_heap_sift_down(timer_list, index);
+    }
+}
+
 QEMUTimerList *timerlist_new(QEMUClockType type,
                              QEMUTimerListNotifyCB *cb,
                              void *opaque)
@@ -120,6 +224,7 @@ void timerlist_free(QEMUTimerList *timer_list)
         QLIST_REMOVE(timer_list, list);
     }
     qemu_mutex_destroy(&timer_list->active_timers_lock);
+    g_free(timer_list->active_timers);
     g_free(timer_list);
 }
 
@@ -173,7 +278,7 @@ void qemu_clock_enable(QEMUClockType type, bool enabled)
 
 bool timerlist_has_timers(QEMUTimerList *timer_list)
 {
-    return !!timer_list->active_timers;
+    return timer_list->active_count > 0;
 }
 
 bool qemu_clock_has_timers(QEMUClockType type)
@@ -187,11 +292,11 @@ bool timerlist_expired(QEMUTimerList *timer_list)
     int64_t expire_time;
 
     qemu_mutex_lock(&timer_list->active_timers_lock);
-    if (!timer_list->active_timers) {
+    if (!timer_list->active_count) {
         qemu_mutex_unlock(&timer_list->active_timers_lock);
         return false;
     }
-    expire_time = timer_list->active_timers->expire_time;
+    expire_time = timer_list->active_timers[0]->expire_time;
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
     return expire_time < qemu_clock_get_ns(timer_list->clock->type);
@@ -222,11 +327,11 @@ int64_t timerlist_deadline_ns(QEMUTimerList *timer_list)
      * the caller should notice the change and there is no race condition.
      */
     qemu_mutex_lock(&timer_list->active_timers_lock);
-    if (!timer_list->active_timers) {
+    if (!timer_list->active_count) {
         qemu_mutex_unlock(&timer_list->active_timers_lock);
         return -1;
     }
-    expire_time = timer_list->active_timers->expire_time;
+    expire_time = timer_list->active_timers[0]->expire_time;
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
     delta = expire_time - qemu_clock_get_ns(timer_list->clock->type);
@@ -331,6 +436,7 @@ void timer_init(QEMUTimer *ts,
     ts->opaque = opaque;
     ts->scale = scale;
     ts->expire_time = -1;
+    ts->heap_index = -1;
 }
 
 void timer_free(QEMUTimer *ts)
@@ -340,41 +446,21 @@ void timer_free(QEMUTimer *ts)
 
 static void timer_del_locked(QEMUTimerList *timer_list, QEMUTimer *ts)
 {
-    QEMUTimer **pt, *t;
-
     ts->expire_time = -1;
-    pt = &timer_list->active_timers;
-    for(;;) {
-        t = *pt;
-        if (!t)
-            break;
-        if (t == ts) {
-            *pt = t->next;
-            break;
-        }
-        pt = &t->next;
+    if (ts->heap_index >= 0) {
+        timer_heap_remove(timer_list, ts);
     }
 }
 
 static bool timer_mod_ns_locked(QEMUTimerList *timer_list,
                                 QEMUTimer *ts, int64_t expire_time)
 {
-    QEMUTimer **pt, *t;
-
-    /* add the timer in the sorted list */
-    pt = &timer_list->active_timers;
-    for (;;) {
-        t = *pt;
-        if (!timer_expired_ns(t, expire_time)) {
-            break;
-        }
-        pt = &t->next;
-    }
+    /* add the timer to the heap, timers with the same expiration time
+     * still fire in the order they were added. */
     ts->expire_time = MAX(expire_time, 0);
-    ts->next = *pt;
-    *pt = ts;
+    timer_heap_insert(timer_list, ts);
 
-    return pt == &timer_list->active_timers;
+    return ts->heap_index == 0;
 }
 
 static void timerlist_rearm(QEMUTimerList *timer_list)
@@ -471,16 +557,14 @@ bool timerlist_run_timers(QEMUTimerList *timer_list)
     current_time = qemu_clock_get_ns(timer_list->clock->type);
     for(;;) {
         qemu_mutex_lock(&timer_list->active_timers_lock);
-        ts = timer_list->active_timers;
+        ts = timerlist_head(timer_list);
         if (!timer_expired_ns(ts, current_time)) {
             qemu_mutex_unlock(&timer_list->active_timers_lock);
             break;
         }
 
         /* remove timer from the list before calling the callback */
-        timer_list->active_timers = ts->next;
-        ts->next = NULL;
-        ts->expire_time = -1;
+        timer_del_locked(timer_list, ts);
         cb = ts->cb;
         opaque = ts->opaque;
         qemu_mutex_unlock(&timer_list->active_timers_lock);
@@ -2543,7 +2543,10 @@ void do_savevm(Monitor *err, const char *name)
         monitor_printf(err, "Could not open VM state file\n");
         goto the_end;
     }
+    /* Named snapshots can keep their RAM in a separate file. */
+    ram_set_snapshot_name(sn->name[0] ? sn->name : NULL);
     ret = qemu_savevm_state(f);
+    ram_set_snapshot_name(NULL);
     vm_state_size = qemu_ftell(f);
     qemu_fclose(f);
     if (ret < 0) {
@@ -79,6 +79,23 @@ static void reset_all_temps(int nb_temps)
     }
 }
 
+/* Reset temporaries after a conditional branch.  The code that follows
+   is only reached through the branch, so globals and local temps that are
+   known to be constant keep their value.  Copies are dropped, since the
+   copy lists cannot be partially reset.  */
+static void reset_temps_at_branch(TCGContext *s, int nb_temps)
+{
+    int i;
+    for (i = 0; i < nb_temps; i++) {
+        if (temps[i].state == TCG_TEMP_CONST
+            && (i < s->nb_globals || s->temps[i].temp_local)) {
+            continue;
+        }
+        temps[i].state = TCG_TEMP_UNDEF;
+        temps[i].mask = -1;
+    }
+}
+
 static int op_bits(TCGOpcode op)
 {
     const TCGOpDef *def = &tcg_op_defs[op];
@@ -1254,7 +1271,12 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
                We trash everything if the operation is the end of a basic
                block, otherwise we only trash the output args.  "mask" is
                the non-zero bits mask for the first output arg.  */
-            if (def->flags & TCG_OPF_BB_END) {
+            if (op == INDEX_op_brcond_i32 || op == INDEX_op_brcond_i64
+                || op == INDEX_op_brcond2_i32) {
+                /* Traces are made of blocks that end with conditional
+                   branches, keep what is known across them.  */
+                reset_temps_at_branch(s, nb_temps);
+            } else if (def->flags & TCG_OPF_BB_END) {
                 reset_all_temps(nb_temps);
             } else {
                 for (i = 0; i < def->nb_oargs; i++) {
@@ -498,6 +498,20 @@ TCGv_i64 tcg_global_mem_new_i64(int reg, intptr_t offset, const char *name)
     return MAKE_TCGV_I64(idx);
 }
 
+/* Mark a global that is usually overwritten before being read, such as a
+   condition flag.  Writes to it that are dead anywhere in the TB are
+   removed, while the liveness analysis only removes the ones that are
+   dead within a basic block.  */
+void tcg_global_set_dse(TCGv_i32 arg)
+{
+    TCGContext *s = &tcg_ctx;
+    int idx = GET_TCGV_I32(arg);
+
+    assert(idx < s->nb_globals);
+    assert(s->nb_dse_globals < TCG_MAX_DSE_GLOBALS);
+    s->dse_globals[s->nb_dse_globals++] = idx;
+}
+
 static inline int tcg_temp_new_internal(TCGType type, int temp_local)
 {
     TCGContext *s = &tcg_ctx;
@@ -1405,6 +1419,130 @@ static inline void tcg_set_nop(TCGContext *s, uint16_t *opc_ptr,
     }
 }
 
+/* Remove the ops whose outputs are globals marked by tcg_global_set_dse()
+   that are overwritten on every path before being read.  The ops are
+   scanned backwards, and the set of live marked globals at each label is
+   remembered for the branches to it, which are all forward ones in
+   practice.  Marked globals are live wherever the TB can be left: at
+   exits, at helper calls that read globals, and at ops that can raise an
+   exception.  Return the number of removed ops. */
+static int tcg_dead_global_elimination(TCGContext *s)
+{
+    int i, op_index, nb_args, nb_iargs, nb_oargs, removed;
+    uint32_t live, all, *label_live;
+    int8_t *bits;
+    TCGOpcode op;
+    TCGArg *args;
+    const TCGOpDef *def;
+
+    if (s->nb_dse_globals == 0) {
+        return 0;
+    }
+
+    bits = tcg_malloc(s->nb_globals);
+    memset(bits, -1, s->nb_globals);
+    for (i = 0; i < s->nb_dse_globals; i++) {
+        bits[s->dse_globals[i]] = i;
+    }
+    all = (uint32_t)((1ULL << s->nb_dse_globals) - 1);
+    /* labels that are not known yet are the targets of backward
+       branches */
+    label_live = tcg_malloc(s->nb_labels * sizeof(uint32_t));
+    for (i = 0; i < s->nb_labels; i++) {
+        label_live[i] = all;
+    }
+
+#define DSE_BIT(arg) \
+    ((arg) < s->nb_globals && bits[arg] >= 0 ? 1U << bits[arg] : 0)
+
+    removed = 0;
+    live = all;
+    args = s->gen_opparam_ptr;
+    for (op_index = s->gen_opc_ptr - s->gen_opc_buf - 1; op_index >= 0;
+         op_index--) {
+        op = s->gen_opc_buf[op_index];
+        def = &tcg_op_defs[op];
+
+        switch (op) {
+        case INDEX_op_call:
+            nb_args = args[-1];
+            args -= nb_args;
+            nb_iargs = args[0] & 0xffff;
+            nb_oargs = args[0] >> 16;
+            for (i = 1; i <= nb_oargs; i++) {
+                live &= ~DSE_BIT(args[i]);
+            }
+            if (!(args[nb_oargs + nb_iargs + 1] & TCG_CALL_NO_READ_GLOBALS)) {
+                live = all;
+            }
+            for (i = nb_oargs + 1; i <= nb_oargs + nb_iargs; i++) {
+                if (args[i] != TCG_CALL_DUMMY_ARG) {
+                    live |= DSE_BIT(args[i]);
+                }
+            }
+            continue;
+        case INDEX_op_nopn:
+            args -= args[-1];
+            continue;
+        case INDEX_op_set_label:
+            args -= def->nb_args;
+            label_live[args[0]] = live;
+            continue;
+        case INDEX_op_br:
+            args -= def->nb_args;
+            live = label_live[args[0]];
+            continue;
+        default:
+            args -= def->nb_args;
+            break;
+        }
+
+        nb_oargs = def->nb_oargs;
+        nb_iargs = def->nb_iargs;
+
+        /* Remove the op if all its outputs are dead marked globals. */
+        for (i = 0; i < nb_oargs; i++) {
+            uint32_t bit = DSE_BIT(args[i]);
+            if (bit == 0 || (live & bit)) {
+                break;
+            }
+        }
+        if (nb_oargs != 0 && i == nb_oargs &&
+            !(def->flags & (TCG_OPF_SIDE_EFFECTS | TCG_OPF_BB_END))) {
+            tcg_set_nop(s, s->gen_opc_buf + op_index, args, def->nb_args);
+            removed++;
+            continue;
+        }
+
+        for (i = 0; i < nb_oargs; i++) {
+            live &= ~DSE_BIT(args[i]);
+        }
+        switch (op) {
+        case INDEX_op_brcond_i32:
+        case INDEX_op_brcond_i64:
+            live |= label_live[args[3]];
+            break;
+        case INDEX_op_brcond2_i32:
+            live |= label_live[args[5]];
+            break;
+        default:
+            if (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS)) {
+                live = all;
+            }
+            break;
+        }
+        for (i = nb_oargs; i < nb_oargs + nb_iargs; i++) {
+            live |= DSE_BIT(args[i]);
+        }
+    }
+#undef DSE_BIT
+
+    if (args != s->gen_opparam_buf) {
+        tcg_abort();
+    }
+    return removed;
+}
+
 /* liveness analysis: end of function: all temps are dead, and globals
    should be in memory. */
 static inline void tcg_la_func_end(TCGContext *s, uint8_t *dead_temps,
@@ -2459,6 +2597,7 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
     int op_index;
     const TCGOpDef *def;
     const TCGArg *args;
+    int removed;
 
 #ifdef DEBUG_DISAS
     if (unlikely(qemu_loglevel_mask(CPU_LOG_TB_OP))) {
@@ -2477,6 +2616,12 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
         tcg_optimize(s, s->gen_opc_ptr, s->gen_opparam_buf, tcg_op_defs);
 #endif
 
+    removed = tcg_dead_global_elimination(s);
+    if (search_pc < 0) {
+        s->dse_tb_count++;
+        s->dse_op_count += removed;
+    }
+
 #ifdef CONFIG_PROFILER
     s->opt_time += profile_getclock();
     s->la_time -= profile_getclock();
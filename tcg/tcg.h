@@ -444,6 +444,9 @@ typedef struct TCGTemp {
 
 typedef struct TCGContext TCGContext;
 
+/* maximum number of globals passed to tcg_global_set_dse() */
+#define TCG_MAX_DSE_GLOBALS 32
+
 typedef struct TCGTempSet {
     unsigned long l[BITS_TO_LONGS(TCG_MAX_TEMPS)];
 } TCGTempSet;
@@ -468,6 +471,12 @@ struct TCGContext {
     uint8_t *op_sync_args;  /* for each operation, each bit tells if the
                                corresponding output argument needs to be
                                sync to memory. */
+
+    /* dead global store elimination, see tcg_global_set_dse() */
+    int dse_globals[TCG_MAX_DSE_GLOBALS];
+    int nb_dse_globals;
+    int64_t dse_tb_count;   /* translated blocks */
+    int64_t dse_op_count;   /* ops removed from them */
     
     /* tells in which temporary a given register is. It does not take
        into account fixed registers */
@@ -520,6 +529,8 @@ struct TCGContext {
     /* Code generation */
     int code_gen_max_blocks;
     uint8_t *code_gen_prologue;
+    /* epilogue returning 0 to cpu_exec(), used by goto_ptr on a miss */
+    uint8_t *code_gen_epilogue;
     uint8_t *code_gen_buffer;
     size_t code_gen_buffer_size;
     /* threshold to flush the translated code buffer */
@@ -566,6 +577,7 @@ void tcg_set_frame(TCGContext *s, int reg, intptr_t start, intptr_t size);
 
 TCGv_i32 tcg_global_reg_new_i32(int reg, const char *name);
 TCGv_i32 tcg_global_mem_new_i32(int reg, intptr_t offset, const char *name);
+void tcg_global_set_dse(TCGv_i32 arg);
 TCGv_i32 tcg_temp_new_internal_i32(int temp_local);
 static inline TCGv_i32 tcg_temp_new_i32(void)
 {
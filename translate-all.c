@@ -40,6 +40,7 @@
 #include "exec/cputlb.h"
 #include "translate-all.h"
 #include "qemu/timer.h"
+#include "exec/code-profile.h"
 
 //#define DEBUG_TB_INVALIDATE
 //#define DEBUG_FLUSH
@@ -103,6 +104,63 @@ static void* l1_phys_map[V_L1_SIZE];
 /* code generation context */
 TCGContext tcg_ctx;
 
+int tcg_trace_threshold;
+
+int tcg_perf_map;
+
+/* The perf map, in the format read by 'perf report': one line per
+   translated block, with the host address and size of its code and a
+   symbol name made from its guest PC, and the guest binary that contains
+   it when the guest reports its mappings through the qemu_trace device.
+   The file only describes the current content of the code buffer, it is
+   truncated by tb_flush(). */
+static FILE *tb_perf_map_file;
+
+static void tb_perf_map_record(TranslationBlock *tb, int code_size)
+{
+    const char *binary = NULL;
+    target_ulong offset = 0;
+
+    if (!tb_perf_map_file) {
+        char path[64];
+
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        tb_perf_map_file = fopen(path, "w");
+        if (!tb_perf_map_file) {
+            fprintf(stderr, "qemu: cannot create %s, disabling -perf-map\n",
+                    path);
+            tcg_perf_map = 0;
+            return;
+        }
+        /* perf reads the file while the emulator runs, and the emulator
+           may not exit cleanly, so don't keep blocks in the buffer. */
+        setvbuf(tb_perf_map_file, NULL, _IOLBF, 0);
+    }
+    if (code_profile_binary_func) {
+        binary = code_profile_binary_func(tb->pc, &offset);
+    }
+    if (binary) {
+        fprintf(tb_perf_map_file, "%" PRIxPTR " %x guest:" TARGET_FMT_lx
+                " %s+0x" TARGET_FMT_lx "%s\n",
+                (uintptr_t)tb->tc_ptr, code_size, tb->pc, binary, offset,
+                (tb->cflags & CF_TRACE) ? " [trace]" : "");
+    } else {
+        fprintf(tb_perf_map_file, "%" PRIxPTR " %x guest:" TARGET_FMT_lx
+                "%s\n", (uintptr_t)tb->tc_ptr, code_size, tb->pc,
+                (tb->cflags & CF_TRACE) ? " [trace]" : "");
+    }
+}
+
+static void tb_perf_map_flush(void)
+{
+    if (tb_perf_map_file) {
+        fflush(tb_perf_map_file);
+        if (ftruncate(fileno(tb_perf_map_file), 0) == 0) {
+            rewind(tb_perf_map_file);
+        }
+    }
+}
+
 /* XXX: suppress that */
 unsigned long code_gen_max_block_size(void)
 {
@@ -751,6 +809,9 @@ void tb_flush(CPUArchState *env1)
     page_flush_tb();
 
     tcg_ctx.code_gen_ptr = tcg_ctx.code_gen_buffer;
+    if (tcg_perf_map) {
+        tb_perf_map_flush();
+    }
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     tcg_ctx.tb_ctx.tb_flush_count++;
@@ -1004,7 +1065,12 @@ TranslationBlock *tb_gen_code(CPUArchState *env,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    tb->exec_count = (cflags & CF_HOT_COUNT) ? tcg_trace_threshold : INT32_MAX;
+    tb->trace_path = 0;
     cpu_gen_code(env, tb, &code_gen_size);
+    if (tcg_perf_map) {
+        tb_perf_map_record(tb, code_gen_size);
+    }
     tcg_ctx.code_gen_ptr = (void *)(((uintptr_t)tcg_ctx.code_gen_ptr +
             code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
 
@@ -1018,6 +1084,51 @@ TranslationBlock *tb_gen_code(CPUArchState *env,
     return tb;
 }
 
+/* Retranslate the hot block |tb| as a trace, which follows the dominant
+   successors of its branches instead of ending at the first one. The
+   original block is invalidated so that other blocks chain to the trace,
+   and the trace is returned. */
+TranslationBlock *tb_gen_trace(CPUArchState *env, TranslationBlock *tb)
+{
+    target_ulong pc = tb->pc;
+    target_ulong cs_base = tb->cs_base;
+    uint64_t flags = tb->flags;
+    int cflags = (tb->cflags & ~CF_HOT_COUNT) | CF_TRACE;
+
+    tb_phys_invalidate(tb, -1);
+    tb = tb_gen_code(env, pc, cs_base, flags, cflags);
+    env->tb_jmp_cache[tb_jmp_cache_hash_func(pc)] = tb;
+    tcg_ctx.tb_ctx.tb_trace_count++;
+    return tb;
+}
+
+/* Return how many times the block at |pc| ran since it was translated,
+   as far as it is known. Used by translators to find the dominant
+   successor of a branch when forming a trace. */
+int tb_get_exec_count(tb_page_addr_t phys_pc, target_ulong pc,
+                      target_ulong cs_base, uint64_t flags)
+{
+    TranslationBlock *tb;
+
+    tb = tcg_ctx.tb_ctx.tb_phys_hash[tb_phys_hash_func(phys_pc)];
+    for (; tb != NULL; tb = tb->phys_hash_next) {
+        if (tb->pc == pc &&
+            tb->page_addr[0] == (phys_pc & TARGET_PAGE_MASK) &&
+            tb->cs_base == cs_base &&
+            tb->flags == flags) {
+            if (tb->cflags & CF_TRACE) {
+                /* only hot blocks become traces */
+                return tcg_trace_threshold;
+            }
+            if (tb->cflags & CF_HOT_COUNT) {
+                return tcg_trace_threshold - tb->exec_count;
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
+
 /*
  * Invalidate all TBs which intersect with the target physical address range
  * [start;end[. NOTE: start and end may refer to *different* physical pages.
@@ -1529,6 +1640,7 @@ void dump_exec_info(FILE *f, fprintf_function cpu_fprintf)
 {
     int i, target_code_size, max_target_code_size;
     int direct_jmp_count, direct_jmp2_count, cross_page;
+    uint64_t lookup_hits, lookup_count;
     TranslationBlock *tb;
 
     target_code_size = 0;
@@ -1585,6 +1697,17 @@ void dump_exec_info(FILE *f, fprintf_function cpu_fprintf)
     cpu_fprintf(f, "TB invalidate count %d\n",
             tcg_ctx.tb_ctx.tb_phys_invalidate_count);
     cpu_fprintf(f, "TLB flush count     %d\n", tlb_flush_count);
+    lookup_hits = tcg_ctx.tb_ctx.tb_lookup_hit_count;
+    lookup_count = lookup_hits + tcg_ctx.tb_ctx.tb_lookup_miss_count;
+    cpu_fprintf(f, "TB lookup hit count %" PRIu64 "/%" PRIu64 " (%d%%)\n",
+                lookup_hits, lookup_count,
+                lookup_count ? (int)((lookup_hits * 100) / lookup_count) : 0);
+    cpu_fprintf(f, "hot trace count     %d (threshold %d)\n",
+                tcg_ctx.tb_ctx.tb_trace_count, tcg_trace_threshold);
+    cpu_fprintf(f, "dead flag ops/TB    %0.2f (%" PRId64 " in %" PRId64 " TBs)\n",
+                tcg_ctx.dse_tb_count ?
+                        (double)tcg_ctx.dse_op_count / tcg_ctx.dse_tb_count : 0,
+                tcg_ctx.dse_op_count, tcg_ctx.dse_tb_count);
     tcg_dump_info(f, cpu_fprintf);
 }
 
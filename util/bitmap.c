@@ -11,6 +11,7 @@
 
 #include "qemu/bitops.h"
 #include "qemu/bitmap.h"
+#include "qemu/host-utils.h"
 
 /*
  * bitmaps provide an array of bits, implemented using an an
@@ -197,6 +198,28 @@ void bitmap_clear(unsigned long *map, long start, long nr)
     }
 }
 
+long bitmap_count_one_range(const unsigned long *map, long start, long nr)
+{
+    const unsigned long *p = map + BIT_WORD(start);
+    const long size = start + nr;
+    int bits_to_count = BITS_PER_LONG - (start % BITS_PER_LONG);
+    unsigned long mask_to_count = BITMAP_FIRST_WORD_MASK(start);
+    long count = 0;
+
+    while (nr - bits_to_count >= 0) {
+        count += ctpopl(*p & mask_to_count);
+        nr -= bits_to_count;
+        bits_to_count = BITS_PER_LONG;
+        mask_to_count = ~0UL;
+        p++;
+    }
+    if (nr) {
+        mask_to_count &= BITMAP_LAST_WORD_MASK(size);
+        count += ctpopl(*p & mask_to_count);
+    }
+    return count;
+}
+
 #define ALIGN_MASK(x,mask)      (((x)+(mask))&~(mask))
 
 /**
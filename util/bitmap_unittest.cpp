@@ -0,0 +1,150 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include <gtest/gtest.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// qemu/bitmap.h can't be compiled as C++.
+extern "C" long bitmap_count_one_range(const unsigned long* map,
+                                       long start,
+                                       long nr);
+
+namespace {
+
+const long kBitsPerLong = sizeof(unsigned long) * CHAR_BIT;
+const long kNumWords = 8;
+const long kNumBits = kNumWords * kBitsPerLong;
+
+bool testBit(const unsigned long* map, long bit) {
+    return (map[bit / kBitsPerLong] >> (bit % kBitsPerLong)) & 1;
+}
+
+void setBit(unsigned long* map, long bit) {
+    map[bit / kBitsPerLong] |= 1UL << (bit % kBitsPerLong);
+}
+
+long referenceCount(const unsigned long* map, long start, long nr) {
+    long count = 0;
+    for (long bit = start; bit < start + nr; ++bit) {
+        count += testBit(map, bit);
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(BitmapCountOneRange, EmptyRange) {
+    unsigned long map[kNumWords];
+    memset(map, 0xff, sizeof(map));
+    for (long start = 0; start <= kNumBits; ++start) {
+        EXPECT_EQ(0, bitmap_count_one_range(map, start, 0)) << start;
+    }
+}
+
+TEST(BitmapCountOneRange, FullMap) {
+    unsigned long map[kNumWords];
+    memset(map, 0xff, sizeof(map));
+    EXPECT_EQ(kNumBits, bitmap_count_one_range(map, 0, kNumBits));
+}
+
+TEST(BitmapCountOneRange, AllRangesOfFullMap) {
+    unsigned long map[kNumWords];
+    memset(map, 0xff, sizeof(map));
+
+    // Covers heads and tails at every bit position, ranges inside a single
+    // word, and ranges ending exactly at or just past a word boundary.
+    for (long start = 0; start < kNumBits; ++start) {
+        for (long nr = 0; start + nr <= kNumBits; ++nr) {
+            EXPECT_EQ(nr, bitmap_count_one_range(map, start, nr))
+                    << "start " << start << " nr " << nr;
+        }
+    }
+}
+
+TEST(BitmapCountOneRange, RangeEdgesAroundWordBoundaries) {
+    unsigned long map[kNumWords];
+
+    // A single bit set on each side of every word boundary, and ranges
+    // starting or ending right before, on, or after it.
+    for (long boundary = kBitsPerLong; boundary < kNumBits;
+         boundary += kBitsPerLong) {
+        for (long bit = boundary - 2; bit <= boundary + 1; ++bit) {
+            memset(map, 0, sizeof(map));
+            setBit(map, bit);
+            for (long start = boundary - 3; start <= boundary + 2; ++start) {
+                for (long end = start; end <= boundary + 3; ++end) {
+                    long expected = (bit >= start && bit < end) ? 1 : 0;
+                    EXPECT_EQ(expected,
+                              bitmap_count_one_range(map, start, end - start))
+                            << "bit " << bit << " start " << start
+                            << " end " << end;
+                }
+            }
+        }
+    }
+}
+
+TEST(BitmapCountOneRange, DoesNotReadPastTheRange) {
+    // Bits outside of the range, in the same words as its edges, must not
+    // be counted.
+    unsigned long map[kNumWords];
+    memset(map, 0xff, sizeof(map));
+    map[1] = 0;
+    map[2] = 0;
+    EXPECT_EQ(0, bitmap_count_one_range(map, kBitsPerLong,
+                                        2 * kBitsPerLong));
+    EXPECT_EQ(2, bitmap_count_one_range(map, kBitsPerLong - 1,
+                                        2 * kBitsPerLong + 2));
+}
+
+TEST(BitmapCountOneRange, MatchesReference) {
+    unsigned long map[kNumWords];
+
+    srand(1);
+    for (int iter = 0; iter < 20000; ++iter) {
+        for (long n = 0; n < kNumWords; ++n) {
+            map[n] = 0;
+            for (size_t b = 0; b < sizeof(map[n]); ++b) {
+                map[n] = (map[n] << 8) | (rand() & 0xff);
+            }
+        }
+        long start = rand() % (kNumBits + 1);
+        long nr = rand() % (kNumBits - start + 1);
+        EXPECT_EQ(referenceCount(map, start, nr),
+                  bitmap_count_one_range(map, start, nr))
+                << "start " << start << " nr " << nr;
+    }
+}
+
+// Counts the dirty pages of a multi-GB guest RAM, as done by each pass of
+// RAM migration. Disabled by default, run it with
+// --gtest_also_run_disabled_tests.
+TEST(BitmapCountOneRange, DISABLED_MultiGigabyteBenchmark) {
+    const long kRamPages = 4LL * 1024 * 1024 * 1024 / 4096;
+    const long kRamWords = kRamPages / kBitsPerLong;
+    const int kPasses = 100;
+    unsigned long* map = new unsigned long[kRamWords];
+
+    for (long n = 0; n < kRamWords; ++n) {
+        map[n] = (n & 1) ? ~0UL : 0x0123456789abcdefULL;
+    }
+    long total = 0;
+    for (int pass = 0; pass < kPasses; ++pass) {
+        total += bitmap_count_one_range(map, pass, kRamPages - pass);
+    }
+    delete [] map;
+
+    EXPECT_GT(total, 0);
+}
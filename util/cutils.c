@@ -218,6 +218,43 @@ size_t buffer_find_nonzero_offset(const void *buf, size_t len)
     return i * sizeof(VECTYPE);
 }
 
+/*
+ * Checks if all bytes of a buffer are equal to its first one, e.g. to find
+ * guest pages that can be sent as a single byte.
+ *
+ * Vector instructions are used when buf and len meet the requirements of
+ * buffer_find_nonzero_offset().
+ */
+bool buffer_is_uniform(const void *buf, size_t len)
+{
+    const uint8_t *p8 = buf;
+    size_t i;
+
+    if (can_use_buffer_find_nonzero_offset(buf, len)) {
+        const VECTYPE *p = buf;
+        const VECTYPE val = SPLAT(p8);
+
+        for (i = 0; i < len / sizeof(VECTYPE);
+             i += BUFFER_FIND_NONZERO_OFFSET_UNROLL_FACTOR) {
+            VECTYPE tmp0 = (p[i + 0] ^ val) | (p[i + 1] ^ val);
+            VECTYPE tmp1 = (p[i + 2] ^ val) | (p[i + 3] ^ val);
+            VECTYPE tmp2 = (p[i + 4] ^ val) | (p[i + 5] ^ val);
+            VECTYPE tmp3 = (p[i + 6] ^ val) | (p[i + 7] ^ val);
+            if (!ALL_EQ((tmp0 | tmp1) | (tmp2 | tmp3), (VECTYPE){0})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (i = 1; i < len; i++) {
+        if (p8[i] != p8[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
  * Checks if a buffer is all zeroes
  *
@@ -0,0 +1,165 @@
+// Copyright 2015 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+// qemu-common.h can't be compiled as C++.
+extern "C" bool buffer_is_uniform(const void* buf, size_t len);
+
+namespace {
+
+const size_t kPageSize = 4096;
+
+// Large enough for a page at any offset in a 64-byte block.
+const size_t kBufferSize = 2 * kPageSize + 64;
+
+bool referenceIsUniform(const uint8_t* buf, size_t len) {
+    for (size_t n = 1; n < len; ++n) {
+        if (buf[n] != buf[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A buffer aligned for the vector path of buffer_is_uniform().
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(size_t size = kBufferSize) {
+        mStorage = new uint8_t[size + 64];
+        mData = mStorage + (64 - ((uintptr_t)mStorage & 63));
+    }
+    ~AlignedBuffer() { delete [] mStorage; }
+
+    uint8_t* data() { return mData; }
+
+private:
+    uint8_t* mStorage;
+    uint8_t* mData;
+};
+
+int64_t nowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+}  // namespace
+
+TEST(BufferIsUniform, EmptyAndSingleByte) {
+    uint8_t byte = 0x42;
+    EXPECT_TRUE(buffer_is_uniform(&byte, 0));
+    EXPECT_TRUE(buffer_is_uniform(&byte, 1));
+}
+
+TEST(BufferIsUniform, AlignedPage) {
+    AlignedBuffer buffer;
+    uint8_t* page = buffer.data();
+    static const uint8_t kValues[] = { 0x00, 0x01, 0x5a, 0x80, 0xff };
+
+    for (size_t v = 0; v < sizeof(kValues); ++v) {
+        memset(page, kValues[v], kPageSize);
+        EXPECT_TRUE(buffer_is_uniform(page, kPageSize)) << "value " << v;
+
+        // A single different byte anywhere must be found, including in
+        // the first vector, which is also the reference value.
+        for (size_t pos = 0; pos < kPageSize; ++pos) {
+            page[pos] ^= 0x10;
+            EXPECT_FALSE(buffer_is_uniform(page, kPageSize))
+                    << "value " << v << " position " << pos;
+            page[pos] ^= 0x10;
+        }
+    }
+}
+
+TEST(BufferIsUniform, UnalignedHeadAndTail) {
+    AlignedBuffer buffer;
+    uint8_t* data = buffer.data();
+
+    // Every start offset within a 64-byte block, and lengths around the
+    // multiples of the vector unroll size, so that both the vector and the
+    // byte paths are taken.
+    for (size_t offset = 0; offset < 64; ++offset) {
+        for (size_t len = kPageSize - 65; len <= kPageSize + 65; ++len) {
+            uint8_t* buf = data + offset;
+            memset(data, 0xa5, kBufferSize);
+            EXPECT_TRUE(buffer_is_uniform(buf, len))
+                    << "offset " << offset << " len " << len;
+
+            // Different first byte, last byte, and byte just past the end.
+            buf[0] = 0xa4;
+            EXPECT_FALSE(buffer_is_uniform(buf, len))
+                    << "offset " << offset << " len " << len;
+            buf[0] = 0xa5;
+
+            buf[len - 1] = 0xa4;
+            EXPECT_FALSE(buffer_is_uniform(buf, len))
+                    << "offset " << offset << " len " << len;
+            buf[len - 1] = 0xa5;
+
+            buf[len] = 0xa4;
+            EXPECT_TRUE(buffer_is_uniform(buf, len))
+                    << "offset " << offset << " len " << len;
+        }
+    }
+}
+
+TEST(BufferIsUniform, MatchesReference) {
+    AlignedBuffer buffer;
+    uint8_t* data = buffer.data();
+
+    srand(1);
+    for (int iter = 0; iter < 20000; ++iter) {
+        size_t offset = rand() % 64;
+        size_t len = rand() % (kPageSize + 1);
+        uint8_t* buf = data + offset;
+
+        memset(data, 0x33, kBufferSize);
+        if (rand() & 1) {
+            buf[rand() % (len + 1)] = (uint8_t)rand();
+        }
+        EXPECT_EQ(referenceIsUniform(buf, len), buffer_is_uniform(buf, len))
+                << "offset " << offset << " len " << len;
+    }
+}
+
+// Measures the scan of a multi-GB guest RAM made of uniform pages, which is
+// the worst case for RAM migration and snapshots since no page can be
+// skipped early. Disabled by default, run it with
+// --gtest_also_run_disabled_tests.
+TEST(BufferIsUniform, DISABLED_MultiGigabyteBenchmark) {
+    const size_t kRamSize = 2048ULL * 1024 * 1024;
+    const size_t kChunkSize = 64 * 1024 * 1024;
+    AlignedBuffer buffer(kChunkSize);
+    uint8_t* chunk = buffer.data();
+
+    memset(chunk, 0, kChunkSize);
+    size_t uniformPages = 0;
+    int64_t start = nowUs();
+    for (size_t done = 0; done < kRamSize; done += kChunkSize) {
+        for (size_t pos = 0; pos < kChunkSize; pos += kPageSize) {
+            uniformPages += buffer_is_uniform(chunk + pos, kPageSize);
+        }
+    }
+    int64_t elapsedUs = nowUs() - start;
+
+    EXPECT_EQ(kRamSize / kPageSize, uniformPages);
+    if (elapsedUs > 0) {
+        RecordProperty("megabytesPerSecond",
+                       (int)((double)kRamSize / elapsedUs));
+    }
+    RecordProperty("elapsedUs", (int)elapsedUs);
+}
@@ -297,6 +297,9 @@ int no_virtio_balloon = 0;
 int fd_bootchk = 1;
 int no_reboot = 0;
 int no_shutdown = 0;
+int tickless_idle = 0;
+int goldfish_balloon = 0;
+const char *snapshot_ram_dir = NULL;
 int cursor_hide = 1;
 int graphic_rotate = 0;
 WatchdogTimerModel *watchdog = NULL;
@@ -1189,6 +1192,7 @@ static void gui_update(void *opaque)
     DisplayState *ds = opaque;
     DisplayChangeListener *dcl = ds->listeners;
 
+    ds->damaged = 0;
     dpy_refresh(ds);
 
     while (dcl != NULL) {
@@ -1197,9 +1201,32 @@ static void gui_update(void *opaque)
             interval = dcl->gui_timer_interval;
         dcl = dcl->next;
     }
+
+    /* In tickless mode, double the refresh interval each time a refresh
+     * doesn't change the display, up to GUI_IDLE_REFRESH_INTERVAL.
+     * dpy_kick_refresh() restores the normal rate. */
+    if (tickless_idle) {
+        if (ds->damaged || ds->refresh_interval < interval) {
+            ds->refresh_interval = interval;
+        } else {
+            ds->refresh_interval *= 2;
+            if (ds->refresh_interval > GUI_IDLE_REFRESH_INTERVAL)
+                ds->refresh_interval = GUI_IDLE_REFRESH_INTERVAL;
+        }
+        interval = ds->refresh_interval;
+    }
     timer_mod(ds->gui_timer, interval + qemu_clock_get_ms(QEMU_CLOCK_REALTIME));
 }
 
+void dpy_kick_refresh(DisplayState *ds)
+{
+    if (!tickless_idle || !ds->gui_timer)
+        return;
+
+    ds->refresh_interval = 0;
+    timer_mod_anticipate(ds->gui_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME));
+}
+
 static void nographic_update(void *opaque)
 {
     uint64_t interval = GUI_REFRESH_INTERVAL;
@@ -2623,6 +2650,14 @@ int main(int argc, char **argv, char **envp)
                 code_profile_dirname = optarg;
                 printf("Profile will be stored in %s\n", code_profile_dirname);
                 break;
+            case QEMU_OPTION_guest_profile:
+#ifdef TARGET_ARM
+                guest_profile_filename = optarg;
+#else
+                /* Only the ARM board has the qemu_trace device. */
+                dwarning("-guest-profile is only supported on ARM, ignored.");
+#endif
+                break;
 #ifdef TARGET_I386
             case QEMU_OPTION_win2k_hack:
                 win2k_install_hack = 1;
@@ -2988,6 +3023,26 @@ int main(int argc, char **argv, char **envp)
                 android_list_web_cameras();
                 exit(0);
 
+            case QEMU_OPTION_tickless:
+                tickless_idle = 1;
+                break;
+
+            case QEMU_OPTION_snapshot_ram_dir:
+                snapshot_ram_dir = optarg;
+                break;
+
+            case QEMU_OPTION_goldfish_balloon:
+                goldfish_balloon = 1;
+                break;
+
+            case QEMU_OPTION_tcg_traces:
+                tcg_trace_threshold = TCG_TRACE_THRESHOLD;
+                break;
+
+            case QEMU_OPTION_perf_map:
+                tcg_perf_map = 1;
+                break;
+
             default:
                 os_parse_cmd_args(popt->index, optarg);
             }
@@ -3086,13 +3141,20 @@ int main(int argc, char **argv, char **envp)
         // Starting with Android 4.4.x, the ramdisk.img contains
         // an fstab.goldfish file that lists the format of each partition.
         // If the file exists, parse it to get the appropriate values.
+        // Extracted files are cached, since finding them requires
+        // inflating the ramdisk.
         char* fstab = NULL;
         size_t fstabSize = 0;
-
-        if (android_extractRamdiskFile(android_hw->disk_ramdisk_path,
-                                       "fstab.goldfish",
-                                       &fstab,
-                                       &fstabSize)) {
+        char cacheDir[PATH_MAX];
+        char* cacheEnd = cacheDir + sizeof(cacheDir);
+        char* p = bufprint_temp_dir(cacheDir, cacheEnd);
+
+        p = bufprint(p, cacheEnd, "/ramdisk-cache");
+        if (android_extractRamdiskFileCached(android_hw->disk_ramdisk_path,
+                                             "fstab.goldfish",
+                                             p < cacheEnd ? cacheDir : NULL,
+                                             &fstab,
+                                             &fstabSize)) {
             VERBOSE_PRINT(init, "Ramdisk image contains fstab.goldfish file");
 
             android_extractPartitionFormat(fstab,
@@ -3960,7 +4022,10 @@ int main(int argc, char **argv, char **envp)
         dcl = dcl->next;
     }
 
-    if (display_type == DT_NOGRAPHIC || display_type == DT_VNC) {
+    /* The nographic timer only wakes up the main loop periodically,
+     * which isn't needed with a dynamic alarm timer. */
+    if ((display_type == DT_NOGRAPHIC || display_type == DT_VNC) &&
+        !tickless_idle) {
         nographic_timer = timer_new(QEMU_CLOCK_REALTIME, SCALE_MS, nographic_update, NULL);
         timer_mod(nographic_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME));
     }